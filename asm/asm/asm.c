@@ -10,12 +10,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
 
  /************************* Constants *************************/
 #define MAX_LINE_LENGTH 500
 #define MAX_LABEL_LENGTH 50
 #define MEMORY_SIZE 4096
 #define MAX_IMMEDIATE 2048     // 11-bit immediate value limit
+#define WCET_UNBOUNDED (LLONG_MAX / 4)
+#define MAX_LOOP_TRIP_COUNT (1 << 20)
+#define ASM_VERSION "simp-asm 2"  // Bump when output for the same source changes: simp's cache keys on it
 
 /************************* Data Structures *************************/
 typedef struct Label {
@@ -24,19 +29,98 @@ typedef struct Label {
     struct Label* next;
 } Label;
 
+typedef struct {
+    int opcode;
+    int rd;
+    int rs;
+    int rt;
+    int rm;
+    int imm1;           // Raw 12-bit field
+    int imm2;           // Raw 12-bit field
+} ParsedInstruction;
+
+typedef struct {
+    int start;          // First instruction address
+    int end;            // Last instruction address (inclusive)
+    int succ[3];        // Successor blocks inside the routine
+    int nsucc;
+    int callee;         // Block called by a trailing jal, -1 if none, -2 if indirect
+} BasicBlock;
+
+typedef struct {
+    const ParsedInstruction* program;
+    int size;
+    BasicBlock* blocks;
+    int nblocks;
+    int* block_of;              // Instruction address -> block index
+    long long* routine_wcet;    // Memoized WCET per entry block
+    int* routine_state;         // 0 = not analyzed, 1 = in progress, 2 = done
+    Label* labels;
+} ControlFlowGraph;
+
+typedef struct {
+    int header;         // Header block
+    char* body;         // Block membership flags
+    int size;           // Instructions in the loop body
+    int depth;
+    int bound;          // Maximum back-edge count, -1 if unknown
+    int counter;        // Counter register of the recognized pattern, -1 for a loop instruction
+    int init;
+    int step;
+    long long cost;
+} Loop;
+
+// An assembled program; simp run hands it to the simulator without
+// imemin/dmemin files. Same layout as ProgramImage in sim.c and simp.c
+typedef struct {
+    uint64_t imem[MEMORY_SIZE];
+    int imem_words;
+    uint32_t* dmem;     // dmem_words words, malloc'd
+    int dmem_words;
+} ProgramImage;
+
 /************************* Function Prototypes *************************/
 Label* create_label(const char* name, int address);
 Label* add_label(Label* head, const char* name, int address);
 int find_label(Label* head, const char* name);
 Label* first_pass(FILE* input);
-void second_pass(FILE* input, FILE* imemin, FILE* dmemin, Label* labels);
+int second_pass(FILE* input, ProgramImage* image, Label* labels, ParsedInstruction* program);
+Label* assemble(FILE* input, ProgramImage* image, ParsedInstruction* program);
+void assemble_image(FILE* input, ProgramImage* image);
+void write_image(FILE* imemin, FILE* dmemin, const ProgramImage* image);
 int get_register_number(const char* reg);
 int get_opcode_number(const char* opcode);
+int get_io_register_number(const char* name);
 void cleanup_labels(Label* head);
 void trim(char* str);
 int is_number(const char* str);
 int parse_immediate(const char* imm, Label* labels, int bit_size);
 int parse_immediate_signed(const char* imm, Label* labels, int bit_size);
+void report_static_timing(FILE* out, const ParsedInstruction* program, int size, Label* labels);
+
+/************************* Global Variables *************************/
+const char* register_names[] = {
+    "$zero", "$imm1", "$imm2", "$v0",
+    "$a0", "$a1", "$a2", "$t0",
+    "$t1", "$t2", "$s0", "$s1",
+    "$s2", "$gp", "$sp", "$ra"
+};
+
+// I/O register names accepted as immediates (labels take precedence).
+// Static: simp links this file with sim.c, which has its own table
+static const char* io_register_names[] = {
+    "irq0enable", "irq1enable", "irq2enable", "irq0status",
+    "irq1status", "irq2status", "irqhandler", "irqreturn",
+    "clks", "leds", "display7seg", "timerenable",
+    "timercurrent", "timermax", "diskcmd", "disksector",
+    "diskbuffer", "diskstatus", "monitorsize", "monitorsrc",
+    "monitoraddr", "monitordata", "monitorcmd", "diskcount",
+    "diskdesc", "diskqueue", "diskirqmode", "coreid",
+    "numcores"
+};
+
+int dmem_size = MEMORY_SIZE;  // Words .word may address, see --dmem-size
+const char* assembler_version = ASM_VERSION;
 
 /************************* Utility Functions *************************/
 void trim(char* str) {
@@ -193,19 +277,20 @@ void cleanup_labels(Label* head) {
 int get_register_number(const char* reg) {
     if (!reg || !*reg) return -1;
 
-    static const char* registers[] = {
-        "$zero", "$imm1", "$imm2", "$v0",
-        "$a0", "$a1", "$a2", "$t0",
-        "$t1", "$t2", "$s0", "$s1",
-        "$s2", "$gp", "$sp", "$ra"
-    };
-
     for (int i = 0; i < 16; i++) {
-        if (strcmp(reg, registers[i]) == 0) {
+        if (strcmp(reg, register_names[i]) == 0) {
             return i;
         }
     }
 
+    // Vector registers "$vr0" - "$vr15"
+    if (strncmp(reg, "$vr", 3) == 0 && is_number(reg + 3)) {
+        int reg_num = atoi(reg + 3);
+        if (reg_num >= 0 && reg_num <= 15) {
+            return reg_num;
+        }
+    }
+
     // Handle registers like "$0", "$1", etc.
     if (reg[0] == '$' && is_number(reg + 1)) {
         int reg_num = atoi(reg + 1);
@@ -245,7 +330,19 @@ int get_opcode_number(const char* opcode) {
         {"reti",0x12},      // 18
         {"in",  0x13},      // 19
         {"out", 0x14},      // 20
-        {"halt",0x15}       // 21
+        {"halt",0x15},      // 21
+        {"vlw", 0x16},      // 22  Vector extension
+        {"vsw", 0x17},      // 23
+        {"vlws",0x18},      // 24
+        {"vadd",0x19},      // 25
+        {"vmul",0x1A},      // 26
+        {"vmac",0x1B},      // 27
+        {"vred",0x1C},      // 28
+        {"vsetvl",0x1D},    // 29
+        {"wfi", 0x1E},      // 30
+        {"amoswap",0x1F},   // 31  Atomics on shared dmem
+        {"amoadd",0x20},    // 32
+        {"loop",0x21}       // 33  Hardware loop
     };
 
     for (int i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); i++) {
@@ -255,6 +352,16 @@ int get_opcode_number(const char* opcode) {
     }
     return -1;
 }
+int get_io_register_number(const char* name) {
+    if (!name || !*name) return -1;
+
+    for (int i = 0; i < sizeof(io_register_names) / sizeof(io_register_names[0]); i++) {
+        if (strcmp(name, io_register_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
 /************************* First Pass Implementation *************************/
 Label* first_pass(FILE* input) {
     char line[MAX_LINE_LENGTH];
@@ -301,12 +408,17 @@ Label* first_pass(FILE* input) {
 }
 
 /************************* Second Pass Implementation *************************/
-void second_pass(FILE* input, FILE* imemin, FILE* dmemin, Label* labels) {
+int second_pass(FILE* input, ProgramImage* image, Label* labels, ParsedInstruction* program) {
     char line[MAX_LINE_LENGTH];
     int current_address = 0;
-    int dmem[MEMORY_SIZE] = { 0 };
+    uint32_t* dmem = (uint32_t*)calloc(dmem_size, sizeof(uint32_t));
     int max_dmem_address = 64;
 
+    if (!dmem) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+
     rewind(input);
 
     while (fgets(line, MAX_LINE_LENGTH, input)) {
@@ -330,7 +442,11 @@ void second_pass(FILE* input, FILE* imemin, FILE* dmemin, Label* labels) {
             if (token) {
                 trim(token);
                 int value = strtol(token, NULL, 0);
-                dmem[word_address] = value;
+                if (word_address < 0 || word_address >= dmem_size) {
+                    fprintf(stderr, "Error: .word address %d outside dmem (%d words)\n", word_address, dmem_size);
+                    exit(1);
+                }
+                dmem[word_address] = (uint32_t)value;
                 if (word_address > max_dmem_address) {
                     max_dmem_address = word_address;
                 }
@@ -348,15 +464,15 @@ void second_pass(FILE* input, FILE* imemin, FILE* dmemin, Label* labels) {
         }
 
         // Initialize default operands
-        char opcode[6] = "", rd[6] = "$zero", rs[6] = "$zero", rt[6] = "$zero", rm[6] = "$zero";
+        char opcode[8] = "", rd[6] = "$zero", rs[6] = "$zero", rt[6] = "$zero", rm[6] = "$zero";
         char imm1[50] = "0", imm2[50] = "0";
 
         // Parse instruction
         char* token = strtok(line, " \t,");
 
         if (token) {
-            strncpy(opcode, token, 5);
-            opcode[5] = '\0';
+            strncpy(opcode, token, 7);
+            opcode[7] = '\0';
             token = strtok(NULL, " \t,");
 
             if (token) {  // rd
@@ -428,6 +544,9 @@ void second_pass(FILE* input, FILE* imemin, FILE* dmemin, Label* labels) {
             }
             else {  // Must be a label
                 imm1_value = find_label(labels, imm1);
+                if (imm1_value == -1) {
+                    imm1_value = get_io_register_number(imm1);
+                }
                 if (imm1_value == -1) {
                     fprintf(stderr, "Error: Undefined label %s\n", imm1);
                     exit(1);
@@ -450,6 +569,9 @@ void second_pass(FILE* input, FILE* imemin, FILE* dmemin, Label* labels) {
             }
             else {  // Must be a label
                 imm2_value = find_label(labels, imm2);
+                if (imm2_value == -1) {
+                    imm2_value = get_io_register_number(imm2);
+                }
                 if (imm2_value == -1) {
                     fprintf(stderr, "Error: Undefined label %s\n", imm2);
                     exit(1);
@@ -465,33 +587,785 @@ void second_pass(FILE* input, FILE* imemin, FILE* dmemin, Label* labels) {
             imm1_value &= 0xFFF;   // 12 bits
             imm2_value &= 0xFFF;   // 12 bits
 
-            // Format and write the instruction
-            fprintf(imemin, "%02X%01X%01X%01X%01X%03X%03X\n",
-                opcode_num,
-                rd_num,
-                rs_num,
-                rt_num,
-                rm_num,
-                imm1_value,
-                imm2_value);
+            // Keep the parsed fields for static analysis
+            if (program && current_address < MEMORY_SIZE) {
+                ParsedInstruction* parsed = &program[current_address];
+                parsed->opcode = opcode_num;
+                parsed->rd = rd_num;
+                parsed->rs = rs_num;
+                parsed->rt = rt_num;
+                parsed->rm = rm_num;
+                parsed->imm1 = imm1_value;
+                parsed->imm2 = imm2_value;
+            }
+
+            // Encode the instruction
+            if (current_address == MEMORY_SIZE) {
+                fprintf(stderr, "Error: Program exceeds %d instructions\n", MEMORY_SIZE);
+                exit(1);
+            }
+            image->imem[current_address] = (uint64_t)opcode_num << 40 |
+                (uint64_t)rd_num << 36 |
+                (uint64_t)rs_num << 32 |
+                (uint64_t)rt_num << 28 |
+                (uint64_t)rm_num << 24 |
+                (uint64_t)imm1_value << 12 |
+                (uint64_t)imm2_value;
 
             current_address++;
         }
     }
 
-    // Write data memory contents
-    for (int i = 0; i <= max_dmem_address; i++) {
-        fprintf(dmemin, "%08X\n", dmem[i]);
+    image->imem_words = current_address;
+    image->dmem = dmem;
+    image->dmem_words = max_dmem_address < dmem_size ? max_dmem_address + 1 : dmem_size;
+    return current_address;
+}
+
+// Both passes; labels are returned for --wcet and program is filled when non-NULL
+Label* assemble(FILE* input, ProgramImage* image, ParsedInstruction* program) {
+    Label* labels = first_pass(input);
+    if (!labels && ferror(input)) {
+        fprintf(stderr, "Error: First pass failed\n");
+        exit(1);
+    }
+    second_pass(input, image, labels, program);
+    return labels;
+}
+
+// Entry point for simp run, which needs only the image
+void assemble_image(FILE* input, ProgramImage* image) {
+    cleanup_labels(assemble(input, image, NULL));
+}
+
+void write_image(FILE* imemin, FILE* dmemin, const ProgramImage* image) {
+    for (int i = 0; i < image->imem_words; i++) {
+        fprintf(imemin, "%012llX\n", (unsigned long long)image->imem[i]);
+    }
+    for (int i = 0; i < image->dmem_words; i++) {
+        fprintf(dmemin, "%08X\n", image->dmem[i]);
+    }
+}
+
+/************************* Static Timing Analysis *************************/
+// Every SIMP instruction takes one cycle, so a cycle estimate is an
+// instruction count over the control-flow graph. Loops are bounded only
+// when a counter pattern is recognized; anything else is reported as
+// unbounded instead of guessed.
+
+int sign_extend12(int value) {
+    return (value & 0x800) ? (value | ~0xFFF) : (value & 0xFFF);
+}
+
+// Value of a register operand that is known at assembly time
+int constant_operand(const ParsedInstruction* inst, int reg, int* value) {
+    switch (reg) {
+    case 0: *value = 0; return 1;
+    case 1: *value = sign_extend12(inst->imm1); return 1;
+    case 2: *value = sign_extend12(inst->imm2); return 1;
+    default: return 0;
+    }
+}
+
+int is_branch(int opcode) {
+    return opcode >= 0x09 && opcode <= 0x0E;
+}
+
+int ends_block(int opcode) {
+    return (opcode >= 0x09 && opcode <= 0x0F) || opcode == 0x12 || opcode == 0x15 || opcode == 0x21;
+}
+
+int writes_rd(int opcode) {
+    return opcode <= 0x08 || opcode == 0x0F || opcode == 0x10 || opcode == 0x13 ||
+        opcode == 0x1C || opcode == 0x1D || opcode == 0x1F || opcode == 0x20;
+}
+
+// Jump target of a branch or jal, -1 if it comes from a general register
+int static_target(const ParsedInstruction* inst, int size) {
+    int target;
+    if (!constant_operand(inst, inst->rm, &target)) return -1;
+    target &= 0xFFF;
+    return target < size ? target : -1;
+}
+
+int branch_taken(int opcode, int a, int b) {
+    switch (opcode) {
+    case 0x09: return a == b;
+    case 0x0A: return a != b;
+    case 0x0B: return a < b;
+    case 0x0C: return a > b;
+    case 0x0D: return a <= b;
+    case 0x0E: return a >= b;
+    default: return 0;
+    }
+}
+
+int evaluate_alu(int opcode, int a, int b, int c, int* result) {
+    uint32_t ua = (uint32_t)a, ub = (uint32_t)b, uc = (uint32_t)c;
+    switch (opcode) {
+    case 0x00: *result = (int)(ua + ub + uc); return 1;
+    case 0x01: *result = (int)(ua - ub - uc); return 1;
+    case 0x02: *result = (int)(ua * ub + uc); return 1;
+    case 0x03: *result = (int)(ua & ub & uc); return 1;
+    case 0x04: *result = (int)(ua | ub | uc); return 1;
+    case 0x05: *result = (int)(ua ^ ub ^ uc); return 1;
+    case 0x06: *result = (int)(ua << (ub & 31)); return 1;
+    case 0x07: *result = a >> (ub & 31); return 1;
+    case 0x08: *result = (int)(ua >> (ub & 31)); return 1;
+    default: return 0;
+    }
+}
+
+long long saturating_add(long long a, long long b) {
+    if (a >= WCET_UNBOUNDED || b >= WCET_UNBOUNDED || a + b >= WCET_UNBOUNDED) {
+        return WCET_UNBOUNDED;
+    }
+    return a + b;
+}
+
+long long saturating_mul(long long a, long long b) {
+    if (a >= WCET_UNBOUNDED || b >= WCET_UNBOUNDED) return WCET_UNBOUNDED;
+    if (a != 0 && b > WCET_UNBOUNDED / a) return WCET_UNBOUNDED;
+    return a * b;
+}
+
+const char* label_at(Label* head, int address) {
+    const char* name = NULL;
+    // The list is built in reverse, so the last match is the first label in the source
+    while (head) {
+        if (head->address == address) name = head->name;
+        head = head->next;
+    }
+    return name;
+}
+
+void build_cfg(ControlFlowGraph* cfg, const ParsedInstruction* program, int size, Label* labels) {
+    char* leader = (char*)calloc(size + 1, 1);
+    cfg->program = program;
+    cfg->size = size;
+    cfg->labels = labels;
+    cfg->block_of = (int*)malloc(sizeof(int) * (size + 1));
+    cfg->blocks = (BasicBlock*)malloc(sizeof(BasicBlock) * (size + 1));
+    cfg->routine_wcet = (long long*)calloc(size + 1, sizeof(long long));
+    cfg->routine_state = (int*)calloc(size + 1, sizeof(int));
+    if (!leader || !cfg->block_of || !cfg->blocks || !cfg->routine_wcet || !cfg->routine_state) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+
+    // Leaders: entry, labels, static targets and instructions after control transfers
+    leader[0] = 1;
+    for (Label* l = labels; l; l = l->next) {
+        if (l->address >= 0 && l->address < size) leader[l->address] = 1;
+    }
+    for (int pc = 0; pc < size; pc++) {
+        const ParsedInstruction* inst = &program[pc];
+        if (is_branch(inst->opcode) || inst->opcode == 0x0F || inst->opcode == 0x21) {
+            int target = static_target(inst, size);
+            if (target >= 0) leader[target] = 1;
+        }
+        if (ends_block(inst->opcode)) leader[pc + 1] = 1;
+    }
+
+    cfg->nblocks = 0;
+    for (int pc = 0; pc < size; pc++) {
+        if (leader[pc]) {
+            BasicBlock* b = &cfg->blocks[cfg->nblocks++];
+            b->start = pc;
+            b->nsucc = 0;
+            b->callee = -1;
+        }
+        cfg->blocks[cfg->nblocks - 1].end = pc;
+        cfg->block_of[pc] = cfg->nblocks - 1;
+    }
+
+    // Intra-procedural successors; jal falls through and records its callee
+    for (int i = 0; i < cfg->nblocks; i++) {
+        BasicBlock* b = &cfg->blocks[i];
+        const ParsedInstruction* inst = &program[b->end];
+        int next = b->end + 1 < size ? cfg->block_of[b->end + 1] : -1;
+        int fallthrough = 1;
+
+        if (is_branch(inst->opcode)) {
+            int target = static_target(inst, size);
+            int a, c;
+            int always = inst->rs == inst->rt ? branch_taken(inst->opcode, 0, 0) : 0;
+            int never = inst->rs == inst->rt ? !always : 0;
+            if (constant_operand(inst, inst->rs, &a) && constant_operand(inst, inst->rt, &c)) {
+                always = branch_taken(inst->opcode, a, c);
+                never = !always;
+            }
+            // A register-indirect branch leaves the routine (return)
+            if (!never && target >= 0) b->succ[b->nsucc++] = cfg->block_of[target];
+            fallthrough = !always;
+        }
+        else if (inst->opcode == 0x0F) {
+            int target = static_target(inst, size);
+            b->callee = target >= 0 ? cfg->block_of[target] : -2;
+        }
+        else if (inst->opcode == 0x12 || inst->opcode == 0x15) {
+            fallthrough = 0;
+        }
+        else if (inst->opcode == 0x21) {
+            // The body is skipped unless the count is a known non-zero constant
+            int target = static_target(inst, size);
+            int a, c;
+            if (target < 0) b->callee = -2;  // Body end unknown: no bound
+            else if (!constant_operand(inst, inst->rs, &a) || !constant_operand(inst, inst->rt, &c) ||
+                a + c == 0) {
+                b->succ[b->nsucc++] = cfg->block_of[target];
+            }
+        }
+
+        if (fallthrough && next >= 0 &&
+            (b->nsucc == 0 || b->succ[0] != next)) {
+            b->succ[b->nsucc++] = next;
+        }
+    }
+
+    // Hardware loops: the block falling through to the body end also goes back to its start
+    for (int pc = 0; pc + 1 < size; pc++) {
+        const ParsedInstruction* inst = &program[pc];
+        int target = static_target(inst, size);
+        if (inst->opcode != 0x21 || target <= pc + 1) continue;
+
+        BasicBlock* latch = &cfg->blocks[cfg->block_of[target - 1]];
+        int start = cfg->block_of[pc + 1], falls = 0, present = 0;
+        for (int k = 0; k < latch->nsucc; k++) {
+            if (latch->succ[k] == cfg->block_of[target]) falls = 1;
+            if (latch->succ[k] == start) present = 1;
+        }
+        if (falls && !present) {
+            if (latch->nsucc < 3) latch->succ[latch->nsucc++] = start;
+            else latch->callee = -2;  // No room for the edge: no bound
+        }
+    }
+
+    free(leader);
+}
+
+void free_cfg(ControlFlowGraph* cfg) {
+    free(cfg->block_of);
+    free(cfg->blocks);
+    free(cfg->routine_wcet);
+    free(cfg->routine_state);
+}
+
+void dfs_postorder(const ControlFlowGraph* cfg, int b, char* visited, int* order, int* count) {
+    visited[b] = 1;
+    for (int i = 0; i < cfg->blocks[b].nsucc; i++) {
+        int s = cfg->blocks[b].succ[i];
+        if (!visited[s]) dfs_postorder(cfg, s, visited, order, count);
+    }
+    order[(*count)++] = b;
+}
+
+int dominates(const int* idom, int a, int b) {
+    while (b != a) {
+        if (idom[b] == b) return 0;
+        b = idom[b];
+    }
+    return 1;
+}
+
+// Recognize "counter = const; ... counter += step; branch on counter vs const"
+void find_loop_bound(const ControlFlowGraph* cfg, Loop* loop) {
+    const ParsedInstruction* program = cfg->program;
+    loop->bound = -1;
+
+    // A loop instruction with a constant count, if its latch is the only back edge
+    int pc = cfg->blocks[loop->header].start - 1;
+    if (pc >= 0 && program[pc].opcode == 0x21) {
+        const ParsedInstruction* inst = &program[pc];
+        int a, c, end = static_target(inst, cfg->size), only = end > pc + 1;
+        for (int b = 0; b < cfg->nblocks && only; b++) {
+            if (!loop->body[b]) continue;
+            for (int k = 0; k < cfg->blocks[b].nsucc; k++) {
+                if (cfg->blocks[b].succ[k] == loop->header && cfg->blocks[b].end != end - 1) only = 0;
+            }
+        }
+        if (only && constant_operand(inst, inst->rs, &a) && constant_operand(inst, inst->rt, &c)) {
+            uint32_t count = (uint32_t)a + (uint32_t)c;
+            if (count > 0 && count <= MAX_LOOP_TRIP_COUNT) {
+                loop->bound = (int)count - 1;
+                loop->counter = -1;
+                loop->init = (int)count;
+                loop->step = 0;
+                return;
+            }
+        }
+    }
+
+    for (int b = 0; b < cfg->nblocks; b++) {
+        if (!loop->body[b]) continue;
+        const ParsedInstruction* br = &program[cfg->blocks[b].end];
+        if (!is_branch(br->opcode)) continue;
+
+        int target = static_target(br, cfg->size);
+        if (target < 0) continue;
+        int taken_block = cfg->block_of[target];
+        int next = cfg->blocks[b].end + 1 < cfg->size ? cfg->block_of[cfg->blocks[b].end + 1] : -1;
+
+        // stay_when_taken: 1 if the taken edge keeps iterating, 0 if it exits
+        int stay_when_taken;
+        if (taken_block == loop->header) stay_when_taken = 1;
+        else if (!loop->body[taken_block]) stay_when_taken = 0;
+        else if (next < 0 || !loop->body[next]) stay_when_taken = 1;
+        else continue;
+
+        int limit, counter, counter_is_rs;
+        if (constant_operand(br, br->rt, &limit) && br->rs > 2) {
+            counter = br->rs;
+            counter_is_rs = 1;
+        }
+        else if (constant_operand(br, br->rs, &limit) && br->rt > 2) {
+            counter = br->rt;
+            counter_is_rs = 0;
+        }
+        else continue;
+
+        // Exactly one update inside the loop, of the form counter +/- constant
+        int writes = 0, step = 0, valid = 1, update_block = -1;
+        for (int i = 0; i < cfg->nblocks && valid; i++) {
+            if (!loop->body[i]) continue;
+            for (int pc = cfg->blocks[i].start; pc <= cfg->blocks[i].end; pc++) {
+                const ParsedInstruction* inst = &program[pc];
+                if (!writes_rd(inst->opcode) || inst->rd != counter) continue;
+                int k, zero;
+                writes++;
+                update_block = i;
+                if (inst->opcode == 0x00 && inst->rs == counter &&
+                    constant_operand(inst, inst->rt, &k) && constant_operand(inst, inst->rm, &zero)) {
+                    step = k + zero;
+                }
+                else if (inst->opcode == 0x00 && inst->rt == counter &&
+                    constant_operand(inst, inst->rs, &k) && constant_operand(inst, inst->rm, &zero)) {
+                    step = k + zero;
+                }
+                else if (inst->opcode == 0x01 && inst->rs == counter &&
+                    constant_operand(inst, inst->rt, &k) && constant_operand(inst, inst->rm, &zero)) {
+                    step = -(k + zero);
+                }
+                else valid = 0;
+            }
+        }
+        if (!valid || writes != 1 || step == 0) continue;
+
+        // Initial value: last write before the header in straight-line code
+        int init = 0, found = 0;
+        for (int pc = cfg->blocks[loop->header].start - 1; pc >= 0; pc--) {
+            const ParsedInstruction* inst = &program[pc];
+            int a, c, m;
+            if (loop->body[cfg->block_of[pc]] || ends_block(inst->opcode)) break;
+            if (!writes_rd(inst->opcode) || inst->rd != counter) continue;
+            found = constant_operand(inst, inst->rs, &a) && constant_operand(inst, inst->rt, &c) &&
+                constant_operand(inst, inst->rm, &m) && evaluate_alu(inst->opcode, a, c, m, &init);
+            break;
+        }
+        if (!found) continue;
+
+        // Count iterations with the test both before and after the update,
+        // unless the update is in the branch's own block and so comes first
+        int bound = -1;
+        for (int order = update_block == b; order < 2; order++) {
+            uint32_t value = (uint32_t)init;
+            int n = 0;
+            while (n <= MAX_LOOP_TRIP_COUNT) {
+                if (order == 1) value += (uint32_t)step;
+                int taken = counter_is_rs ? branch_taken(br->opcode, (int)value, limit)
+                    : branch_taken(br->opcode, limit, (int)value);
+                if (taken != stay_when_taken) break;
+                if (order == 0) value += (uint32_t)step;
+                n++;
+            }
+            if (n > MAX_LOOP_TRIP_COUNT) {
+                bound = -1;
+                break;
+            }
+            if (n > bound) bound = n;
+        }
+        if (bound < 0) continue;
+
+        loop->bound = bound;
+        loop->counter = counter;
+        loop->init = init;
+        loop->step = step;
+        return;
+    }
+}
+
+long long routine_wcet(ControlFlowGraph* cfg, int entry, FILE* report);
+
+long long node_cost(ControlFlowGraph* cfg, int b, const char* collapsed, const long long* loop_cost) {
+    if (collapsed[b]) return loop_cost[b];
+
+    long long cost = cfg->blocks[b].end - cfg->blocks[b].start + 1;
+    if (cfg->blocks[b].callee == -2) return WCET_UNBOUNDED;
+    if (cfg->blocks[b].callee >= 0) {
+        cost = saturating_add(cost, routine_wcet(cfg, cfg->blocks[b].callee, NULL));
+    }
+    return cost;
+}
+
+// Longest path from head over the region, with already analyzed loops collapsed
+long long longest_path(ControlFlowGraph* cfg, const int* rpo, int rpo_count, const char* region,
+    int head, int skip_back_edges, const int* rep, const char* collapsed, const long long* loop_cost,
+    long long* dist) {
+    long long longest = 0;
+
+    for (int i = 0; i < cfg->nblocks; i++) dist[i] = -1;
+    dist[rep[head]] = node_cost(cfg, rep[head], collapsed, loop_cost);
+
+    for (int i = 0; i < rpo_count; i++) {
+        int b = rpo[i];
+        int r = rep[b];
+        if (!region[b] || dist[r] < 0) continue;
+        if (dist[r] > longest) longest = dist[r];
+
+        for (int k = 0; k < cfg->blocks[b].nsucc; k++) {
+            int s = cfg->blocks[b].succ[k];
+            if (!region[s] || (skip_back_edges && s == head)) continue;
+            int rs = rep[s];
+            if (rs == r) continue;
+            long long candidate = saturating_add(dist[r], node_cost(cfg, rs, collapsed, loop_cost));
+            if (candidate > dist[rs]) dist[rs] = candidate;
+        }
+    }
+    return longest;
+}
+
+int compare_loops(const void* a, const void* b) {
+    const Loop* la = (const Loop*)a;
+    const Loop* lb = (const Loop*)b;
+    return la->size - lb->size;
+}
+
+int compare_loop_position(const ControlFlowGraph* cfg, const Loop* a, const Loop* b) {
+    int delta = cfg->blocks[a->header].start - cfg->blocks[b->header].start;
+    return delta ? delta : a->depth - b->depth;
+}
+
+void print_cycles(FILE* out, long long cycles) {
+    if (cycles >= WCET_UNBOUNDED) fprintf(out, "unbounded");
+    else fprintf(out, "%lld cycles", cycles);
+}
+
+long long routine_wcet(ControlFlowGraph* cfg, int entry, FILE* report) {
+    if (!report) {
+        if (cfg->routine_state[entry] == 2) return cfg->routine_wcet[entry];
+        if (cfg->routine_state[entry] == 1) return WCET_UNBOUNDED;  // Recursion
+    }
+    cfg->routine_state[entry] = 1;
+
+    int n = cfg->nblocks;
+    char* visited = (char*)calloc(n, 1);
+    int* order = (int*)malloc(sizeof(int) * n);
+    int* rpo = (int*)malloc(sizeof(int) * n);
+    int* rpo_index = (int*)malloc(sizeof(int) * n);
+    int* idom = (int*)malloc(sizeof(int) * n);
+    int* rep = (int*)malloc(sizeof(int) * n);
+    char* collapsed = (char*)calloc(n, 1);
+    long long* loop_cost = (long long*)calloc(n, sizeof(long long));
+    long long* dist = (long long*)malloc(sizeof(long long) * n);
+    int* stack = (int*)malloc(sizeof(int) * n);
+    Loop* loops = (Loop*)malloc(sizeof(Loop) * n);
+    if (!visited || !order || !rpo || !rpo_index || !idom || !rep || !collapsed ||
+        !loop_cost || !dist || !stack || !loops) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+
+    int count = 0;
+    dfs_postorder(cfg, entry, visited, order, &count);
+    for (int i = 0; i < n; i++) {
+        rpo_index[i] = -1;
+        idom[i] = -1;
+        rep[i] = i;
+    }
+    for (int i = 0; i < count; i++) {
+        rpo[i] = order[count - 1 - i];
+        rpo_index[rpo[i]] = i;
+    }
+
+    // Immediate dominators (Cooper, Harvey and Kennedy)
+    idom[entry] = entry;
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int i = 1; i < count; i++) {
+            int b = rpo[i];
+            int new_idom = -1;
+            for (int p = 0; p < count; p++) {
+                int pred = rpo[p];
+                int is_pred = 0;
+                for (int k = 0; k < cfg->blocks[pred].nsucc; k++) {
+                    if (cfg->blocks[pred].succ[k] == b) is_pred = 1;
+                }
+                if (!is_pred || idom[pred] < 0) continue;
+                if (new_idom < 0) {
+                    new_idom = pred;
+                    continue;
+                }
+                int x = pred, y = new_idom;
+                while (x != y) {
+                    while (rpo_index[x] > rpo_index[y]) x = idom[x];
+                    while (rpo_index[y] > rpo_index[x]) y = idom[y];
+                }
+                new_idom = x;
+            }
+            if (new_idom >= 0 && idom[b] != new_idom) {
+                idom[b] = new_idom;
+                changed = 1;
+            }
+        }
+    }
+
+    // Natural loops, one per header
+    int nloops = 0;
+    for (int i = 0; i < count; i++) {
+        int u = rpo[i];
+        for (int k = 0; k < cfg->blocks[u].nsucc; k++) {
+            int h = cfg->blocks[u].succ[k];
+            if (!dominates(idom, h, u)) continue;
+
+            Loop* loop = NULL;
+            for (int l = 0; l < nloops; l++) {
+                if (loops[l].header == h) loop = &loops[l];
+            }
+            if (!loop) {
+                loop = &loops[nloops++];
+                memset(loop, 0, sizeof(Loop));
+                loop->header = h;
+                loop->body = (char*)calloc(n, 1);
+                if (!loop->body) {
+                    fprintf(stderr, "Error: Memory allocation failed\n");
+                    exit(1);
+                }
+                loop->body[h] = 1;
+            }
+
+            // Walk predecessors back from the latch up to the header
+            int top = 0;
+            if (!loop->body[u]) {
+                loop->body[u] = 1;
+                stack[top++] = u;
+            }
+            while (top > 0) {
+                int x = stack[--top];
+                for (int p = 0; p < count; p++) {
+                    int pred = rpo[p];
+                    if (loop->body[pred]) continue;
+                    for (int j = 0; j < cfg->blocks[pred].nsucc; j++) {
+                        if (cfg->blocks[pred].succ[j] == x) {
+                            loop->body[pred] = 1;
+                            stack[top++] = pred;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (int l = 0; l < nloops; l++) {
+        loops[l].size = 0;
+        for (int b = 0; b < n; b++) {
+            if (loops[l].body[b]) {
+                loops[l].size += cfg->blocks[b].end - cfg->blocks[b].start + 1;
+            }
+        }
     }
+    qsort(loops, nloops, sizeof(Loop), compare_loops);
+
+    // Innermost loops first; each one collapses into its header
+    for (int l = 0; l < nloops; l++) {
+        Loop* loop = &loops[l];
+        loop->depth = 1;
+        for (int o = l + 1; o < nloops; o++) {
+            if (loops[o].body[loop->header]) loop->depth++;
+        }
+        find_loop_bound(cfg, loop);
+
+        long long iteration = longest_path(cfg, rpo, count, loop->body, loop->header, 1,
+            rep, collapsed, loop_cost, dist);
+        loop->cost = loop->bound < 0 ? WCET_UNBOUNDED
+            : saturating_mul((long long)loop->bound + 1, iteration);
+
+        for (int b = 0; b < n; b++) {
+            if (loop->body[b]) rep[b] = loop->header;
+        }
+        collapsed[loop->header] = 1;
+        loop_cost[loop->header] = loop->cost;
+    }
+
+    long long wcet = longest_path(cfg, rpo, count, visited, entry, 0, rep, collapsed, loop_cost, dist);
+
+    if (report) {
+        const char* name = label_at(cfg->labels, cfg->blocks[entry].start);
+        fprintf(report, "  %s (0x%03X): WCET ", name ? name : "<entry>", cfg->blocks[entry].start);
+        print_cycles(report, wcet);
+        fprintf(report, "\n");
+
+        // Outer loops before the loops nested in them
+        for (int l = 0; l < nloops; l++) {
+            for (int o = l + 1; o < nloops; o++) {
+                if (compare_loop_position(cfg, &loops[o], &loops[l]) < 0) {
+                    Loop tmp = loops[l];
+                    loops[l] = loops[o];
+                    loops[o] = tmp;
+                }
+            }
+        }
+        for (int l = 0; l < nloops; l++) {
+            Loop* loop = &loops[l];
+            const char* loop_name = label_at(cfg->labels, cfg->blocks[loop->header].start);
+            fprintf(report, "    %*sloop %s (0x%03X): depth %d, %d instructions, ",
+                (loop->depth - 1) * 2, "", loop_name ? loop_name : "?",
+                cfg->blocks[loop->header].start, loop->depth, loop->size);
+            if (loop->bound < 0) {
+                fprintf(report, "bound unknown\n");
+            }
+            else if (loop->counter < 0) {
+                fprintf(report, "bound %d iterations (loop instruction, count %d), ", loop->bound + 1, loop->init);
+                print_cycles(report, loop->cost);
+                fprintf(report, "\n");
+            }
+            else {  // Iterations: one more than the back edges, as in the cost
+                fprintf(report, "bound %d iterations (%s from %d step %d), ",
+                    loop->bound + 1, register_names[loop->counter], loop->init, loop->step);
+                print_cycles(report, loop->cost);
+                fprintf(report, "\n");
+            }
+        }
+    }
+
+    for (int l = 0; l < nloops; l++) free(loops[l].body);
+    free(visited);
+    free(order);
+    free(rpo);
+    free(rpo_index);
+    free(idom);
+    free(rep);
+    free(collapsed);
+    free(loop_cost);
+    free(dist);
+    free(stack);
+    free(loops);
+
+    cfg->routine_wcet[entry] = wcet;
+    cfg->routine_state[entry] = 2;
+    return wcet;
+}
+
+int compare_labels(const void* a, const void* b) {
+    const Label* la = *(const Label* const*)a;
+    const Label* lb = *(const Label* const*)b;
+    return la->address - lb->address;
+}
+
+void report_static_timing(FILE* out, const ParsedInstruction* program, int size, Label* labels) {
+    if (size == 0) return;
+
+    ControlFlowGraph cfg;
+    build_cfg(&cfg, program, size, labels);
+
+    // Per-label instruction counts, in address order
+    int nlabels = 0;
+    for (Label* l = labels; l; l = l->next) nlabels++;
+    Label** sorted = (Label**)malloc(sizeof(Label*) * (nlabels + 1));
+    if (!sorted) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    int i = 0;
+    for (Label* l = labels; l; l = l->next) sorted[i++] = l;
+    qsort(sorted, nlabels, sizeof(Label*), compare_labels);
+
+    fprintf(out, "Static timing analysis (%d instructions, 1 cycle each)\n", size);
+    fprintf(out, "Labels:\n");
+    for (i = 0; i < nlabels; i++) {
+        int end = size;
+        for (int j = i + 1; j < nlabels; j++) {
+            if (sorted[j]->address > sorted[i]->address) {
+                end = sorted[j]->address;
+                break;
+            }
+        }
+        int instructions = end > sorted[i]->address ? end - sorted[i]->address : 0;
+        fprintf(out, "  0x%03X %-*s %d instructions\n", sorted[i]->address,
+            MAX_LABEL_LENGTH / 2, sorted[i]->name, instructions);
+    }
+
+    // Routines: the entry point and every static jal target
+    fprintf(out, "Routines:\n");
+    char* reported = (char*)calloc(cfg.nblocks, 1);
+    if (!reported) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    routine_wcet(&cfg, 0, out);
+    reported[0] = 1;
+    for (int b = 0; b < cfg.nblocks; b++) {
+        int callee = cfg.blocks[b].callee;
+        if (callee >= 0 && !reported[callee]) {
+            routine_wcet(&cfg, callee, out);
+            reported[callee] = 1;
+        }
+    }
+
+    // Interrupt handlers: constant values written to irqhandler (I/O register 6)
+    fprintf(out, "Interrupt handlers:\n");
+    int handlers = 0;
+    for (int pc = 0; pc < size; pc++) {
+        const ParsedInstruction* inst = &program[pc];
+        int a, c, target;
+        if (inst->opcode != 0x14) continue;
+        if (!constant_operand(inst, inst->rs, &a) || !constant_operand(inst, inst->rt, &c)) continue;
+        if (a + c != 6 || !constant_operand(inst, inst->rm, &target)) continue;
+        target &= 0xFFF;
+        if (target >= size) continue;
+
+        routine_wcet(&cfg, cfg.block_of[target], out);
+        handlers++;
+    }
+    if (handlers == 0) fprintf(out, "  none\n");
+
+    free(reported);
+    free(sorted);
+    free_cfg(&cfg);
 }
 
 /************************* Main Function *************************/
+#ifndef SIMP_LIBRARY
 int main(int argc, char* argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <input.asm> <imemin.txt> <dmemin.txt>\n", argv[0]);
+    int report_timing = 0;
+    int arg = 1;
+
+    // Options come before the file arguments
+    while (arg < argc && strncmp(argv[arg], "--", 2) == 0) {
+        if (strcmp(argv[arg], "--wcet") == 0) {
+            report_timing = 1;
+        }
+        else if (strcmp(argv[arg], "--dmem-size") == 0 && arg + 1 < argc) {
+            dmem_size = (int)strtol(argv[++arg], NULL, 0);
+            if (dmem_size <= 0 || dmem_size % 128) {
+                fprintf(stderr, "Error: --dmem-size must be a positive multiple of 128 words\n");
+                return 1;
+            }
+        }
+        else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+        arg++;
+    }
+    if (argc - arg != 3) {
+        fprintf(stderr, "Usage: %s [--wcet] [--dmem-size WORDS] <input.asm> <imemin.txt> <dmemin.txt>\n", argv[0]);
         fprintf(stderr, "Example: assembler program.asm imemin.txt dmemin.txt\n");
+        fprintf(stderr, "  --wcet             report per-label instruction counts, loop bounds and WCET\n");
+        fprintf(stderr, "  --dmem-size WORDS  allow .word addresses up to WORDS-1 (default 4096)\n");
         return 1;
     }
+    argv += arg - 1;
 
     // Open input assembly file
     FILE* input = fopen(argv[1], "r");
@@ -516,18 +1390,17 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // First pass - collect labels
-    Label* labels = first_pass(input);
-    if (!labels && ferror(input)) {
-        fprintf(stderr, "Error: First pass failed\n");
-        fclose(input);
-        fclose(imemin);
-        fclose(dmemin);
-        return 1;
-    }
+    // First pass collects labels, second pass generates machine code
+    static ParsedInstruction program[MEMORY_SIZE];
+    static ProgramImage image;
+    Label* labels = assemble(input, &image, program);
+    write_image(imemin, dmemin, &image);
 
-    // Second pass - generate machine code
-    second_pass(input, imemin, dmemin, labels);
+    if (report_timing) {
+        report_static_timing(stdout, program, image.imem_words, labels);
+    }
+    cleanup_labels(labels);
+    free(image.dmem);
 
     // Cleanup
     fclose(input);
@@ -536,4 +1409,5 @@ int main(int argc, char* argv[]) {
 
     printf("Assembly completed successfully!\n");
     return 0;
-}
\ No newline at end of file
+}
+#endif
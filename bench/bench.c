@@ -0,0 +1,427 @@
+/*****************************************************************
+ * SIMP Benchmark Harness
+ *
+ * Runs each workload under each simulator engine and output mode,
+ * and reports simulated MIPS, host ns per instruction, startup and
+ * shutdown time and peak RSS as JSON, one result per line.
+ *
+ * Usage:
+ *   bench [--sim PATH] [--asm PATH] [--root DIR] [--work DIR]
+ *         [--out FILE] [--repeat N] [--only NAME]
+ *         [--baseline FILE] [--threshold PCT]
+ *
+ * With --baseline, results are compared against an earlier run and the
+ * exit code is 2 if any engine/workload/mode lost more than PCT percent
+ * of its MIPS.
+ *
+ * POSIX only: runs the simulator with fork/exec and reads peak RSS from
+ * wait4.
+ *****************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+ /************************* Constants *************************/
+#define MAX_PATH 512
+#define MAX_ARGS 32
+#define MAX_BASELINE 256
+#define SIM_OUTPUTS 10            // dmemout ... monitor.yuv
+
+/************************* Data Structures *************************/
+typedef struct {
+    const char* name;
+    const char* dir;              // Relative to --root
+    int synthetic;                // Assembled from bench/programs, not a prebuilt fixture
+} Workload;
+
+typedef struct {
+    const char* name;
+    const char* args[6];          // Extra sim options, NULL terminated
+} Engine;
+
+typedef struct {
+    const char* sim;
+    const char* asm_path;
+    const char* root;
+    const char* work;
+    const char* out;
+    const char* only;
+    const char* baseline;
+    int repeat;
+    double threshold;
+} Options;
+
+typedef struct {
+    uint64_t startup_ns;
+    uint64_t run_ns;
+    uint64_t shutdown_ns;
+    uint64_t instructions;
+    uint32_t cycles;
+    uint64_t wall_ns;
+    long peak_rss_kb;
+} Result;
+
+typedef struct {
+    char key[128];                // workload/engine/mode
+    double mips;
+} BaselineEntry;
+
+/************************* Global Variables *************************/
+const Workload workloads[] = {
+    { "binom", "tests/binom", 0 },
+    { "mulmat", "tests/mulmat", 0 },
+    { "circle", "tests/circle", 0 },
+    { "disktest", "tests/disktest", 0 },
+    { "alu", "bench/programs/alu", 1 },
+    { "iostorm", "bench/programs/iostorm", 1 },
+    { "irqstorm", "bench/programs/irqstorm", 1 },
+    { "diskbound", "bench/programs/diskbound", 1 },
+};
+
+const Engine engines[] = {
+    { "interp", { NULL } },
+    { "dcache", { "--dcache-size", "256", NULL } },
+    { "pipeline", { "--pipeline", "--bpred", "gshare:10", NULL } },
+};
+
+const char* modes[] = { "files", "null" };
+
+const char* output_names[SIM_OUTPUTS] = {
+    "dmemout.txt", "regout.txt", "trace.txt", "hwregtrace.txt", "cycles.txt",
+    "leds.txt", "display7seg.txt", "diskout.txt", "monitor.txt", "monitor.yuv"
+};
+
+Options options = { "build/sim", "build/asm", ".", "build/bench", NULL, NULL, NULL, 1, 10.0 };
+
+BaselineEntry baseline[MAX_BASELINE];
+int baseline_count;
+
+/************************* Helpers *************************/
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void make_dirs(const char* path) {
+    char buf[MAX_PATH];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char* p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(buf, 0755);
+        *p = '/';
+    }
+    if (mkdir(buf, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Cannot create directory %s\n", buf);
+        exit(1);
+    }
+}
+
+// dst = dir/name, failing on paths that do not fit
+void join_path(char* dst, const char* dir, const char* name) {
+    if (snprintf(dst, MAX_PATH, "%s/%s", dir, name) >= MAX_PATH) {
+        fprintf(stderr, "Error: Path too long: %s/%s\n", dir, name);
+        exit(1);
+    }
+}
+
+int file_exists(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+void touch_file(const char* path) {
+    FILE* f = fopen(path, "a");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot create %s\n", path);
+        exit(1);
+    }
+    fclose(f);
+}
+
+// Run argv with stdout discarded and stderr captured, returning the
+// exit status and the child's peak RSS in kilobytes.
+int run_command(char* const argv[], const char* stderr_path, long* peak_rss_kb) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "Error: fork failed\n");
+        exit(1);
+    }
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        int err = open(stderr_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (devnull < 0 || err < 0) _exit(127);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(err, STDERR_FILENO);
+        execv(argv[0], argv);
+        fprintf(stderr, "Error: Cannot execute %s\n", argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        fprintf(stderr, "Error: wait4 failed\n");
+        exit(1);
+    }
+    if (peak_rss_kb) *peak_rss_kb = usage.ru_maxrss;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/************************* Workload Preparation *************************/
+// Fill in the paths of the sim input files, assembling synthetic
+// programs into the work directory first
+void prepare_workload(const Workload* w, char inputs[4][MAX_PATH]) {
+    char src[MAX_PATH], dir[MAX_PATH];
+    join_path(src, options.root, w->dir);
+
+    if (!w->synthetic) {
+        join_path(inputs[0], src, "imemin.txt");
+        join_path(inputs[1], src, "dmemin.txt");
+        join_path(inputs[2], src, "diskin.txt");
+        join_path(inputs[3], src, "irq2in.txt");
+        return;
+    }
+
+    join_path(dir, options.work, w->name);
+    make_dirs(dir);
+    join_path(inputs[0], dir, "imemin.txt");
+    join_path(inputs[1], dir, "dmemin.txt");
+    join_path(inputs[2], dir, "diskin.txt");
+    join_path(inputs[3], dir, "irq2in.txt");
+
+    char asm_name[MAX_PATH], asm_src[MAX_PATH], log[MAX_PATH];
+    snprintf(asm_name, MAX_PATH, "%s.asm", w->name);
+    join_path(asm_src, src, asm_name);
+    join_path(log, dir, "asm.log");
+    char* argv[] = { (char*)options.asm_path, asm_src, inputs[0], inputs[1], NULL };
+    if (run_command(argv, log, NULL) != 0) {
+        fprintf(stderr, "Error: Assembling %s failed, see %s\n", asm_src, log);
+        exit(1);
+    }
+    if (!file_exists(inputs[2])) touch_file(inputs[2]);
+    if (!file_exists(inputs[3])) touch_file(inputs[3]);
+}
+
+/************************* Measurement *************************/
+int parse_host_stats(const char* path, Result* r) {
+    FILE* f = fopen(path, "r");
+    if (!f) return 0;
+
+    char line[512];
+    int found = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long startup, run, shutdown, instructions;
+        unsigned cycles;
+        if (sscanf(line, "host-stats startup_ns=%llu run_ns=%llu shutdown_ns=%llu instructions=%llu cycles=%u",
+            &startup, &run, &shutdown, &instructions, &cycles) == 5) {
+            r->startup_ns = startup;
+            r->run_ns = run;
+            r->shutdown_ns = shutdown;
+            r->instructions = instructions;
+            r->cycles = cycles;
+            found = 1;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+// One run of the simulator; returns 0 if it failed
+int measure(const Workload* w, const Engine* e, const char* mode, char inputs[4][MAX_PATH], Result* r) {
+    char dir[MAX_PATH], outputs[SIM_OUTPUTS][MAX_PATH], err[MAX_PATH];
+    char run_name[MAX_PATH];
+    snprintf(run_name, MAX_PATH, "%s/%s-%s", w->name, e->name, mode);
+    join_path(dir, options.work, run_name);
+    make_dirs(dir);
+    join_path(err, dir, "stderr.txt");
+
+    int null_outputs = strcmp(mode, "null") == 0;
+    for (int i = 0; i < SIM_OUTPUTS; i++) {
+        if (null_outputs) snprintf(outputs[i], MAX_PATH, "/dev/null");
+        else join_path(outputs[i], dir, output_names[i]);
+    }
+
+    char* argv[MAX_ARGS];
+    int argc = 0;
+    argv[argc++] = (char*)options.sim;
+    argv[argc++] = "--host-stats";
+    for (int i = 0; e->args[i]; i++) argv[argc++] = (char*)e->args[i];
+    for (int i = 0; i < 4; i++) argv[argc++] = inputs[i];
+    for (int i = 0; i < SIM_OUTPUTS; i++) argv[argc++] = outputs[i];
+    argv[argc] = NULL;
+
+    uint64_t start = now_ns();
+    int status = run_command(argv, err, &r->peak_rss_kb);
+    r->wall_ns = now_ns() - start;
+
+    if (status != 0 || !parse_host_stats(err, r)) {
+        fprintf(stderr, "Error: %s/%s/%s failed (exit %d), see %s\n", w->name, e->name, mode, status, err);
+        return 0;
+    }
+    return 1;
+}
+
+double mips_of(const Result* r) {
+    return r->run_ns ? (double)r->instructions * 1000.0 / (double)r->run_ns : 0.0;
+}
+
+/************************* Baseline *************************/
+void load_baseline(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open baseline %s\n", path);
+        exit(1);
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), f) && baseline_count < MAX_BASELINE) {
+        char workload[64], engine[32], mode[16];
+        const char* mips = strstr(line, "\"mips\":");
+        if (!mips) continue;
+        if (sscanf(line, "{\"workload\":\"%63[^\"]\",\"engine\":\"%31[^\"]\",\"mode\":\"%15[^\"]\"",
+            workload, engine, mode) != 3) continue;
+        BaselineEntry* b = &baseline[baseline_count++];
+        snprintf(b->key, sizeof(b->key), "%s/%s/%s", workload, engine, mode);
+        b->mips = strtod(mips + 7, NULL);
+    }
+    fclose(f);
+}
+
+// Returns 1 if the result regressed past the threshold
+int check_baseline(const char* key, double mips) {
+    for (int i = 0; i < baseline_count; i++) {
+        if (strcmp(baseline[i].key, key) != 0) continue;
+        double floor = baseline[i].mips * (1.0 - options.threshold / 100.0);
+        if (mips < floor) {
+            fprintf(stderr, "REGRESSION %s: %.3f MIPS, baseline %.3f (-%.1f%%)\n", key, mips,
+                baseline[i].mips, 100.0 * (1.0 - mips / baseline[i].mips));
+            return 1;
+        }
+        return 0;
+    }
+    return 0;
+}
+
+/************************* Command Line *************************/
+void print_usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --sim PATH         simulator binary (default build/sim)\n"
+        "  --asm PATH         assembler binary (default build/asm)\n"
+        "  --root DIR         repository root (default .)\n"
+        "  --work DIR         scratch directory for outputs (default build/bench)\n"
+        "  --out FILE         write JSON results here instead of stdout\n"
+        "  --repeat N         keep the fastest of N runs (default 1)\n"
+        "  --only NAME        run only workloads or engines named NAME\n"
+        "  --baseline FILE    compare MIPS against an earlier results file\n"
+        "  --threshold PCT    allowed MIPS loss against the baseline (default 10)\n",
+        prog);
+}
+
+void parse_options(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            exit(1);
+        }
+        const char* val = argv[++i];
+        if (strcmp(opt, "--sim") == 0) options.sim = val;
+        else if (strcmp(opt, "--asm") == 0) options.asm_path = val;
+        else if (strcmp(opt, "--root") == 0) options.root = val;
+        else if (strcmp(opt, "--work") == 0) options.work = val;
+        else if (strcmp(opt, "--out") == 0) options.out = val;
+        else if (strcmp(opt, "--only") == 0) options.only = val;
+        else if (strcmp(opt, "--baseline") == 0) options.baseline = val;
+        else if (strcmp(opt, "--repeat") == 0) options.repeat = atoi(val);
+        else if (strcmp(opt, "--threshold") == 0) options.threshold = atof(val);
+        else {
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (options.repeat < 1) {
+        fprintf(stderr, "Error: --repeat must be at least 1\n");
+        exit(1);
+    }
+}
+
+/************************* Main *************************/
+int main(int argc, char* argv[]) {
+    parse_options(argc, argv);
+    if (options.baseline) load_baseline(options.baseline);
+    make_dirs(options.work);
+
+    FILE* out = stdout;
+    if (options.out) {
+        out = fopen(options.out, "w");
+        if (!out) {
+            fprintf(stderr, "Error: Cannot open %s\n", options.out);
+            exit(1);
+        }
+    }
+
+    int failures = 0, regressions = 0;
+    for (size_t wi = 0; wi < sizeof(workloads) / sizeof(workloads[0]); wi++) {
+        const Workload* w = &workloads[wi];
+        int workload_selected = !options.only || strcmp(options.only, w->name) == 0;
+
+        char inputs[4][MAX_PATH];
+        int prepared = 0;
+        for (size_t ei = 0; ei < sizeof(engines) / sizeof(engines[0]); ei++) {
+            const Engine* e = &engines[ei];
+            if (!workload_selected && strcmp(options.only, e->name) != 0) continue;
+            if (!prepared) {
+                prepare_workload(w, inputs);
+                prepared = 1;
+            }
+
+            for (size_t mi = 0; mi < sizeof(modes) / sizeof(modes[0]); mi++) {
+                Result best = { 0 }, r;
+                int ok = 0;
+                long peak_rss_kb = 0;
+                for (int n = 0; n < options.repeat; n++) {
+                    memset(&r, 0, sizeof(r));
+                    if (!measure(w, e, modes[mi], inputs, &r)) break;
+                    if (r.peak_rss_kb > peak_rss_kb) peak_rss_kb = r.peak_rss_kb;
+                    if (!ok || r.run_ns < best.run_ns) best = r;
+                    ok = 1;
+                }
+                if (!ok) {
+                    failures++;
+                    continue;
+                }
+
+                double mips = mips_of(&best);
+                fprintf(out, "{\"workload\":\"%s\",\"engine\":\"%s\",\"mode\":\"%s\","
+                    "\"instructions\":%llu,\"cycles\":%u,\"ns_per_instruction\":%.3f,\"mips\":%.3f,"
+                    "\"startup_ms\":%.3f,\"shutdown_ms\":%.3f,\"wall_ms\":%.3f,\"peak_rss_kb\":%ld}\n",
+                    w->name, e->name, modes[mi], (unsigned long long)best.instructions, best.cycles,
+                    best.instructions ? (double)best.run_ns / (double)best.instructions : 0.0, mips,
+                    best.startup_ns / 1e6, best.shutdown_ns / 1e6, best.wall_ns / 1e6, peak_rss_kb);
+                fflush(out);
+                fprintf(stderr, "%-10s %-9s %-5s %9.3f MIPS\n", w->name, e->name, modes[mi], mips);
+
+                char key[128];
+                snprintf(key, sizeof(key), "%s/%s/%s", w->name, e->name, modes[mi]);
+                regressions += check_baseline(key, mips);
+            }
+        }
+    }
+
+    if (out != stdout) fclose(out);
+    if (failures) return 1;
+    return regressions ? 2 : 0;
+}
@@ -0,0 +1,20 @@
+# ALU Stress Program (alu.asm)
+# 102400 iterations of a dependent mac/xor/shift/add chain, about 0.8
+# million instructions with no memory or I/O traffic
+
+add $s0, $zero, $zero, $zero, 0, 0           # i = 0
+sll $s1, $imm1, $imm2, $zero, 100, 10        # 102400 iterations
+add $v0, $zero, $imm1, $zero, 1, 0           # Running value
+
+loop:
+mac $v0, $v0, $imm1, $imm2, 5, 3             # v = v * 5 + 3
+xor $t0, $v0, $s0, $zero, 0, 0
+sll $t1, $t0, $imm1, $zero, 3, 0
+srl $t2, $t1, $imm1, $zero, 7, 0
+add $v0, $v0, $t2, $zero, 0, 0
+sub $a0, $a0, $t0, $imm1, 1, 0
+add $s0, $s0, $imm1, $zero, 1, 0
+blt $zero, $s0, $s1, $imm1, loop, 0
+
+sw $v0, $zero, $imm1, $zero, 0x100, 0        # Keep the result
+halt $zero, $zero, $zero, $zero, 0, 0
@@ -0,0 +1,29 @@
+# Disk-Bound Program (diskbound.asm)
+# 256 rounds of reading a sector into 0x100 and writing it back 64
+# sectors further on, polling diskstatus while each command runs
+
+add $s0, $zero, $zero, $zero, 0, 0           # Round
+add $s1, $zero, $imm1, $zero, 256, 0         # Rounds
+out $zero, $imm1, $zero, $imm2, diskbuffer, 0x100
+
+loop:
+and $t0, $s0, $imm1, $imm1, 63, 0            # Source sector
+out $zero, $imm1, $zero, $t0, disksector, 0
+out $zero, $imm1, $zero, $imm2, diskcmd, 1   # Read
+
+wait_read:
+in $t1, $imm1, $zero, $zero, diskstatus, 0
+bne $zero, $t1, $zero, $imm1, wait_read, 0
+
+add $t0, $t0, $imm1, $zero, 64, 0            # Destination sector
+out $zero, $imm1, $zero, $t0, disksector, 0
+out $zero, $imm1, $zero, $imm2, diskcmd, 2   # Write
+
+wait_write:
+in $t1, $imm1, $zero, $zero, diskstatus, 0
+bne $zero, $t1, $zero, $imm1, wait_write, 0
+
+add $s0, $s0, $imm1, $zero, 1, 0
+blt $zero, $s0, $s1, $imm1, loop, 0
+
+halt $zero, $zero, $zero, $zero, 0, 0
@@ -0,0 +1,16 @@
+# I/O Storm Program (iostorm.asm)
+# 102400 iterations of two writes and two reads of I/O registers, so
+# leds.txt, display7seg.txt and hwregtrace.txt grow on every iteration
+
+add $s0, $zero, $zero, $zero, 0, 0           # i = 0
+sll $s1, $imm1, $imm2, $zero, 100, 10        # 102400 iterations
+
+loop:
+out $zero, $imm1, $zero, $s0, leds, 0
+out $zero, $imm1, $zero, $t0, display7seg, 0
+in $t0, $imm1, $zero, $zero, clks, 0
+in $t1, $imm1, $zero, $zero, diskstatus, 0
+add $s0, $s0, $imm1, $zero, 1, 0
+blt $zero, $s0, $s1, $imm1, loop, 0
+
+halt $zero, $zero, $zero, $zero, 0, 0
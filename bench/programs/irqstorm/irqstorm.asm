@@ -0,0 +1,22 @@
+# Interrupt Storm Program (irqstorm.asm)
+# The timer fires every 16 cycles; the main loop spins until the handler
+# has counted 51200 interrupts
+
+out $zero, $imm1, $zero, $imm2, irqhandler, tick
+out $zero, $imm1, $zero, $imm2, timermax, 16
+out $zero, $imm1, $zero, $imm2, irq0enable, 1
+out $zero, $imm1, $zero, $imm2, timerenable, 1
+add $s0, $zero, $zero, $zero, 0, 0           # Interrupt count
+sll $s1, $imm1, $imm2, $zero, 50, 10         # 51200 interrupts
+
+spin:
+add $t0, $t0, $imm1, $zero, 1, 0             # Busy work between interrupts
+blt $zero, $s0, $s1, $imm1, spin, 0
+
+out $zero, $imm1, $zero, $zero, timerenable, 0
+halt $zero, $zero, $zero, $zero, 0, 0
+
+tick:
+out $zero, $imm1, $zero, $zero, irq0status, 0 # Acknowledge
+add $s0, $s0, $imm1, $zero, 1, 0
+reti $zero, $zero, $zero, $zero, 0, 0
@@ -0,0 +1,364 @@
+/*****************************************************************
+ * SIMP Memory Trace Analyzer
+ *
+ * Reads the binary dmem access trace written by sim --memtrace and
+ * reports:
+ * - Working set (distinct words and lines) per window of cycles
+ * - LRU reuse-distance histogram with the hit rate it implies for
+ *   fully associative caches of each size
+ * - Stride patterns per PC
+ * - Hot addresses
+ *****************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+ /************************* Constants *************************/
+#define MEMORY_SIZE 4096          // Instruction memory, so PCs are 12 bits
+#define MAX_CORES 16
+#define MEMTRACE_MAGIC "SIMPMEM2"
+#define MEMTRACE_WRITE 0x8000
+#define HEADER_SIZE 4             // u32 dmem size in words after the magic
+#define RECORD_SIZE 16
+#define DISTANCE_BUCKETS 14       // 0, 1, 2-3, ..., 2048-4095, then cold
+#define STRIDE_SLOTS 4
+#define MAX_WINDOW_ROWS 64
+
+/************************* Data Structures *************************/
+typedef struct {
+    uint32_t cycle;
+    uint32_t pc;
+    uint32_t addr;
+    uint32_t core;
+    int is_write;
+    uint32_t value;
+} Access;
+
+// Frequent strides of one PC (Misra-Gries counters)
+typedef struct {
+    uint64_t accesses;
+    uint64_t strided;             // Accesses that had a previous one to take a stride from
+    int32_t stride[STRIDE_SLOTS];
+    uint64_t count[STRIDE_SLOTS];
+    uint64_t exact[STRIDE_SLOTS]; // True number of matches seen while the slot was held
+} PcStrides;
+
+typedef struct {
+    uint32_t window;              // Cycles per working set window
+    uint32_t line_words;          // Granularity of reuse distance and line counts
+    uint32_t top;                 // Rows in the PC and address tables
+} Options;
+
+/************************* Global Variables *************************/
+Options options = { 10000, 4, 16 };
+
+// Per-address tables hold dmem_words entries, sized from the trace header
+uint32_t dmem_words;
+
+// Totals
+uint64_t reads, writes;
+uint32_t first_cycle, last_cycle;
+uint64_t* addr_reads;
+uint64_t* addr_writes;
+
+// Reuse distance: LRU stack of lines, most recent first
+uint32_t* lru_stack;
+uint32_t lru_depth;
+uint64_t distance_hist[DISTANCE_BUCKETS];
+uint64_t cold_accesses;
+
+// Working set
+uint32_t* word_stamp;              // Window number + 1 of the last touch
+uint32_t* line_stamp;
+uint32_t current_window;
+uint32_t window_words, window_lines;
+uint64_t windows, windows_printed;
+uint32_t ws_min = UINT32_MAX, ws_max;
+uint64_t ws_total;
+
+// Strides
+PcStrides pc_strides[MEMORY_SIZE];
+uint32_t last_addr[MAX_CORES][MEMORY_SIZE];  // Previous address per core and PC, +1
+int has_last[MAX_CORES][MEMORY_SIZE];
+
+/************************* Trace Reading *************************/
+uint32_t get_u32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+void* alloc_table(size_t count, size_t size) {
+    void* p = calloc(count, size);
+    if (!p) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+int read_access(FILE* f, Access* a) {
+    uint8_t rec[RECORD_SIZE];
+    if (fread(rec, 1, RECORD_SIZE, f) != RECORD_SIZE) return 0;
+
+    uint32_t pc = rec[4] | (rec[5] << 8);
+    a->cycle = get_u32(rec);
+    a->pc = pc & 0xFFF;
+    a->is_write = (pc & MEMTRACE_WRITE) != 0;
+    a->core = (rec[6] | (rec[7] << 8)) % MAX_CORES;
+    a->addr = get_u32(rec + 8);
+    a->value = get_u32(rec + 12);
+    if (a->addr >= dmem_words) {
+        fprintf(stderr, "Error: Address %X is beyond the %u-word dmem in the header\n", a->addr, dmem_words);
+        exit(1);
+    }
+    return 1;
+}
+
+/************************* Analyses *************************/
+int distance_bucket(uint32_t d) {
+    int b = 0;
+    while (d) {
+        b++;
+        d >>= 1;
+    }
+    return b < DISTANCE_BUCKETS ? b : DISTANCE_BUCKETS - 1;
+}
+
+void record_reuse(uint32_t line) {
+    uint32_t d;
+    for (d = 0; d < lru_depth && lru_stack[d] != line; d++);
+
+    if (d == lru_depth) {
+        cold_accesses++;
+        lru_depth++;
+    }
+    else {
+        distance_hist[distance_bucket(d)]++;
+    }
+    memmove(&lru_stack[1], &lru_stack[0], sizeof(uint32_t) * d);
+    lru_stack[0] = line;
+}
+
+void close_window(void) {
+    if (windows == 0 && window_words == 0) return;
+    if (windows_printed < MAX_WINDOW_ROWS) {
+        printf("  %10llu %8u %8u\n", (unsigned long long)current_window * options.window,
+            window_words, window_lines);
+        windows_printed++;
+    }
+    if (window_words < ws_min) ws_min = window_words;
+    if (window_words > ws_max) ws_max = window_words;
+    ws_total += window_words;
+    windows++;
+    window_words = 0;
+    window_lines = 0;
+}
+
+void record_working_set(const Access* a) {
+    uint32_t window = a->cycle / options.window;
+    uint32_t line = a->addr / options.line_words;
+
+    if (window != current_window) {
+        close_window();
+        current_window = window;
+    }
+    if (word_stamp[a->addr] != window + 1) {
+        word_stamp[a->addr] = window + 1;
+        window_words++;
+    }
+    if (line_stamp[line] != window + 1) {
+        line_stamp[line] = window + 1;
+        window_lines++;
+    }
+}
+
+void record_stride(const Access* a) {
+    PcStrides* s = &pc_strides[a->pc];
+    s->accesses++;
+    if (has_last[a->core][a->pc]) {
+        int32_t stride = (int32_t)a->addr - (int32_t)last_addr[a->core][a->pc];
+        int slot = -1;
+        s->strided++;
+        for (int i = 0; i < STRIDE_SLOTS; i++) {
+            if (s->count[i] && s->stride[i] == stride) slot = i;
+        }
+        if (slot < 0) {
+            for (int i = 0; i < STRIDE_SLOTS && slot < 0; i++) {
+                if (!s->count[i]) {
+                    slot = i;
+                    s->stride[i] = stride;
+                    s->exact[i] = 0;
+                }
+            }
+        }
+        if (slot >= 0) {
+            s->count[slot]++;
+            s->exact[slot]++;
+        }
+        else {
+            for (int i = 0; i < STRIDE_SLOTS; i++) s->count[i]--;
+        }
+    }
+    last_addr[a->core][a->pc] = a->addr;
+    has_last[a->core][a->pc] = 1;
+}
+
+/************************* Reports *************************/
+void report_reuse(void) {
+    uint64_t reuses = 0, hits = 0;
+    for (int b = 0; b < DISTANCE_BUCKETS; b++) reuses += distance_hist[b];
+
+    printf("\nReuse distance (distinct %u-word lines since the last touch):\n", options.line_words);
+    printf("  %-11s %12s   %s\n", "distance", "accesses", "LRU hit rate at cache size");
+    for (int b = 0; b < DISTANCE_BUCKETS; b++) {
+        uint32_t low = b ? 1u << (b - 1) : 0;
+        uint32_t high = b ? (1u << b) - 1 : 0;
+        char range[32];
+        hits += distance_hist[b];
+        if (low == high) snprintf(range, sizeof(range), "%u", low);
+        else snprintf(range, sizeof(range), "%u-%u", low, high);
+        printf("  %-11s %12llu   %5.1f%% with %u lines\n", range, (unsigned long long)distance_hist[b],
+            reuses + cold_accesses ? 100.0 * hits / (reuses + cold_accesses) : 0.0, high + 1);
+        if (hits == reuses) break;
+    }
+    printf("  %-11s %12llu\n", "cold", (unsigned long long)cold_accesses);
+}
+
+void report_strides(void) {
+    uint8_t shown[MEMORY_SIZE] = { 0 };
+
+    printf("\nStrides of the busiest PCs:\n");
+    printf("  %-4s %10s %8s %8s\n", "pc", "accesses", "stride", "regular");
+    for (uint32_t row = 0; row < options.top; row++) {
+        int best = -1;
+        for (int pc = 0; pc < MEMORY_SIZE; pc++) {
+            if (!shown[pc] && pc_strides[pc].accesses &&
+                (best < 0 || pc_strides[pc].accesses > pc_strides[best].accesses)) {
+                best = pc;
+            }
+        }
+        if (best < 0) break;
+        shown[best] = 1;
+
+        PcStrides* s = &pc_strides[best];
+        int top = -1;
+        for (int i = 0; i < STRIDE_SLOTS; i++) {
+            if (s->count[i] && (top < 0 || s->exact[i] > s->exact[top])) top = i;
+        }
+        if (top < 0) {
+            printf("  %03X %10llu %8s %8s\n", best, (unsigned long long)s->accesses, "-", "-");
+        }
+        else {
+            printf("  %03X %10llu %8d %7.1f%%\n", best, (unsigned long long)s->accesses, s->stride[top],
+                s->strided ? 100.0 * s->exact[top] / s->strided : 0.0);
+        }
+    }
+}
+
+void report_hot_addresses(void) {
+    uint8_t* shown = (uint8_t*)alloc_table(dmem_words, 1);
+    int width = 3;  // Hex digits of the highest address
+    while (width < 8 && (dmem_words - 1) >> (4 * width)) width++;
+
+    printf("\nHot addresses:\n");
+    printf("  %-*s %10s %10s\n", width, "addr", "reads", "writes");
+    for (uint32_t row = 0; row < options.top; row++) {
+        int64_t best = -1;
+        for (uint32_t addr = 0; addr < dmem_words; addr++) {
+            uint64_t n = addr_reads[addr] + addr_writes[addr];
+            if (!shown[addr] && n &&
+                (best < 0 || n > addr_reads[best] + addr_writes[best])) {
+                best = addr;
+            }
+        }
+        if (best < 0) break;
+        shown[best] = 1;
+        printf("  %0*X %10llu %10llu\n", width, (uint32_t)best, (unsigned long long)addr_reads[best],
+            (unsigned long long)addr_writes[best]);
+    }
+    free(shown);
+}
+
+/************************* Main Function *************************/
+int main(int argc, char* argv[]) {
+    int i = 1;
+    while (i + 1 < argc && strncmp(argv[i], "--", 2) == 0) {
+        uint32_t value = (uint32_t)strtoul(argv[i + 1], NULL, 0);
+        if (strcmp(argv[i], "--window") == 0 && value) options.window = value;
+        else if (strcmp(argv[i], "--line") == 0 && value) options.line_words = value;
+        else if (strcmp(argv[i], "--top") == 0) options.top = value;
+        else {
+            fprintf(stderr, "Error: Unknown or invalid option %s\n", argv[i]);
+            return 1;
+        }
+        i += 2;
+    }
+    if (argc - i != 1) {
+        fprintf(stderr, "Usage: %s [--window CYCLES] [--line WORDS] [--top N] memtrace.bin\n", argv[0]);
+        return 1;
+    }
+
+    FILE* f = fopen(argv[i], "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open %s\n", argv[i]);
+        return 1;
+    }
+    char magic[8];
+    uint8_t header[HEADER_SIZE];
+    if (fread(magic, 1, 8, f) != 8 || memcmp(magic, MEMTRACE_MAGIC, 8) != 0 ||
+        fread(header, 1, HEADER_SIZE, f) != HEADER_SIZE || get_u32(header) == 0) {
+        fprintf(stderr, "Error: %s is not a SIMP memory trace (%s)\n", argv[i], MEMTRACE_MAGIC);
+        fclose(f);
+        return 1;
+    }
+    dmem_words = get_u32(header);
+    addr_reads = (uint64_t*)alloc_table(dmem_words, sizeof(uint64_t));
+    addr_writes = (uint64_t*)alloc_table(dmem_words, sizeof(uint64_t));
+    lru_stack = (uint32_t*)alloc_table(dmem_words, sizeof(uint32_t));
+    word_stamp = (uint32_t*)alloc_table(dmem_words, sizeof(uint32_t));
+    line_stamp = (uint32_t*)alloc_table(dmem_words, sizeof(uint32_t));
+
+    printf("Working set per %u cycles:\n", options.window);
+    printf("  %10s %8s %8s\n", "cycle", "words", "lines");
+
+    Access a;
+    uint64_t footprint_words = 0;
+    while (read_access(f, &a)) {
+        if (reads + writes == 0) first_cycle = a.cycle;
+        last_cycle = a.cycle;
+        if (a.is_write) {
+            writes++;
+            footprint_words += !addr_reads[a.addr] && !addr_writes[a.addr];
+            addr_writes[a.addr]++;
+        }
+        else {
+            reads++;
+            footprint_words += !addr_reads[a.addr] && !addr_writes[a.addr];
+            addr_reads[a.addr]++;
+        }
+        record_working_set(&a);
+        record_reuse(a.addr / options.line_words);
+        record_stride(&a);
+    }
+    fclose(f);
+
+    close_window();
+    if (windows > windows_printed) {
+        printf("  ... %llu more windows\n", (unsigned long long)(windows - windows_printed));
+    }
+    if (windows) {
+        printf("  words per window: min %u, average %.1f, max %u\n", ws_min,
+            (double)ws_total / windows, ws_max);
+    }
+
+    printf("\n%llu accesses (%llu reads, %llu writes) in cycles %u-%u, footprint %llu words\n",
+        (unsigned long long)(reads + writes), (unsigned long long)reads, (unsigned long long)writes,
+        first_cycle, last_cycle, (unsigned long long)footprint_words);
+
+    report_reuse();
+    report_strides();
+    report_hot_addresses();
+    return 0;
+}
@@ -7,6 +7,7 @@
  * - I/O devices and interrupts
  * - Disk operations
  * - Monitor and LED outputs
+ * - Several cores sharing dmem and the devices
  *****************************************************************/
 
 #define _CRT_SECURE_NO_WARNINGS
@@ -14,22 +15,253 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <time.h>
+#include <math.h>
+
+// Host SIMD for the vector extension; plain loops elsewhere
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMP_HAVE_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#endif
+
+// Host threads for multi-core runs; without them cores take turns on one thread
+#if defined(__unix__) || defined(__APPLE__)
+#define SIMP_HAVE_THREADS 1
+#include <pthread.h>
+#endif
+
+// Memories come from the OS as demand-zero pages, so untouched parts of a
+// large dmem, disk or monitor cost no host memory
+#if defined(__unix__) || defined(__APPLE__)
+#define SIMP_HAVE_MMAP 1
+#include <sys/mman.h>
+#elif defined(_WIN32)
+#define SIMP_HAVE_VIRTUALALLOC 1
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+// Live metrics are published in a named shared-memory segment
+#if defined(__unix__) || defined(__APPLE__)
+#define SIMP_HAVE_SHM 1
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Atomic read-modify-write on shared dmem
+#if defined(__GNUC__) || defined(__clang__)
+#define ATOMIC_SWAP(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define ATOMIC_FETCH_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define FENCE_RELEASE() __atomic_thread_fence(__ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define ATOMIC_SWAP(p, v) (uint32_t)_InterlockedExchange((volatile long*)(p), (long)(v))
+#define ATOMIC_FETCH_ADD(p, v) (uint32_t)_InterlockedExchangeAdd((volatile long*)(p), (long)(v))
+#define STORE_RELEASE(p, v) (_ReadWriteBarrier(), *(volatile uint32_t*)(p) = (v))  // x86 keeps store order
+#define FENCE_RELEASE() _ReadWriteBarrier()
+#else
+static uint32_t plain_swap(uint32_t* p, uint32_t v) { uint32_t old = *p; *p = v; return old; }
+static uint32_t plain_fetch_add(uint32_t* p, uint32_t v) { uint32_t old = *p; *p += v; return old; }
+#define ATOMIC_SWAP(p, v) plain_swap((p), (v))
+#define ATOMIC_FETCH_ADD(p, v) plain_fetch_add((p), (v))
+#define STORE_RELEASE(p, v) (*(volatile uint32_t*)(p) = (v))
+#define FENCE_RELEASE() ((void)0)
+#endif
 
  /************************* Constants *************************/
-#define MEMORY_SIZE 4096
-#define DISK_SIZE 16384      // 128 sectors * 128 words per sector
-#define MONITOR_SIZE 256
+#define MEMORY_SIZE 4096          // imem, and the default dmem size
+#define DISK_SIZE 16384           // Default disk: 128 sectors * 128 words per sector
+#define MONITOR_SIZE 256          // Default monitor side
+#define MAX_MONITOR_SIZE 1024
+#define MAX_MEMORY_WORDS (1u << 30) // dmem and disk limit, 4 GB each
+#define HOST_PAGE_BYTES 4096      // Granularity of sparse copies
 #define MAX_LINE_LENGTH 500
-#define DISK_BUSY_CYCLES 1024
+#define VECTOR_REGS 16            // $vr0 always reads as zero
+#define VECTOR_LANES 8
+#define MAX_PREDICTORS 8
+#define LOOP_DEPTH 4              // Nested hardware loops
+#define MAX_CORES 16
+#define IO_REGISTERS 29
+#define BUS_IDLE 0xFFFFFFFFu      // bus_next when no device has an event coming
+#define TRAP_OPCODE 63            // Patched into decoded entries for breakpoints
+#define MAX_BREAKPOINTS 64
+#define MAX_WATCHPOINTS 16
+#define DEBUG_PAGE_WORDS 128      // dmem watch granularity
+#define WATCH_READ 1
+#define WATCH_WRITE 2
+#define SNAPSHOT_PAGE_BYTES 512
+#define SEEK_GOTO 1               // Replaying up to goto_cycle
+#define SEEK_BACK 2               // Replaying to find the previous instruction
+#define IRQ2_BINARY_MAGIC "SIMPIRQ2"
+#define METRICS_MAGIC "SIMPMETR"
+#define METRICS_VERSION 1
+#define COSIM_INSTRUCTION 1       // Compare after every instruction
+#define COSIM_BLOCK 2             // Compare at the end of every basic block
+#define COSIM_CYCLES 3            // Compare every cosim.every cycles
+#define COSIM_WINDOW 32           // Instructions kept for the mismatch report
+#define COSIM_MAX_DIFFS 16
+#define COSIM_FULL_CYCLES 65536   // Disk and monitor are compared this often and at halt
+#define FUZZ_MAP_SIZE 65536       // Edge coverage bitmap entries
+#define FUZZ_MAX_IRQ2 64          // irq2 events per input
+#define FUZZ_MAX_PATCHES 32       // dmem words an input overrides
+#define FUZZ_CORPUS_MAX 4096
+#define FUZZ_MAX_CRASHES 64       // Distinct (kind, pc) crashes kept
+#define FUZZ_OK 0
+#define FUZZ_HANG 1               // Still running at the cycle budget
+#define FUZZ_DEADLOCK 2           // wfi with nothing left to wake it
+#define FUZZ_BAD_PC 3
+#define FUZZ_ILLEGAL_OPCODE 4
+#define FUZZ_BAD_LOAD 5
+#define FUZZ_BAD_STORE 6
+#define FUZZ_BAD_IO 7
+#define SAMPLE_FIXED 0            // Window at the end of every interval
+#define SAMPLE_RANDOM 1           // Window at a random offset in every interval
+#define SAMPLE_PHASE 2            // Window only in intervals of phases measured too little
+#define SAMPLE_FAST 0             // Interval states: before the window
+#define SAMPLE_WARM 1
+#define SAMPLE_MEASURE 2
+#define SAMPLE_SKIP 3             // After the window, or no window in this interval
+#define SAMPLE_BUCKETS 32         // PC histogram buckets of a phase signature
+#define SAMPLE_PROBE_INSTRUCTIONS 64  // Between PC probes of the signature
+#define SAMPLE_MAX_PHASES 64
+#define SAMPLE_PHASE_WINDOWS 3    // Windows per phase before its intervals are only fast-forwarded
+#define SAMPLE_PHASE_DISTANCE 0.25    // Signature distance (0..2) of intervals in one phase
+#define DISK_SECTOR_WORDS 128
+#define DISK_SEEK_CYCLES 512      // Per command or descriptor
+#define DISK_SECTOR_CYCLES 512    // Per sector transferred (one sector = 1024 cycles in total)
+#define DISK_QUEUE_SIZE 8
+#define DISK_CMD_READ 1
+#define DISK_CMD_WRITE 2
+#define DISK_CMD_GATHER_READ 3    // Descriptors at dmem[diskdesc]: sector, buffer, count; count 0 ends
+#define DISK_CMD_SCATTER_WRITE 4
+#define DISK_IRQ_PER_COMMAND 0
+#define DISK_IRQ_PER_BATCH 1      // Only when the queue drains
+#define MONITOR_CMD_WRITE 1
+#define MONITOR_CMD_VSYNC 2
+#define MONITOR_CMD_FILL_RECT 3      // Fill monitorsize (w | h << 16) at monitoraddr with monitordata
+#define MONITOR_CMD_FILL_SPAN 4      // Fill monitorsize pixels from monitoraddr with monitordata
+#define MONITOR_CMD_COPY_RECT 5      // Copy a w x h region packed 4 pixels per word from dmem[monitorsrc]
+#define MONITOR_CMD_IRQ 0x100        // Command flag: raise irq2 on completion
+#define MONITOR_SETUP_CYCLES 8
+#define MONITOR_PIXELS_PER_CYCLE 4   // 32-bit frame buffer bus
+#define MONITOR_DELTA_MAGIC "SIMPMON1"
+#define MEMTRACE_MAGIC "SIMPMEM2"
+#define MEMTRACE_WRITE 0x8000        // Flag in the pc field of a record
+#define VERIFY_CHUNK 65536           // Expected-file bytes read at a time by --verify
+#define VERIFY_CONTEXT 2             // Matching lines shown before a difference
 
 /************************* Data Structures *************************/
 typedef struct {
+    uint32_t opcode;
+    uint32_t rd;
+    uint32_t rs;
+    uint32_t rt;
+    uint32_t rm;
+    uint32_t immediate1;
+    uint32_t immediate2;
+} Instruction;
+
+typedef struct {
+    // Geometry and policy
+    uint32_t sets;
+    uint32_t ways;
+    uint32_t line_words;
+    uint32_t line_shift;         // log2(line_words)
+    int write_back;              // Write-back/allocate, else write-through/no-allocate
+    uint32_t miss_penalty;
+
+    // Tag store, sets * ways entries
+    uint32_t* tags;
+    uint64_t* last_use;          // LRU stamps, 0 = invalid
+    uint8_t* dirty;
+    uint64_t clock;
+
+    // Statistics
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t read_misses;
+    uint64_t write_misses;
+    uint64_t writebacks;
+    uint64_t stall_cycles;
+    uint32_t pc_accesses[MEMORY_SIZE];
+    uint32_t pc_misses[MEMORY_SIZE];
+} Cache;
+
+// A branch predictor: a direction policy plus a BTB for register targets
+typedef struct Predictor Predictor;
+struct Predictor {
+    char name[32];
+    int (*predict)(Predictor* p, uint32_t pc, uint32_t target);  // Target is 0xFFFFFFFF if unknown
+    void (*update)(Predictor* p, uint32_t pc, int taken);
+
+    // Direction state
+    uint8_t* counters;           // 2-bit saturating counters
+    uint32_t mask;
+    uint32_t history;            // Global history (gshare)
+
+    // Branch target buffer, direct mapped
+    uint32_t* btb_tags;
+    uint32_t* btb_targets;
+    uint32_t btb_mask;
+
+    // Statistics
+    uint64_t branches;
+    uint64_t mispredicts;
+    uint64_t target_mispredicts;
+    uint32_t pc_branches[MEMORY_SIZE];
+    uint32_t pc_mispredicts[MEMORY_SIZE];
+};
+
+typedef struct {
+    // Configuration
+    uint32_t branch_penalty;     // Taken conditional branch (resolved in EX)
+    uint32_t jump_penalty;       // jal and reti (resolved in ID)
+    uint32_t interrupt_penalty;  // Pipeline flush on interrupt entry
+
+    // State of the previous instruction
+    uint32_t prev_dest;          // Register written by the previous load, 0 if none
+    uint32_t expected_pc;        // Where the previous instruction went
+
+    // Statistics
+    uint64_t instructions;
+    uint64_t load_use_stalls;
+    uint64_t branch_stalls;
+    uint64_t jump_stalls;
+    uint64_t interrupt_stalls;
+    uint64_t memory_stalls;
+    uint32_t pc_stalls[MEMORY_SIZE];
+} Pipeline;
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t sector;
+    uint32_t buffer;
+    uint32_t count;              // Sectors for read/write
+    uint32_t desc;               // Descriptor list for scatter/gather
+} DiskCommand;
+
+typedef struct {
+    uint32_t start;              // First body instruction
+    uint32_t end;                // First instruction after the body
+    uint32_t count;              // Iterations left, the current one included
+    uint32_t in_interrupt;       // Armed by the interrupt handler
+} HardwareLoop;
+
+typedef struct Processor {
     // CPU registers and state
     uint32_t registers[16];      // R0-R15
+    uint32_t vregs[VECTOR_REGS][VECTOR_LANES];  // Vector registers
+    uint32_t vl;                 // Active vector length (1..VECTOR_LANES)
     uint32_t pc;                 // Program counter
-    uint64_t imem[MEMORY_SIZE];  // Instruction memory
-    uint32_t dmem[MEMORY_SIZE];  // Data memory
-    uint32_t disk[DISK_SIZE];    // Disk storage
+    HardwareLoop loops[LOOP_DEPTH];  // Armed hardware loops, innermost last
+    uint32_t loop_depth;
+    uint32_t* dmem;              // Data memory, core 0's on every core
 
     // Interrupt registers
     uint32_t irq0enable;
@@ -41,6 +273,10 @@ typedef struct {
     uint32_t irqhandler;
     uint32_t irqreturn;
     int in_interrupt;
+    uint64_t irq_entries[3];     // Handler entries with irq0, irq1, irq2 pending
+    uint32_t irq_raised[3];      // Device interrupts raised on this core, by line
+    uint32_t irq_seen[3];        // Core 0's irq_raised already latched here
+    int waiting;                 // Sleeping in wfi until an enabled IRQ is pending
 
     // Timer registers
     uint32_t timerenable;
@@ -52,13 +288,37 @@ typedef struct {
     uint32_t disksector;
     uint32_t diskbuffer;
     uint32_t diskstatus;
+    uint32_t diskcount;          // Sectors per read/write command, 0 counts as 1
+    uint32_t diskdesc;           // dmem address of the scatter/gather descriptors
+    uint32_t diskirqmode;        // DISK_IRQ_PER_COMMAND or DISK_IRQ_PER_BATCH
     uint32_t disk_busy_cycles;
+    uint64_t disk_busy_total;    // Busy cycles of finished commands
+    uint32_t disk_latency;       // Total cycles of the command at the queue head
+    DiskCommand disk_queue[DISK_QUEUE_SIZE];
+    uint32_t disk_queue_head;
+    uint32_t disk_queue_count;
 
     // Monitor registers
     uint32_t monitoraddr;
     uint32_t monitordata;
-    uint32_t monitorcmd;
-    uint8_t monitor_buffer[MONITOR_SIZE][MONITOR_SIZE];
+    uint32_t monitorcmd;          // Command in progress, 0 when idle
+    uint32_t monitorsize;         // Region size for fill/copy commands
+    uint32_t monitorsrc;          // dmem source address for copy commands
+    uint32_t monitor_busy_cycles; // Cycles left for the command in progress
+    uint32_t monitor_op_addr;     // Operands latched when the command was accepted
+    uint32_t monitor_op_size;
+    uint32_t monitor_op_src;
+    uint32_t monitor_op_data;
+
+    // Monitor dirty tracking for streaming output
+    int monitor_dirty;                          // Something changed since the last frame
+    int monitor_vsync;                          // Guest asked for a frame (monitorcmd = 2)
+    uint32_t monitor_frame_cycles;              // Frame period, 0 = vsync and halt only
+    uint32_t monitor_next_frame;                // Cycle of the next periodic frame
+    uint32_t monitor_dirty_top;                 // Dirty rows range, top > bottom if clean
+    uint32_t monitor_dirty_bottom;
+    uint16_t monitor_dirty_min_x[MAX_MONITOR_SIZE]; // Dirty span per row, min > max if clean
+    uint16_t monitor_dirty_max_x[MAX_MONITOR_SIZE];
 
     // I/O registers
     uint32_t leds;
@@ -66,79 +326,591 @@ typedef struct {
 
     // Simulation state
     uint32_t cycle_counter;
+    uint32_t stall_cycles;       // Memory stall cycles before the next fetch
+    Cache* dcache;               // Optional data cache timing model, NULL if disabled
+    Pipeline* pipeline;          // Optional pipeline timing model, NULL if disabled
+    Predictor* predictors[MAX_PREDICTORS];  // Branch predictors fed the same stream
+    int num_predictors;
+    int last_mispredict;         // First predictor missed the last branch
     int halt;
+    uint32_t bus_synced;         // Device ticks of earlier cycles are applied
+    uint32_t bus_next;           // Cycle of the next device event, BUS_IDLE if none
+
+    // Multi-core: devices (registers 9-26) belong to core 0; interrupt
+    // registers, clks and the register file are per core. Device
+    // interrupts are raised on core 0 and latched by every core
+    uint32_t core_id;
+    struct Processor* io;        // Core owning the devices
+    uint64_t instructions;       // Retired on this core
+
+    // Sized by --dmem-size, --disk-size and --monitor-size and allocated
+    // by alloc_memories; snapshots save them by page
+    uint32_t* disk;              // Disk storage
+    uint8_t* monitor_buffer;     // Row-major, monitor_size * monitor_size pixels
+
+    // Memories, kept last: snapshots copy everything above imem
+    uint64_t imem[MEMORY_SIZE];  // Instruction memory
+    Instruction decoded[MEMORY_SIZE];  // imem decoded once at load
 } Processor;
 
+// One I/O register. Reads and writes go to a Processor field unless a
+// handler is given
 typedef struct {
-    uint32_t opcode;
-    uint32_t rd;
-    uint32_t rs;
-    uint32_t rt;
-    uint32_t rm;
-    uint32_t immediate1;
-    uint32_t immediate2;
-} Instruction;
+    uint32_t address;
+    const char* name;
+    size_t field;                                    // offsetof(Processor, ...)
+    uint32_t write_mask;                             // Bits a write stores, 0 = read-only
+    uint32_t (*read)(Processor* proc);
+    void (*write)(Processor* proc, uint32_t value);
+} IoRegister;
+
+// A device plugin: its registers and, for devices that change state on
+// their own, an event interface. One tick is the device's work in one cycle
+typedef struct {
+    const char* name;
+    const IoRegister* registers;
+    int num_registers;
+    int shared;                                      // Core 0's, used by every core under the device lock
+    uint32_t (*next_event)(Processor* proc);         // Ticks until the next one that changes state, 0 if idle
+    void (*advance)(Processor* proc, uint32_t ticks); // Ticks before that one
+    void (*on_event)(Processor* proc);               // One tick, doing whatever is due
+} Device;
+
+typedef struct {
+    const IoRegister* registers[IO_REGISTERS];
+    const Device* owner[IO_REGISTERS];
+    const Device* timed[IO_REGISTERS];               // Devices with events
+    int num_timed;
+} IoBus;
+
+// Where an irq2 source is; snapshots save it to rewind the source
+typedef struct {
+    uint32_t next;               // Cycle of the next event
+    int done;                    // No events left
+    uint64_t emitted;            // Events produced, next included
+    uint64_t last;               // Generators: cycle of next without wrapping
+    uint64_t nominal;            // Jittered: the unjittered cycle of next
+    uint64_t rng;
+    int list_pos;
+    fpos_t file_pos;             // Files: where reading resumes
+} Irq2Position;
+
+enum { IRQ2_TEXT, IRQ2_BINARY, IRQ2_LIST, IRQ2_PERIODIC, IRQ2_JITTER, IRQ2_POISSON };
+
+// irq2 events in increasing cycle order, produced one at a time
+typedef struct {
+    int kind;
+    FILE* f;                     // IRQ2_TEXT and IRQ2_BINARY
+    const uint32_t* list;        // IRQ2_LIST, sorted
+    int list_count;
+    uint32_t period;             // Periodic and jittered: cycles between events
+    uint32_t jitter;             // Jittered: events move up to this far either way
+    double mean;                 // Poisson: mean cycles between events
+    uint64_t limit;              // Events produced at most, 0 = no limit
+    int warned;                  // Out-of-order events reported once
+    Irq2Position pos;
+} Irq2Source;
+
+// An output file, or with --verify the expected file it is compared to
+typedef struct {
+    char path[MAX_LINE_LENGTH];  // Written normally, or once verification fails
+    char expected_path[MAX_LINE_LENGTH];
+    int binary;
+    FILE* f;                     // NULL while verifying
+    FILE* expected;              // NULL if DIR has no such file: not checked
+    char spool_path[MAX_LINE_LENGTH + 8];  // An unchecked output, kept only if verification fails
+    char* buffer;                // Expected bytes read ahead
+    size_t buffered;
+    size_t used;
+    uint64_t matched;            // Bytes equal to the expected file
+    int failed;
+    char actual[MAX_LINE_LENGTH];  // Output from the first difference to the end of its line
+    size_t actual_length;
+    int actual_done;
+} OutputFile;
+
+// Per-core output files and change tracking for the run loop
+typedef struct {
+    Processor* proc;
+    OutputFile* trace;
+    OutputFile* hwregtrace;
+    OutputFile* leds;            // Device outputs, core 0 only
+    OutputFile* display7seg;
+    OutputFile* monitor_stream;
+    Irq2Source* irq2;            // irq2 input; only core 0 reads it while it runs
+    uint32_t prev_leds;
+    uint32_t prev_display;
+    uint64_t trace_bytes;        // Written to trace and hwregtrace
+} CoreContext;
+
+typedef struct {
+    const char* monitor_stream;      // Per-frame monitor output file, NULL if disabled
+    uint32_t monitor_frame_cycles;   // Emit a frame every N cycles, 0 = vsync only
+    int monitor_delta;               // Write changed spans instead of full YUV frames
+    uint32_t dcache_words;           // Data cache size, 0 = no cache model
+    uint32_t dcache_ways;
+    uint32_t dcache_line;            // Words per line
+    int dcache_write_through;
+    uint32_t dcache_penalty;         // Stall cycles per line fill or writeback
+    int pipeline;                    // Report 5-stage pipeline timing
+    uint32_t pipeline_branch_penalty;  // Per taken branch, or per misprediction with --bpred
+    const char* predictors[MAX_PREDICTORS];  // Branch predictor specs
+    int num_predictors;
+    uint32_t btb_entries;
+    uint32_t cores;
+    uint32_t quantum;                // Cycles each core runs between barriers
+    int lockstep;                    // All cores on one host thread, one cycle at a time
+    int debug;                       // Interactive debugger on stdin
+    uint32_t snapshot_every;         // Cycles between time-travel snapshots
+    uint32_t snapshot_limit;
+    const char* memtrace;            // Binary dmem access trace file, NULL if disabled
+    int host_stats;                  // Print host timing to stderr for the benchmark harness
+    uint32_t dmem_size;              // Words
+    uint32_t disk_size;              // Words, whole sectors
+    uint32_t monitor_size;           // Pixels per side
+    const char* cosim;               // Co-simulation granularity: insn, block or cycles
+    uint64_t fuzz_execs;             // Fuzz instead of a normal run, 0 = off
+    uint32_t fuzz_budget;            // Cycles before a fuzz exec is a hang
+    uint64_t fuzz_seed;
+    const char* fuzz_crashes;        // Prefix of the crash reproducer files, NULL = not saved
+    const char* irq2_gen;            // irq2 generator spec replacing irq2in.txt, NULL if none
+    uint64_t irq2_seed;
+    uint64_t irq2_limit;             // Generated events at most, 0 = no limit
+    const char* metrics;             // Shared-memory segment for simp-top, NULL if disabled
+    uint32_t metrics_every;          // Cycles between metric updates
+    uint64_t sample_period;          // Instructions per sampling interval, 0 = timing models run throughout
+    uint64_t sample_warmup;          // Instructions warming the models before each window
+    uint64_t sample_window;          // Instructions measured per window
+    int sample_schedule;             // SAMPLE_FIXED, SAMPLE_RANDOM or SAMPLE_PHASE
+    uint64_t sample_seed;
+    const char* verify;              // Compare outputs with the files in this directory, NULL if off
+} SimOptions;
+
+typedef struct {
+    uint32_t pc;
+    Instruction original;        // Decoded entry the trap replaced
+} Breakpoint;
+
+typedef struct {
+    uint32_t start;              // dmem words start..end inclusive
+    uint32_t end;
+    int flags;                   // WATCH_READ | WATCH_WRITE
+} Watchpoint;
+
+typedef struct {
+    int enabled;
+    int pending;                 // Stop check after the current instruction
+    uint32_t steps;              // Instructions left to single-step, 0 when running
+    char reason[MAX_LINE_LENGTH];
+    Breakpoint breakpoints[MAX_BREAKPOINTS];
+    int num_breakpoints;
+    Watchpoint watchpoints[MAX_WATCHPOINTS];
+    int num_watchpoints;
+    uint8_t* pages;              // Watch flags of any watchpoint per dmem page
+    uint32_t io_watch;           // Bit per I/O register
+    Processor** cores;
+    int num_cores;
+    uint32_t last_stop_core;     // Where the last prompt was, so a breakpoint
+    uint32_t last_stop_cycle;    // reached by stepping does not stop twice
+    uint32_t last_stop_pc;
+
+    // Time travel
+    int seeking;                 // SEEK_GOTO, SEEK_BACK or 0
+    uint32_t goto_cycle;
+    uint32_t back_cycle;         // step-back: stop before this instruction boundary
+    uint32_t back_found;         // Last boundary seen before back_cycle
+    int back_have;
+    int back_snapshot;           // Snapshot the current scan started from
+    int restored;                // State was replaced while stopped
+    uint32_t high_water;         // Outputs are already written below this cycle
+} Debugger;
+
+typedef struct {
+    uint32_t cycle;
+    uint8_t* state;              // Processor fields before imem
+    Cache* dcache;               // Copy of the cache model, NULL without one
+    uint32_t prev_leds;
+    uint32_t prev_display;
+    Irq2Position irq2;
+    int num_pages;               // Pages that changed since the previous snapshot
+    uint32_t* page_ids;
+    uint8_t* pages;
+} Snapshot;
+
+typedef struct {
+    uint32_t every;              // Cycles between snapshots, 0 = off
+    uint32_t limit;              // Snapshots kept
+    uint32_t interval;           // Current spacing, doubles when thinned
+    uint32_t next;               // Cycle of the next snapshot
+    Snapshot* list;
+    int count;
+    uint8_t* shadow;             // dmem, disk and monitor at the last snapshot
+    int dmem_pages;              // Page ids: dmem, then disk, then monitor
+    int disk_pages;
+    int num_pages;
+    size_t bytes;                // Page data held
+    CoreContext* ctx;
+} Snapshots;
+
+// A reference Processor stepped alongside the fast run loop
+typedef struct {
+    int granularity;             // COSIM_INSTRUCTION, COSIM_BLOCK, COSIM_CYCLES, 0 = off
+    uint32_t every;              // Cycles between checks for COSIM_CYCLES
+    uint32_t next_check;
+    uint32_t next_full;          // Next cycle at which disk and monitor are compared
+    Processor* ref;
+    int reference_active;        // The reference is executing: plain loops, no memtrace
+    Irq2Source irq2;             // A second copy of the run's source
+    uint32_t good_cycle;         // Last cycle at which both agreed
+    uint64_t checks;
+    uint32_t window_pc[COSIM_WINDOW];     // Fast-engine instructions since good_cycle
+    uint32_t window_cycle[COSIM_WINDOW];
+    Instruction window_inst[COSIM_WINDOW];
+    uint32_t window_count;
+} Cosim;
+
+// One fuzz case: irq2 event cycles and dmem words that replace dmemin's
+typedef struct {
+    uint32_t irq2[FUZZ_MAX_IRQ2];
+    int irq2_count;
+    uint32_t patch_addr[FUZZ_MAX_PATCHES];
+    uint32_t patch_value[FUZZ_MAX_PATCHES];
+    int num_patches;
+} FuzzInput;
+
+typedef struct {
+    int kind;
+    uint32_t pc;
+    uint32_t cycle;
+    uint64_t count;
+} FuzzCrash;
+
+typedef struct {
+    int active;                  // Watch pages are tracking dirty dmem
+    uint64_t rng;
+    uint32_t budget;             // Cycles before an exec counts as a hang
+    Processor* base;             // State after loading, restored before each exec
+    uint32_t* base_dmem;
+    uint32_t* base_disk;
+    uint8_t* base_monitor;
+    uint32_t patch_range;        // Patches go to dmem[0..patch_range)
+
+    // Pages written by the current exec
+    uint32_t* dirty_dmem;
+    int num_dirty_dmem;
+    uint8_t* disk_dirty;         // Per sector
+    uint32_t* dirty_disk;
+    int num_dirty_disk;
+
+    // Edge coverage over (previous pc, pc), shared by all execs
+    uint8_t coverage[FUZZ_MAP_SIZE];
+    uint32_t edges;
+    uint32_t prev_loc;
+    uint32_t fault_pc;
+
+    FuzzInput* corpus;
+    int corpus_count;
+    FuzzCrash crashes[FUZZ_MAX_CRASHES];
+    int num_crashes;
+    uint64_t execs;
+    uint64_t total_crashes;
+    uint64_t pages_reset;
+} Fuzzer;
+
+// Layout shared with simp-top; bump METRICS_VERSION on any change
+typedef struct {
+    char magic[8];               // METRICS_MAGIC
+    uint32_t version;
+    uint32_t size;               // sizeof(SimMetrics)
+    uint32_t seq;                // Odd while an update is being written
+    uint32_t pid;
+    uint32_t halted;
+    uint32_t pc;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t host_ns;            // Since the simulator started
+    uint64_t irq_entries[3];
+    uint64_t trace_bytes;
+    uint64_t updates;
+    uint32_t leds;
+    uint32_t display7seg;
+    uint32_t disk_busy_permille; // Over the last interval
+    uint32_t every;              // Cycles between updates
+    double mips;                 // Over the last interval
+} SimMetrics;
+
+// A program assembled in memory by simp run, replacing imemin and dmemin.
+// Same layout as ProgramImage in asm.c
+typedef struct {
+    uint64_t imem[MEMORY_SIZE];
+    int imem_words;
+    uint32_t* dmem;
+    int dmem_words;
+} ProgramImage;
+
+typedef struct {
+    uint32_t every;              // Cycles between updates, 0 = off
+    uint32_t next;               // Cycle of the next update
+    SimMetrics* shared;
+    char name[MAX_LINE_LENGTH];  // Segment name as the OS wants it
+#if defined(SIMP_HAVE_VIRTUALALLOC)
+    HANDLE mapping;
+#endif
+    uint64_t last_ns;            // At the previous update
+    uint64_t last_instructions;
+    uint64_t last_cycles;
+    uint64_t last_disk_busy;
+} Metrics;
+
+// Intervals whose PC signatures are alike, and the CPI of their windows
+typedef struct {
+    double signature[SAMPLE_BUCKETS];  // PC share per bucket of the first interval
+    uint64_t intervals;
+    uint64_t instructions;
+    uint32_t windows;
+    double cpi_sum;
+    double cpi_squares;
+} SamplePhase;
+
+typedef struct {
+    uint64_t period;             // Instructions per interval, 0 = off
+    uint64_t next;               // Instruction count of the next event
+    uint64_t rng;
+    int state;                   // SAMPLE_FAST, SAMPLE_WARM, SAMPLE_MEASURE or SAMPLE_SKIP
+    uint64_t interval_start;
+    uint64_t warm_at;            // Models attach here; the window starts warmup later
+    uint64_t window_instructions;  // At the start of the window
+    uint64_t window_cycles;      // Modeled cycles at the start of the window
+    int phase;                   // Of the current interval, -1 until classified
+    uint32_t probes[SAMPLE_BUCKETS];  // PC probes of the current interval
+    uint32_t num_probes;
+    uint64_t next_probe;
+    uint64_t detailed;           // Instructions run with the models attached
+
+    // The timing models, on the core only while warming or measuring
+    Cache* dcache;
+    Pipeline* pipeline;
+    int num_predictors;
+
+    SamplePhase phases[SAMPLE_MAX_PHASES];
+    int num_phases;
+} Sampling;
 
 /************************* Function Prototypes *************************/
 // Initialization
 void init_processor(Processor* proc);
 int load_memory32(const char* filename, uint32_t* memory, int size, int word_size);
 int load_memory64(const char* filename, uint64_t* memory, int size, int word_size);
-int load_irq2_timing(const char* filename, uint32_t* timing, int* count);
+
+// Memory allocation
+void* alloc_memory(size_t bytes);
+void free_memory(void* p, size_t bytes);
+void copy_sparse(void* dst, const void* src, size_t bytes);
+void alloc_memories(Processor* proc);
+void free_memories(Processor* proc);
+uint8_t* monitor_pixel(Processor* proc, uint32_t x, uint32_t y);
+uint32_t output_words(const uint32_t* memory, uint32_t size, uint32_t default_size);
 
 // Instruction handling
+void predecode_program(Processor* proc);
 Instruction decode_instruction(uint64_t word);
 void execute_instruction(Processor* proc, Instruction inst);
+void start_hardware_loop(Processor* proc, uint32_t count, uint32_t end);
+void end_hardware_loop(Processor* proc);
+void exit_hardware_loops(Processor* proc, uint32_t from);
+void execute_vector_instruction(Processor* proc, Instruction inst);
 
 // I/O operations
 void handle_io_read(Processor* proc, uint32_t address, uint32_t* value);
 void handle_io_write(Processor* proc, uint32_t address, uint32_t value);
 void update_devices(Processor* proc);
+void tick_devices(Processor* proc);
+
+// I/O bus
+void init_io_bus(void);
+const char* io_register_name(uint32_t address);
+uint32_t io_read(Processor* proc, const IoRegister* r);
+void io_write(Processor* proc, const IoRegister* r, uint32_t value);
+void bus_sync(Processor* proc, uint32_t end);
+void bus_schedule(Processor* proc);
+uint32_t device_cycle(Processor* proc);
 
 // Interrupt handling
 void check_interrupts(Processor* proc);
 void handle_timer(Processor* proc);
+uint32_t timer_next_event(Processor* proc);
+void timer_advance(Processor* proc, uint32_t ticks);
 void handle_disk(Processor* proc);
-void check_irq2(Processor* proc, uint32_t* irq2_timing, int irq2_count);
+uint32_t disk_next_event(Processor* proc);
+void disk_advance(Processor* proc, uint32_t ticks);
+void enqueue_disk_command(Processor* proc, uint32_t cmd);
+void start_disk_command(Processor* proc);
+void disk_transfer(Processor* proc, uint32_t cmd, uint32_t sector, uint32_t buffer, uint32_t count);
+void handle_monitor(Processor* proc);
+uint32_t monitor_next_event(Processor* proc);
+void monitor_advance(Processor* proc, uint32_t ticks);
+void start_monitor_command(Processor* proc, uint32_t value);
+void execute_monitor_command(Processor* proc);
+void check_irq2(Processor* proc, Irq2Source* src);
+void raise_irq(Processor* proc, int line);
+void latch_device_irqs(Processor* proc);
+
+// irq2 sources
+uint64_t seed_random(uint64_t seed);
+void open_irq2_source(Irq2Source* src, const char* path);
+void list_irq2_source(Irq2Source* src, const uint32_t* cycles, int count);
+void irq2_advance(Irq2Source* src);
+Irq2Position irq2_tell(Irq2Source* src);
+void irq2_seek(Irq2Source* src, const Irq2Position* pos);
+void close_irq2_source(Irq2Source* src);
+
+// Idle skipping (wfi)
+int irq_pending(Processor* proc);
+uint32_t next_device_event(Processor* proc, Irq2Source* irq2);
+void advance_idle_cycles(Processor* proc, uint32_t cycles);
 
 // Output generation
-void write_trace(FILE* f, Processor* proc, uint64_t inst);
-void write_hwregtrace(FILE* f, uint32_t cycle, const char* name, const char* action, uint32_t value);
-void write_regout(FILE* f, Processor* proc);
-void write_dmemout(FILE* f, Processor* proc);
-void write_diskout(FILE* f, Processor* proc);
-void write_monitor(FILE* f_txt, FILE* f_yuv, Processor* proc);
+void open_output(OutputFile* o, const char* path, const char* name, int binary);
+void output_write(OutputFile* o, const void* data, size_t n);
+void output_printf(OutputFile* o, const char* format, ...);
+void output_mismatch(OutputFile* o, const char* rest, size_t n);
+void copy_matched(OutputFile* o);
+void report_mismatch(FILE* f, OutputFile* o);
+int finish_outputs(OutputFile** outputs, int count);
+char* put_hex(char* out, uint64_t value, int digits);
+int write_trace(OutputFile* f, Processor* proc, uint64_t inst);
+int write_hwregtrace(OutputFile* f, uint32_t cycle, const char* name, const char* action, uint32_t value);
+void write_regout(OutputFile* f, Processor* proc);
+void write_dmemout(OutputFile* f, Processor* proc);
+void write_diskout(OutputFile* f, Processor* proc);
+void write_monitor(OutputFile* f_txt, OutputFile* f_yuv, Processor* proc);
+void write_monitor_yuv(OutputFile* f_yuv, Processor* proc);
 void update_led_display(FILE* fled, FILE* fdisplay, Processor* proc, uint32_t prev_leds, uint32_t prev_display);
 
+// Monitor streaming
+void mark_monitor_dirty(Processor* proc, uint32_t x, uint32_t y);
+void clear_monitor_dirty(Processor* proc);
+void write_u16(OutputFile* f, uint32_t value);
+void write_u32(OutputFile* f, uint32_t value);
+void write_monitor_delta_header(OutputFile* f);
+void write_monitor_delta(OutputFile* f, Processor* proc);
+void emit_monitor_frame(OutputFile* f, Processor* proc);
+
+// Memory access trace
+void put_u32(uint8_t* out, uint32_t v);
+void trace_memory(Processor* proc, uint32_t addr, int is_write, uint32_t value);
+
+// Data cache model
+Cache* create_cache(uint32_t words, uint32_t ways, uint32_t line_words, int write_back, uint32_t penalty);
+void free_cache(Cache* cache);
+Cache* clone_cache(const Cache* src);
+void restore_cache(Cache* dst, const Cache* src);
+uint32_t cache_access(Cache* cache, uint32_t addr, int is_write, uint32_t pc);
+void write_cache_report(FILE* f, Cache* cache);
+
+// Pipeline timing model
+Pipeline* create_pipeline(uint32_t branch_penalty);
+void pipeline_retire(Pipeline* p, uint32_t pc, Instruction inst, uint32_t next_pc, uint32_t mem_stall,
+    int mispredict);
+void write_pipeline_report(FILE* f, Pipeline* p);
+
+// Branch prediction
+Predictor* create_predictor(const char* spec, uint32_t btb_entries);
+void free_predictor(Predictor* p);
+void predict_branch(Processor* proc, uint32_t pc, Instruction inst, int taken, uint32_t next_pc);
+void write_predictor_report(FILE* f, Predictor* p, uint32_t penalty);
+
+// Debugger
+Instruction debug_breakpoint(Processor* proc, Instruction trap);
+void debug_watch(Processor* proc, uint32_t addr, int flag);
+void debug_io_write(Processor* proc, uint32_t address, uint32_t value);
+void debug_check(Processor* proc);
+void debug_prompt(Processor* proc);
+int debug_goto(Processor* proc, uint32_t cycle);
+int debug_step_back(Processor* proc);
+int debug_seek(Processor* proc);
+
+// Time travel
+void init_snapshots(CoreContext* c);
+void take_snapshot(CoreContext* c);
+void restore_snapshot(int index);
+void free_snapshots(void);
+
+// Co-simulation
+void init_cosim(Processor* proc, const char* irq2_path);
+void reference_step(Processor* ref);
+void cosim_retired(Processor* proc, uint32_t pc, Instruction inst);
+void cosim_check(Processor* proc, int full);
+void free_cosim(void);
+
+// Fuzzing
+void fuzz_mark_dmem(uint32_t addr, uint32_t words);
+void fuzz_mark_disk(uint32_t sector, uint32_t count);
+int fuzz_exec(Processor* proc, const FuzzInput* in);
+int compare_u32(const void* a, const void* b);
+void fuzz_campaign(Processor* proc, Irq2Source* irq2);
+
+// Live metrics
+void init_metrics(void);
+void publish_metrics(CoreContext* c, int halted);
+void free_metrics(void);
+
+// Sampled simulation
+void init_sampling(Processor* proc);
+void attach_models(Processor* proc);
+void detach_models(Processor* proc);
+uint64_t modeled_cycles(Processor* proc);
+void start_interval(Processor* proc);
+void close_interval(Processor* proc);
+int classify_interval(void);
+double phase_variance(SamplePhase* p);
+void sample_event(Processor* proc);
+void finish_sampling(FILE* f, Processor* proc);
+
+// Multi-core
+void lock_devices(void);
+void unlock_devices(void);
+void run_core(CoreContext* c, uint32_t until);
+void run_cores(CoreContext* ctx, int count);
+void write_core_report(FILE* f, Processor** cores, const uint32_t* halt_cycles, int count);
+void core_file_name(char* out, size_t size, const char* path, uint32_t core);
+
 // Simulation
-void simulate(Processor* proc, char* argv[]);
+uint64_t host_time_ns(void);
+int parse_options(int argc, char* argv[]);
+void simulate(Processor* proc, char* argv[], const ProgramImage* image);
+int sim_main(int argc, char* argv[], const ProgramImage* image);
 
 /************************* Global Variables *************************/
-const char* io_register_names[] = {
-    "irq0enable",   // 0
-    "irq1enable",   // 1
-    "irq2enable",   // 2
-    "irq0status",   // 3
-    "irq1status",   // 4
-    "irq2status",   // 5
-    "irqhandler",   // 6
-    "irqreturn",    // 7
-    "clks",         // 8
-    "leds",         // 9
-    "display7seg",  // 10
-    "timerenable",  // 11
-    "timercurrent", // 12
-    "timermax",     // 13
-    "diskcmd",      // 14
-    "disksector",   // 15
-    "diskbuffer",   // 16
-    "diskstatus",   // 17
-    "reserved0",    // 18
-    "reserved1",    // 19
-    "monitoraddr",  // 20
-    "monitordata",  // 21
-    "monitorcmd"    // 22
+SimOptions options = {
+    .dcache_ways = 1,
+    .dcache_line = 4,
+    .dcache_penalty = 10,
+    .pipeline_branch_penalty = 2,
+    .btb_entries = 256,
+    .cores = 1,
+    .quantum = 1000,
+    .snapshot_limit = 32,
+    .dmem_size = MEMORY_SIZE,
+    .disk_size = DISK_SIZE,
+    .monitor_size = MONITOR_SIZE,
+    .fuzz_budget = 100000,
+    .metrics_every = 100000,
+    .sample_warmup = 2000,
+    .sample_window = 1000
 };
+
+Debugger debugger;
+Snapshots snapshots;
+Cosim cosim;
+Fuzzer fuzz;
+FILE* memtrace;                  // Open while --memtrace is recording
+Metrics metrics;
+Sampling sampling;
+uint64_t host_start_ns;          // When main started, for --host-stats
+int verify_failures;             // Outputs differing from the --verify directory
+IoBus io_bus;                    // Filled from the device plugins by init_io_bus
+
 /************************* Initialization Functions *************************/
 void init_processor(Processor* proc) {
     memset(proc, 0, sizeof(Processor));
@@ -147,6 +919,20 @@ void init_processor(Processor* proc) {
     proc->halt = 0;
     proc->cycle_counter = 0;
     proc->in_interrupt = 0;
+    proc->vl = VECTOR_LANES;
+    proc->io = proc;
+    for (int i = 0; i < options.num_predictors; i++) {
+        proc->predictors[proc->num_predictors++] = create_predictor(options.predictors[i], options.btb_entries);
+    }
+    if (options.pipeline) {
+        proc->pipeline = create_pipeline(options.pipeline_branch_penalty);
+    }
+    if (options.dcache_words) {
+        proc->dcache = create_cache(options.dcache_words, options.dcache_ways, options.dcache_line,
+            !options.dcache_write_through, options.dcache_penalty);
+    }
+    proc->monitor_frame_cycles = options.monitor_frame_cycles;
+    clear_monitor_dirty(proc);
 }
 
 int load_memory32(const char* filename, uint32_t* memory, int size, int word_size) {
@@ -169,10 +955,7 @@ int load_memory32(const char* filename, uint32_t* memory, int size, int word_siz
         addr++;
     }
 
-    // Fill rest with zeros
-    while (addr < size) {
-        memory[addr++] = 0;
-    }
+    // The rest is already zero: memories come from alloc_memory
 
     fclose(f);
     return 1;
@@ -206,23 +989,248 @@ int load_memory64(const char* filename, uint64_t* memory, int size, int word_siz
     fclose(f);
     return 1;
 }
-int load_irq2_timing(const char* filename, uint32_t* timing, int* count) {
-    FILE* f = fopen(filename, "r");
-    if (!f) return 0;
 
-    *count = 0;
-    char line[MAX_LINE_LENGTH];
+/************************* irq2 Sources *************************/
+// irq2 events are read or generated one at a time, in increasing cycle
+// order, so memory and per-cycle cost stay constant however many there
+// are. Sources:
+// - irq2in.txt, one decimal cycle per line, read as the run reaches it
+// - a binary file: IRQ2_BINARY_MAGIC, then little-endian u32 cycles
+// - --irq2-gen periodic:P, jitter:P:J (each event moved by up to J cycles
+//   either way) or poisson:MEAN, seeded by --irq2-seed
+// - a list of cycles, for fuzz inputs
+// Events earlier than the one before them cannot be streamed; they are
+// skipped with a warning.
+
+// xorshift64 state from a user seed. Small seeds such as the default 1
+// would make the first outputs tiny, so the seed is mixed with splitmix64.
+uint64_t seed_random(uint64_t seed) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return z ? z : 1;  // xorshift64 never leaves 0
+}
+
+uint64_t irq2_random(Irq2Position* p) {
+    uint64_t x = p->rng;  // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    p->rng = x;
+    return x;
+}
 
-    while (fgets(line, sizeof(line), f) && *count < MEMORY_SIZE) {
-        if (strlen(line) > 1) {
-            timing[(*count)++] = atoi(line);
+void open_irq2_source(Irq2Source* src, const char* path) {
+    memset(src, 0, sizeof(Irq2Source));
+    src->pos.rng = seed_random(options.irq2_seed);
+    src->limit = options.irq2_limit;
+
+    if (options.irq2_gen) {
+        const char* spec = options.irq2_gen;
+        char kind[16] = "";
+        double a = 0, b = 0;
+        int n = sscanf(spec, "%15[a-z]:%lf:%lf", kind, &a, &b);
+        if (n == 2 && strcmp(kind, "periodic") == 0 && a >= 1) {
+            src->kind = IRQ2_PERIODIC;
+            src->period = (uint32_t)a;
+        }
+        else if (n == 3 && strcmp(kind, "jitter") == 0 && a >= 1 && b >= 0) {
+            src->kind = IRQ2_JITTER;
+            src->period = (uint32_t)a;
+            src->jitter = (uint32_t)b;
+        }
+        else if (n == 2 && strcmp(kind, "poisson") == 0 && a > 0) {
+            src->kind = IRQ2_POISSON;
+            src->mean = a;
+        }
+        else {
+            fprintf(stderr, "Error: Bad --irq2-gen %s (periodic:P, jitter:P:J or poisson:MEAN)\n", spec);
+            exit(1);
         }
     }
+    else {
+        char magic[8];
+        src->f = fopen(path, "rb");
+        if (!src->f) {
+            fprintf(stderr, "Error: Cannot open %s\n", path);
+            exit(1);
+        }
+        src->kind = fread(magic, 1, 8, src->f) == 8 && memcmp(magic, IRQ2_BINARY_MAGIC, 8) == 0 ?
+            IRQ2_BINARY : IRQ2_TEXT;
+        if (src->kind == IRQ2_TEXT) rewind(src->f);
+    }
+    irq2_advance(src);
+}
 
-    fclose(f);
+void list_irq2_source(Irq2Source* src, const uint32_t* cycles, int count) {
+    memset(src, 0, sizeof(Irq2Source));
+    src->kind = IRQ2_LIST;
+    src->list = cycles;
+    src->list_count = count;
+    irq2_advance(src);
+}
+
+// Move to the event after next
+void irq2_advance(Irq2Source* src) {
+    Irq2Position* p = &src->pos;
+    uint64_t cycle;
+
+    for (;;) {
+        if (p->done || (src->limit && p->emitted == src->limit)) {
+            p->done = 1;
+            return;
+        }
+        switch (src->kind) {
+        case IRQ2_TEXT: {
+            char line[MAX_LINE_LENGTH];
+            char* end;
+            if (!fgets(line, sizeof(line), src->f)) {
+                p->done = 1;
+                return;
+            }
+            cycle = strtoull(line, &end, 10);
+            if (end == line) continue;  // Blank line
+            break;
+        }
+        case IRQ2_BINARY: {
+            uint8_t b[4];
+            if (fread(b, 1, 4, src->f) != 4) {
+                p->done = 1;
+                return;
+            }
+            cycle = b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+            break;
+        }
+        case IRQ2_LIST:
+            if (p->list_pos == src->list_count) {
+                p->done = 1;
+                return;
+            }
+            cycle = src->list[p->list_pos++];
+            break;
+        case IRQ2_PERIODIC:
+            cycle = p->last + src->period;
+            break;
+        case IRQ2_JITTER: {
+            p->nominal += src->period;
+            int64_t shift = (int64_t)(irq2_random(p) % (2 * (uint64_t)src->jitter + 1)) - src->jitter;
+            cycle = (int64_t)p->nominal + shift > (int64_t)p->last ? p->nominal + shift : p->last + 1;
+            break;
+        }
+        default: {  // Poisson: exponential gaps
+            double u = ((irq2_random(p) >> 11) + 1) * (1.0 / 9007199254740992.0);
+            double gap = -src->mean * log(u);
+            cycle = p->last + (gap < 1 ? 1 : (uint64_t)(gap + 0.5));
+            break;
+        }
+        }
+
+        if (cycle > UINT32_MAX) {
+            p->done = 1;
+            return;
+        }
+        if (p->emitted && cycle < p->last) {
+            if (!src->warned) {
+                fprintf(stderr, "Warning: irq2 event at cycle %llu is earlier than cycle %llu before it; "
+                    "events must be in increasing order, skipping out-of-order ones\n", (unsigned long long)cycle,
+                    (unsigned long long)p->last);
+                src->warned = 1;
+            }
+            continue;
+        }
+        p->next = (uint32_t)cycle;
+        p->last = cycle;
+        p->emitted++;
+        return;
+    }
+}
+
+Irq2Position irq2_tell(Irq2Source* src) {
+    if (src->f) fgetpos(src->f, &src->pos.file_pos);
+    return src->pos;
+}
+
+void irq2_seek(Irq2Source* src, const Irq2Position* pos) {
+    src->pos = *pos;
+    if (src->f) fsetpos(src->f, &src->pos.file_pos);
+}
+
+void close_irq2_source(Irq2Source* src) {
+    if (src->f) fclose(src->f);
+    src->f = NULL;
+}
+
+/************************* Memory Allocation *************************/
+// Zeroed memory whose pages the OS supplies on first touch
+void* alloc_memory(size_t bytes) {
+#if defined(SIMP_HAVE_MMAP)
+    void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) p = NULL;
+#elif defined(SIMP_HAVE_VIRTUALALLOC)
+    void* p = VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+    void* p = calloc(bytes, 1);
+#endif
+    if (!p) {
+        fprintf(stderr, "Error: Cannot allocate %zu bytes of simulated memory\n", bytes);
+        exit(1);
+    }
+    return p;
+}
+
+void free_memory(void* p, size_t bytes) {
+    if (!p) return;
+#if defined(SIMP_HAVE_MMAP)
+    munmap(p, bytes);
+#elif defined(SIMP_HAVE_VIRTUALALLOC)
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    free(p);
+#endif
+}
+
+int page_is_zero(const uint8_t* p, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        if (p[i]) return 0;
+    }
     return 1;
 }
 
+// Copy into fresh zeroed memory, skipping zero pages so they stay untouched
+void copy_sparse(void* dst, const void* src, size_t bytes) {
+    for (size_t off = 0; off < bytes; off += HOST_PAGE_BYTES) {
+        size_t n = bytes - off < HOST_PAGE_BYTES ? bytes - off : HOST_PAGE_BYTES;
+        if (!page_is_zero((const uint8_t*)src + off, n)) memcpy((uint8_t*)dst + off, (const uint8_t*)src + off, n);
+    }
+}
+
+void alloc_memories(Processor* proc) {
+    proc->dmem = (uint32_t*)alloc_memory((size_t)options.dmem_size * sizeof(uint32_t));
+    proc->disk = (uint32_t*)alloc_memory((size_t)options.disk_size * sizeof(uint32_t));
+    proc->monitor_buffer = (uint8_t*)alloc_memory((size_t)options.monitor_size * options.monitor_size);
+}
+
+void free_memories(Processor* proc) {
+    free_memory(proc->dmem, (size_t)options.dmem_size * sizeof(uint32_t));
+    free_memory(proc->disk, (size_t)options.disk_size * sizeof(uint32_t));
+    free_memory(proc->monitor_buffer, (size_t)options.monitor_size * options.monitor_size);
+    proc->dmem = NULL;
+    proc->disk = NULL;
+    proc->monitor_buffer = NULL;
+}
+
+uint8_t* monitor_pixel(Processor* proc, uint32_t x, uint32_t y) {
+    return &proc->monitor_buffer[(size_t)y * options.monitor_size + x];
+}
+
+// Output files keep the default length and grow to the last non-zero word
+uint32_t output_words(const uint32_t* memory, uint32_t size, uint32_t default_size) {
+    uint32_t n = size;
+    while (n > default_size && memory[n - 1] == 0) n--;
+    return n;
+}
+
 /************************* Instruction Handling *************************/
 Instruction decode_instruction(uint64_t word) {
     Instruction inst;
@@ -248,10 +1256,17 @@ Instruction decode_instruction(uint64_t word) {
     return inst;
 }
 
+void predecode_program(Processor* proc) {
+    for (int i = 0; i < MEMORY_SIZE; i++) {
+        proc->decoded[i] = decode_instruction(proc->imem[i]);
+    }
+}
+
 void execute_instruction(Processor* proc, Instruction inst) {
     uint32_t* regs = proc->registers;
     uint32_t temp;  // For temporary calculations
     int pc_modified = 0; // Flag to check if pc was modified
+    uint32_t pc = proc->pc;
 
     // Update special registers
     regs[1] = inst.immediate1;  // $imm1
@@ -344,19 +1359,26 @@ void execute_instruction(Processor* proc, Instruction inst) {
 
     case 16:  // lw
         temp = regs[inst.rs] + regs[inst.rt];
-        if (temp < MEMORY_SIZE) {
+        if (temp < options.dmem_size) {
+            if (debugger.pages[temp / DEBUG_PAGE_WORDS] & WATCH_READ) debug_watch(proc, temp, WATCH_READ);
+            if (memtrace) trace_memory(proc, temp, 0, proc->dmem[temp]);
             regs[inst.rd] = proc->dmem[temp] + regs[inst.rm];
+            if (proc->dcache) proc->stall_cycles += cache_access(proc->dcache, temp, 0, proc->pc);
         }
         break;
 
     case 17:  // sw
         temp = regs[inst.rs] + regs[inst.rt];
-        if (temp < MEMORY_SIZE) {
+        if (temp < options.dmem_size) {
+            if (debugger.pages[temp / DEBUG_PAGE_WORDS] & WATCH_WRITE) debug_watch(proc, temp, WATCH_WRITE);
             proc->dmem[temp] = regs[inst.rd] + regs[inst.rm];
+            if (memtrace) trace_memory(proc, temp, 1, proc->dmem[temp]);
+            if (proc->dcache) proc->stall_cycles += cache_access(proc->dcache, temp, 1, proc->pc);
         }
         break;
 
     case 18:  // reti
+        while (proc->loop_depth && proc->loops[proc->loop_depth - 1].in_interrupt) proc->loop_depth--;
         proc->pc = proc->irqreturn;
         proc->in_interrupt = 0;
         pc_modified = 1;
@@ -374,340 +1396,4053 @@ void execute_instruction(Processor* proc, Instruction inst) {
         proc->halt = 1;
         break;
 
+    case 22: case 23: case 24: case 25:  // Vector extension
+    case 26: case 27: case 28: case 29:
+        execute_vector_instruction(proc, inst);
+        break;
+
+    case 30:  // wfi
+        proc->waiting = 1;
+        break;
+
+    case 31:  // amoswap: rd = dmem[rs + rt], dmem[rs + rt] = rm
+    case 32:  // amoadd: rd = dmem[rs + rt], dmem[rs + rt] += rm
+        temp = regs[inst.rs] + regs[inst.rt];
+        if (temp < options.dmem_size) {
+            uint32_t value = regs[inst.rm];
+            if (debugger.pages[temp / DEBUG_PAGE_WORDS]) debug_watch(proc, temp, WATCH_READ | WATCH_WRITE);
+            uint32_t old = inst.opcode == 31 ? ATOMIC_SWAP(&proc->dmem[temp], value) :
+                ATOMIC_FETCH_ADD(&proc->dmem[temp], value);
+            regs[inst.rd] = old;
+            if (memtrace) {
+                trace_memory(proc, temp, 0, old);
+                trace_memory(proc, temp, 1, inst.opcode == 31 ? value : old + value);
+            }
+            if (proc->dcache) proc->stall_cycles += cache_access(proc->dcache, temp, 1, proc->pc);
+        }
+        break;
+
+    case 33:  // loop: repeat pc+1 .. rm-1 rs + rt times
+        start_hardware_loop(proc, regs[inst.rs] + regs[inst.rt], regs[inst.rm]);
+        pc_modified = 1;
+        break;
+
     default:
         break;
     }
 
+    // Feed branches, jal and reti to the predictors
+    if (proc->num_predictors && ((inst.opcode >= 9 && inst.opcode <= 15) || inst.opcode == 18)) {
+        predict_branch(proc, pc, inst, pc_modified, proc->pc);
+    }
+
     // Ensure $zero stays 0
     regs[0] = 0;
 
     // If PC wasn't modified, increment it
     if (!pc_modified && !proc->halt) {
         proc->pc++;
+        if (proc->loop_depth) end_hardware_loop(proc);
     }
-}
-/************************* I/O and Device Management *************************/
-void handle_io_read(Processor* proc, uint32_t address, uint32_t* value) {
-    switch (address) {
-    case 0: *value = proc->irq0enable; break;
-    case 1: *value = proc->irq1enable; break;
-    case 2: *value = proc->irq2enable; break;
-    case 3: *value = proc->irq0status; break;
-    case 4: *value = proc->irq1status; break;
-    case 5: *value = proc->irq2status; break;
-    case 6: *value = proc->irqhandler; break;
-    case 7: *value = proc->irqreturn; break;
-    case 8: *value = proc->cycle_counter; break;
-    case 9: *value = proc->leds; break;
-    case 10: *value = proc->display7seg; break;
-    case 11: *value = proc->timerenable; break;
-    case 12: *value = proc->timercurrent; break;
-    case 13: *value = proc->timermax; break;
-    case 14: *value = proc->diskcmd; break;
-    case 15: *value = proc->disksector; break;
-    case 16: *value = proc->diskbuffer; break;
-    case 17: *value = proc->diskstatus; break;
-    case 20: *value = proc->monitoraddr; break;    // Corrected mapping
-    case 21: *value = proc->monitordata; break;
-    case 22: *value = proc->monitorcmd; break;
-    default: *value = 0; break;
-    }
-}
-
-void handle_io_write(Processor* proc, uint32_t address, uint32_t value) {
-    switch (address) {
-    case 0: proc->irq0enable = value & 1; break;
-    case 1: proc->irq1enable = value & 1; break;
-    case 2: proc->irq2enable = value & 1; break;
-    case 3: proc->irq0status = value & 1; break;
-    case 4: proc->irq1status = value & 1; break;
-    case 5: proc->irq2status = value & 1; break;
-    case 6: proc->irqhandler = value; break;
-    case 7: proc->irqreturn = value; break;
-    case 9: proc->leds = value; break;
-    case 10: proc->display7seg = value; break;
-    case 11: proc->timerenable = value & 1; break;
-    case 12: proc->timercurrent = value; break;
-    case 13: proc->timermax = value; break;
-    case 14:
-        proc->diskcmd = value;
-        if (value == 1 || value == 2) {  // Read or Write command
-            proc->diskstatus = 1;  // Set busy
-            proc->disk_busy_cycles = 0;
-        }
-        break;
-    case 15: proc->disksector = value; break;
-    case 16: proc->diskbuffer = value; break;
-    case 20: proc->monitoraddr = value; break;
-    case 21: proc->monitordata = value & 0xFF; break;
-    case 22:
-        if (value == 1) {  // Write pixel command
-            uint32_t x = proc->monitoraddr % MONITOR_SIZE;
-            uint32_t y = proc->monitoraddr / MONITOR_SIZE;
-            if (x < MONITOR_SIZE && y < MONITOR_SIZE) {
-                proc->monitor_buffer[y][x] = proc->monitordata;
-            }
-        }
-        break;
+    else if (proc->loop_depth && pc_modified && inst.opcode >= 9 && inst.opcode <= 14) {
+        exit_hardware_loops(proc, pc);
     }
 }
 
-/************************* Interrupt Handling *************************/
-void check_interrupts(Processor* proc) {
-    if (!proc->in_interrupt) {
-        uint32_t irq = (proc->irq0enable & proc->irq0status) |
-            (proc->irq1enable & proc->irq1status) |
-            (proc->irq2enable & proc->irq2status);
+/************************* Hardware Loops *************************/
+// Opcode 33 repeats the instructions that follow it without a branch:
+//   33 loop   run pc+1 .. rm-1 (rs + rt) times, then continue at rm
+// A count of zero skips the body. Falling through from the last body
+// instruction into rm starts the next iteration at no cost. Loops nest
+// LOOP_DEPTH deep; arming one more stops the core with a warning, since
+// dropping a loop would silently compute a wrong result. A taken branch
+// from the body to outside it leaves the loop, while jal and interrupts
+// only visit other code; a branch from outside the body that lands on its
+// end, such as the return from a call in the last slot, counts as falling
+// through. Loops armed by the interrupt handler iterate
+// only there and reti drops them, so an interrupt that arrives mid-loop
+// returns into the iteration it left.
+void start_hardware_loop(Processor* proc, uint32_t count, uint32_t end) {
+    uint32_t start = proc->pc + 1;
 
-        if (irq) {
-            proc->irqreturn = proc->pc;
-            proc->pc = proc->irqhandler;
-            proc->in_interrupt = 1;
+    if (count == 0) {
+        proc->pc = end;
+        return;
+    }
+    if (end <= start) {  // Empty body
+        proc->pc = start;
+        return;
+    }
+    if (proc->loop_depth == LOOP_DEPTH) {  // Stop at the loop instruction
+        if (!cosim.reference_active && !fuzz.active) {
+            fprintf(stderr, "Warning: loop at pc %03X nests deeper than %d loops, stopping core %u at cycle %u\n",
+                proc->pc, LOOP_DEPTH, proc->core_id, proc->cycle_counter);
         }
+        proc->halt = 1;
+        return;
     }
+    proc->pc = start;
+
+    HardwareLoop* loop = &proc->loops[proc->loop_depth++];
+    loop->start = start;
+    loop->end = end;
+    loop->count = count;
+    loop->in_interrupt = (uint32_t)proc->in_interrupt;
 }
 
-void handle_timer(Processor* proc) {
-    if (proc->timerenable) {
-        proc->timercurrent++;
-        if (proc->timercurrent >= proc->timermax) {
-            proc->irq0status = 1;
-            proc->timercurrent = 0;
+// The last body instruction fell through; loops nested to the same end finish together
+void end_hardware_loop(Processor* proc) {
+    while (proc->loop_depth) {
+        HardwareLoop* loop = &proc->loops[proc->loop_depth - 1];
+        if (proc->pc != loop->end || loop->in_interrupt != (uint32_t)proc->in_interrupt) return;
+        if (--loop->count) {
+            proc->pc = loop->start;
+            return;
         }
+        proc->loop_depth--;
     }
 }
 
-void handle_disk(Processor* proc) {
-    if (proc->diskstatus) {  // If disk is busy
-        proc->disk_busy_cycles++;
-        if (proc->disk_busy_cycles >= DISK_BUSY_CYCLES) {
-            // Perform disk operation
-            if (proc->diskcmd == 1) {  // Read
-                for (int i = 0; i < 128; i++) {  // 128 words per sector
-                    proc->dmem[proc->diskbuffer + i] =
-                        proc->disk[proc->disksector * 128 + i];
-                }
-            }
-            else if (proc->diskcmd == 2) {  // Write
-                for (int i = 0; i < 128; i++) {
-                    proc->disk[proc->disksector * 128 + i] =
-                        proc->dmem[proc->diskbuffer + i];
-                }
-            }
-
-            proc->diskstatus = 0;  // Set disk ready
-            proc->diskcmd = 0;     // Clear command
-            proc->irq1status = 1;  // Set disk interrupt
-            proc->disk_busy_cycles = 0;
+// A taken branch at from left the bodies it does not land in
+void exit_hardware_loops(Processor* proc, uint32_t from) {
+    while (proc->loop_depth) {
+        HardwareLoop* loop = &proc->loops[proc->loop_depth - 1];
+        if (loop->in_interrupt != (uint32_t)proc->in_interrupt) return;
+        if (from < loop->start || from >= loop->end) {
+            if (proc->pc == loop->end) end_hardware_loop(proc);  // Returned to the end
+            return;
         }
+        if (proc->pc >= loop->start && proc->pc < loop->end) return;
+        proc->loop_depth--;
     }
 }
+/************************* Vector Extension *************************/
+// Opcodes 22-29 operate on VECTOR_REGS registers of VECTOR_LANES words.
+// Loads fill the first vl lanes and clear the rest; element-wise
+// operations always cover all lanes, so inactive lanes stay zero.
+//   22 vlw    vrd[i] = dmem[rs + rt + i]
+//   23 vsw    dmem[rs + rt + i] = vrd[i]
+//   24 vlws   vrd[i] = dmem[rs + i * rt]       (strided load)
+//   25 vadd   vrd = vrs + vrt + vrm
+//   26 vmul   vrd = vrs * vrt
+//   27 vmac   vrd = vrs * vrt + vrm
+//   28 vred   rd = sum(vrs[0..vl-1]) + rm      (scalar rd, rm)
+//   29 vsetvl rd = vl = clamp(rs + rt, 1, VECTOR_LANES)
+#ifdef SIMP_HAVE_SSE2
+static __m128i mullo_epi32(__m128i a, __m128i b) {
+#if defined(__SSE4_1__)
+    return _mm_mullo_epi32(a, b);
+#else
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+        _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+#endif
 
-void check_irq2(Processor* proc, uint32_t* irq2_timing, int irq2_count) {
-    for (int i = 0; i < irq2_count; i++) {
-        if (proc->cycle_counter == irq2_timing[i]) {
-            proc->irq2status = 1;
-            break;
+// The co-simulation reference always takes the plain loop
+void vector_arith(uint32_t* d, const uint32_t* s, const uint32_t* t, const uint32_t* m, int mul) {
+#ifdef SIMP_HAVE_SSE2
+    if (!cosim.reference_active) {
+        for (int i = 0; i < VECTOR_LANES; i += 4) {
+            __m128i vs = _mm_loadu_si128((const __m128i*)(s + i));
+            __m128i vt = _mm_loadu_si128((const __m128i*)(t + i));
+            __m128i vm = _mm_loadu_si128((const __m128i*)(m + i));
+            __m128i r = mul ? _mm_add_epi32(mullo_epi32(vs, vt), vm)
+                : _mm_add_epi32(_mm_add_epi32(vs, vt), vm);
+            _mm_storeu_si128((__m128i*)(d + i), r);
         }
+        return;
     }
-}
-
-/************************* Device Updates *************************/
-void update_devices(Processor* proc) {
-    handle_timer(proc);
-    handle_disk(proc);
-    check_interrupts(proc);
-}
-/************************* File Output Functions *************************/
-void write_trace(FILE* f, Processor* proc, uint64_t inst) {
-    // Format: PC INST R0-R15
-    fprintf(f, "%03X %012llX", proc->pc, inst & 0xFFFFFFFFFFFF);  // Ensure 12 hex digits
-    for (int i = 0; i < 16; i++) {
-        fprintf(f, " %08X", proc->registers[i]);
+#endif
+    for (int i = 0; i < VECTOR_LANES; i++) {
+        d[i] = mul ? s[i] * t[i] + m[i] : s[i] + t[i] + m[i];
     }
-    fprintf(f, "\n");
 }
 
-void write_hwregtrace(FILE* f, uint32_t cycle, const char* name,
-    const char* action, uint32_t value) {
-    fprintf(f, "%d %s %s %08X\n", cycle, action, name, value);
-}
+void execute_vector_instruction(Processor* proc, Instruction inst) {
+    static const uint32_t zero[VECTOR_LANES] = { 0 };
+    uint32_t* regs = proc->registers;
+    uint32_t (*v)[VECTOR_LANES] = proc->vregs;
+    uint32_t base = regs[inst.rs] + regs[inst.rt];
+    uint32_t sum;
 
-void write_regout(FILE* f, Processor* proc) {
+    switch (inst.opcode) {
+    case 22:  // vlw
+        for (uint32_t i = 0; i < VECTOR_LANES; i++) {
+            v[inst.rd][i] = (i < proc->vl && base + i < options.dmem_size) ? proc->dmem[base + i] : 0;
+            if (i < proc->vl && base + i < options.dmem_size) {
+                if (debugger.pages[(base + i) / DEBUG_PAGE_WORDS] & WATCH_READ) debug_watch(proc, base + i, WATCH_READ);
+                if (memtrace) trace_memory(proc, base + i, 0, v[inst.rd][i]);
+                if (proc->dcache) proc->stall_cycles += cache_access(proc->dcache, base + i, 0, proc->pc);
+            }
+        }
+        break;
+
+    case 23:  // vsw
+        for (uint32_t i = 0; i < proc->vl; i++) {
+            if (base + i < options.dmem_size) {
+                if (debugger.pages[(base + i) / DEBUG_PAGE_WORDS] & WATCH_WRITE) debug_watch(proc, base + i, WATCH_WRITE);
+                proc->dmem[base + i] = v[inst.rd][i];
+                if (memtrace) trace_memory(proc, base + i, 1, v[inst.rd][i]);
+                if (proc->dcache) proc->stall_cycles += cache_access(proc->dcache, base + i, 1, proc->pc);
+            }
+        }
+        break;
+
+    case 24:  // vlws
+        for (uint32_t i = 0; i < VECTOR_LANES; i++) {
+            uint32_t addr = regs[inst.rs] + i * regs[inst.rt];
+            v[inst.rd][i] = (i < proc->vl && addr < options.dmem_size) ? proc->dmem[addr] : 0;
+            if (i < proc->vl && addr < options.dmem_size) {
+                if (debugger.pages[addr / DEBUG_PAGE_WORDS] & WATCH_READ) debug_watch(proc, addr, WATCH_READ);
+                if (memtrace) trace_memory(proc, addr, 0, v[inst.rd][i]);
+                if (proc->dcache) proc->stall_cycles += cache_access(proc->dcache, addr, 0, proc->pc);
+            }
+        }
+        break;
+
+    case 25:  // vadd
+        vector_arith(v[inst.rd], v[inst.rs], v[inst.rt], v[inst.rm], 0);
+        break;
+
+    case 26:  // vmul
+        vector_arith(v[inst.rd], v[inst.rs], v[inst.rt], zero, 1);
+        break;
+
+    case 27:  // vmac
+        vector_arith(v[inst.rd], v[inst.rs], v[inst.rt], v[inst.rm], 1);
+        break;
+
+    case 28:  // vred
+        sum = regs[inst.rm];
+        for (uint32_t i = 0; i < proc->vl; i++) {
+            sum += v[inst.rs][i];
+        }
+        regs[inst.rd] = sum;
+        break;
+
+    case 29:  // vsetvl
+        proc->vl = base < 1 ? 1 : (base > VECTOR_LANES ? VECTOR_LANES : base);
+        regs[inst.rd] = proc->vl;
+        break;
+    }
+
+    // Ensure $vr0 stays 0
+    memset(v[0], 0, sizeof(v[0]));
+}
+
+/************************* I/O Bus *************************/
+// in and out go through a table of registers filled from device plugins,
+// so a new device is one register list and one entry in devices[]. The
+// bus asks each timed device how many ticks until it next changes state
+// and does nothing until the earliest of them (bus_next), so idle or
+// merely counting devices cost one compare per cycle. Counters such as
+// timercurrent lag between events; bus_sync brings them up to date
+// before any access to a device register.
+
+#define IO_FIELD(name) offsetof(Processor, name)
+
+uint32_t read_numcores(Processor* proc) {
+    (void)proc;
+    return options.cores;
+}
+
+void write_diskcmd(Processor* proc, uint32_t value) {
+    if (value >= DISK_CMD_READ && value <= DISK_CMD_SCATTER_WRITE) {
+        enqueue_disk_command(proc, value);
+    }
+    else if (!proc->diskstatus) {
+        proc->diskcmd = value;
+    }
+}
+
+void write_monitorcmd(Processor* proc, uint32_t value) {
+    if (value == MONITOR_CMD_WRITE) {  // Write pixel command
+        uint32_t x = proc->monitoraddr % options.monitor_size;
+        uint32_t y = proc->monitoraddr / options.monitor_size;
+        if (y < options.monitor_size && *monitor_pixel(proc, x, y) != proc->monitordata) {
+            *monitor_pixel(proc, x, y) = (uint8_t)proc->monitordata;
+            mark_monitor_dirty(proc, x, y);
+        }
+    }
+    else if (value == MONITOR_CMD_VSYNC && proc->monitor_dirty) {
+        proc->monitor_vsync = 1;
+    }
+    else {
+        start_monitor_command(proc, value);
+    }
+}
+
+static const IoRegister interrupt_registers[] = {
+    { 0, "irq0enable", IO_FIELD(irq0enable), 1 },
+    { 1, "irq1enable", IO_FIELD(irq1enable), 1 },
+    { 2, "irq2enable", IO_FIELD(irq2enable), 1 },
+    { 3, "irq0status", IO_FIELD(irq0status), 1 },
+    { 4, "irq1status", IO_FIELD(irq1status), 1 },
+    { 5, "irq2status", IO_FIELD(irq2status), 1 },
+    { 6, "irqhandler", IO_FIELD(irqhandler), 0xFFFFFFFF },
+    { 7, "irqreturn", IO_FIELD(irqreturn), 0xFFFFFFFF },
+    { 8, "clks", IO_FIELD(cycle_counter), 0 },
+};
+static const IoRegister leds_registers[] = {
+    { 9, "leds", IO_FIELD(leds), 0xFFFFFFFF },
+};
+static const IoRegister display_registers[] = {
+    { 10, "display7seg", IO_FIELD(display7seg), 0xFFFFFFFF },
+};
+static const IoRegister timer_registers[] = {
+    { 11, "timerenable", IO_FIELD(timerenable), 1 },
+    { 12, "timercurrent", IO_FIELD(timercurrent), 0xFFFFFFFF },
+    { 13, "timermax", IO_FIELD(timermax), 0xFFFFFFFF },
+};
+static const IoRegister disk_registers[] = {
+    { 14, "diskcmd", IO_FIELD(diskcmd), 0xFFFFFFFF, NULL, write_diskcmd },
+    { 15, "disksector", IO_FIELD(disksector), 0xFFFFFFFF },
+    { 16, "diskbuffer", IO_FIELD(diskbuffer), 0xFFFFFFFF },
+    { 17, "diskstatus", IO_FIELD(diskstatus), 0 },
+    { 23, "diskcount", IO_FIELD(diskcount), 0xFFFFFFFF },
+    { 24, "diskdesc", IO_FIELD(diskdesc), 0xFFFFFFFF },
+    { 25, "diskqueue", IO_FIELD(disk_queue_count), 0 },
+    { 26, "diskirqmode", IO_FIELD(diskirqmode), 1 },
+};
+static const IoRegister monitor_registers[] = {
+    { 18, "monitorsize", IO_FIELD(monitorsize), 0xFFFFFFFF },
+    { 19, "monitorsrc", IO_FIELD(monitorsrc), 0xFFFFFFFF },
+    { 20, "monitoraddr", IO_FIELD(monitoraddr), 0xFFFFFFFF },
+    { 21, "monitordata", IO_FIELD(monitordata), 0xFF },
+    { 22, "monitorcmd", IO_FIELD(monitorcmd), 0xFFFFFFFF, NULL, write_monitorcmd },
+};
+static const IoRegister core_registers[] = {
+    { 27, "coreid", IO_FIELD(core_id), 0 },
+    { 28, "numcores", 0, 0, read_numcores },
+};
+
+#define DEVICE_REGISTERS(r) r, (int)(sizeof(r) / sizeof(r[0]))
+
+// Interrupt registers, clks and coreid are per core; the rest belong to core 0.
+// A device interrupt sets the status bit on every core, and each core
+// clears its own copy
+static const Device devices[] = {
+    { "interrupts", DEVICE_REGISTERS(interrupt_registers), 0 },
+    { "leds", DEVICE_REGISTERS(leds_registers), 1 },
+    { "display7seg", DEVICE_REGISTERS(display_registers), 1 },
+    { "timer", DEVICE_REGISTERS(timer_registers), 1, timer_next_event, timer_advance, handle_timer },
+    { "disk", DEVICE_REGISTERS(disk_registers), 1, disk_next_event, disk_advance, handle_disk },
+    { "monitor", DEVICE_REGISTERS(monitor_registers), 1, monitor_next_event, monitor_advance, handle_monitor },
+    { "core", DEVICE_REGISTERS(core_registers), 0 },
+};
+
+void init_io_bus(void) {
+    memset(&io_bus, 0, sizeof(io_bus));
+    for (size_t d = 0; d < sizeof(devices) / sizeof(devices[0]); d++) {
+        const Device* dev = &devices[d];
+        for (int i = 0; i < dev->num_registers; i++) {
+            uint32_t a = dev->registers[i].address;
+            if (a >= IO_REGISTERS || io_bus.registers[a]) {
+                fprintf(stderr, "Error: Device %s claims I/O register %u, which is %s\n", dev->name, a,
+                    a >= IO_REGISTERS ? "out of range" : "taken");
+                exit(1);
+            }
+            io_bus.registers[a] = &dev->registers[i];
+            io_bus.owner[a] = dev;
+        }
+        if (dev->next_event) io_bus.timed[io_bus.num_timed++] = dev;
+    }
+    for (uint32_t a = 0; a < IO_REGISTERS; a++) {
+        if (!io_bus.registers[a]) {
+            fprintf(stderr, "Error: No device has I/O register %u\n", a);
+            exit(1);
+        }
+    }
+}
+
+const char* io_register_name(uint32_t address) {
+    return address < IO_REGISTERS ? io_bus.registers[address]->name : "unknown";
+}
+
+uint32_t io_read(Processor* proc, const IoRegister* r) {
+    if (r->read) return r->read(proc);
+    return *(uint32_t*)((uint8_t*)proc + r->field);
+}
+
+void io_write(Processor* proc, const IoRegister* r, uint32_t value) {
+    if (r->write) r->write(proc, value);
+    else if (r->write_mask) *(uint32_t*)((uint8_t*)proc + r->field) = value & r->write_mask;
+}
+
+// Apply device ticks up to, not including, cycle end. Events on the way
+// fire at their own cycle
+void bus_sync(Processor* proc, uint32_t end) {
+    while (proc->bus_next < end) {
+        uint32_t e = proc->bus_next;
+        for (int i = 0; i < io_bus.num_timed; i++) {
+            const Device* dev = io_bus.timed[i];
+            if (e > proc->bus_synced) dev->advance(proc, e - proc->bus_synced);
+            dev->on_event(proc);
+        }
+        proc->bus_synced = e + 1;
+        bus_schedule(proc);
+    }
+    if (end > proc->bus_synced) {
+        for (int i = 0; i < io_bus.num_timed; i++) {
+            io_bus.timed[i]->advance(proc, end - proc->bus_synced);
+        }
+        proc->bus_synced = end;
+    }
+}
+
+// Find the next device event after the ticks applied so far
+void bus_schedule(Processor* proc) {
+    uint32_t next = 0;
+    for (int i = 0; i < io_bus.num_timed; i++) {
+        uint32_t d = io_bus.timed[i]->next_event(proc);
+        if (d && (!next || d < next)) next = d;
+    }
+    proc->bus_next = next ? proc->bus_synced - 1 + next : BUS_IDLE;
+}
+
+// A core's own access happens after its device update for this cycle;
+// other cores see core 0's devices as of core 0's last completed cycle.
+// Once core 0 has halted, the cores still running carry the devices on.
+uint32_t device_cycle(Processor* proc) {
+    Processor* io = proc->io;
+    if (io == proc) return proc->cycle_counter + 1;
+    if (io->halt && proc->cycle_counter > io->cycle_counter) return proc->cycle_counter;
+    return io->cycle_counter;
+}
+
+void handle_io_read(Processor* proc, uint32_t address, uint32_t* value) {
+    if (address >= IO_REGISTERS) {
+        *value = 0;
+        return;
+    }
+    const IoRegister* r = io_bus.registers[address];
+    if (!io_bus.owner[address]->shared) {
+        *value = io_read(proc, r);
+        return;
+    }
+    Processor* io = proc->io;
+    if (options.cores > 1) lock_devices();
+    bus_sync(io, device_cycle(proc));
+    *value = io_read(io, r);
+    if (options.cores > 1) unlock_devices();
+}
+
+void handle_io_write(Processor* proc, uint32_t address, uint32_t value) {
+    if (debugger.io_watch && address < IO_REGISTERS && (debugger.io_watch >> address & 1)) {
+        debug_io_write(proc, address, value);
+    }
+    if (address >= IO_REGISTERS) return;
+    const IoRegister* r = io_bus.registers[address];
+    if (!io_bus.owner[address]->shared) {
+        io_write(proc, r, value);
+        return;
+    }
+    Processor* io = proc->io;
+    if (options.cores > 1) lock_devices();
+    bus_sync(io, device_cycle(proc));
+    io_write(io, r, value);
+    bus_schedule(io);
+    if (options.cores > 1) unlock_devices();
+}
+
+/************************* Interrupt Handling *************************/
+// Devices and irq2 raise interrupts on the core owning the devices
+void raise_irq(Processor* proc, int line) {
+    if (line == 0) proc->irq0status = 1;
+    else if (line == 1) proc->irq1status = 1;
+    else proc->irq2status = 1;
+    proc->irq_raised[line]++;
+}
+
+// Other cores latch whatever core 0 raised since they last looked; called
+// with the devices locked
+void latch_device_irqs(Processor* proc) {
+    Processor* io = proc->io;
+    if (io->irq_raised[0] != proc->irq_seen[0]) proc->irq0status = 1;
+    if (io->irq_raised[1] != proc->irq_seen[1]) proc->irq1status = 1;
+    if (io->irq_raised[2] != proc->irq_seen[2]) proc->irq2status = 1;
+    memcpy(proc->irq_seen, io->irq_raised, sizeof(proc->irq_seen));
+}
+
+void check_interrupts(Processor* proc) {
+    if (!proc->in_interrupt) {
+        uint32_t irq = (proc->irq0enable & proc->irq0status) |
+            (proc->irq1enable & proc->irq1status) |
+            (proc->irq2enable & proc->irq2status);
+
+        if (irq) {
+            proc->irq_entries[0] += (proc->irq0enable & proc->irq0status) != 0;
+            proc->irq_entries[1] += (proc->irq1enable & proc->irq1status) != 0;
+            proc->irq_entries[2] += (proc->irq2enable & proc->irq2status) != 0;
+            proc->irqreturn = proc->pc;
+            proc->pc = proc->irqhandler;
+            proc->in_interrupt = 1;
+        }
+    }
+}
+
+void handle_timer(Processor* proc) {
+    if (proc->timerenable) {
+        proc->timercurrent++;
+        if (proc->timercurrent >= proc->timermax) {
+            raise_irq(proc, 0);
+            proc->timercurrent = 0;
+        }
+    }
+}
+
+uint32_t timer_next_event(Processor* proc) {
+    if (!proc->timerenable) return 0;
+    return proc->timermax > proc->timercurrent ? proc->timermax - proc->timercurrent : 1;
+}
+
+void timer_advance(Processor* proc, uint32_t ticks) {
+    if (proc->timerenable) proc->timercurrent += ticks;
+}
+
+void handle_disk(Processor* proc) {
+    if (proc->diskstatus) {  // If disk is busy
+        proc->disk_busy_cycles++;
+        if (proc->disk_busy_cycles >= proc->disk_latency) {
+            proc->disk_busy_total += proc->disk_busy_cycles;
+
+            // Perform the disk operation at the queue head
+            DiskCommand* c = &proc->disk_queue[proc->disk_queue_head];
+            if (c->cmd == DISK_CMD_READ || c->cmd == DISK_CMD_WRITE) {
+                disk_transfer(proc, c->cmd, c->sector, c->buffer, c->count);
+            }
+            else {
+                for (uint32_t d = c->desc; d < options.dmem_size - 2 && proc->dmem[d + 2]; d += 3) {
+                    disk_transfer(proc, c->cmd == DISK_CMD_GATHER_READ ? DISK_CMD_READ : DISK_CMD_WRITE,
+                        proc->dmem[d], proc->dmem[d + 1], proc->dmem[d + 2]);
+                }
+            }
+
+            proc->disk_queue_head = (proc->disk_queue_head + 1) % DISK_QUEUE_SIZE;
+            proc->disk_queue_count--;
+            if (proc->diskirqmode == DISK_IRQ_PER_COMMAND || proc->disk_queue_count == 0) {
+                raise_irq(proc, 1);  // Set disk interrupt
+            }
+
+            if (proc->disk_queue_count) {
+                start_disk_command(proc);
+            }
+            else {
+                proc->diskstatus = 0;  // Set disk ready
+                proc->diskcmd = 0;     // Clear command
+                proc->disk_busy_cycles = 0;
+            }
+        }
+    }
+}
+
+uint32_t disk_next_event(Processor* proc) {
+    if (!proc->diskstatus) return 0;
+    return proc->disk_latency > proc->disk_busy_cycles ? proc->disk_latency - proc->disk_busy_cycles : 1;
+}
+
+void disk_advance(Processor* proc, uint32_t ticks) {
+    if (proc->diskstatus) proc->disk_busy_cycles += ticks;
+}
+
+void handle_monitor(Processor* proc) {
+    if (proc->monitorcmd) {  // If a fill or copy is in progress
+        if (--proc->monitor_busy_cycles == 0) {
+            execute_monitor_command(proc);
+            if (proc->monitorcmd & MONITOR_CMD_IRQ) {
+                raise_irq(proc, 2);  // Completion interrupt
+            }
+            proc->monitorcmd = 0;
+        }
+    }
+}
+
+uint32_t monitor_next_event(Processor* proc) {
+    if (!proc->monitorcmd) return 0;
+    return proc->monitor_busy_cycles ? proc->monitor_busy_cycles : 1;
+}
+
+void monitor_advance(Processor* proc, uint32_t ticks) {
+    if (proc->monitorcmd) proc->monitor_busy_cycles -= ticks;
+}
+
+// Events behind the current cycle were passed over by a jump in time. The
+// interrupt goes to the core owning the devices, at proc's cycle
+void check_irq2(Processor* proc, Irq2Source* src) {
+    if (src->pos.done || proc->cycle_counter < src->pos.next) return;
+    while (!src->pos.done && src->pos.next <= proc->cycle_counter) {
+        if (src->pos.next == proc->cycle_counter) raise_irq(proc->io, 2);
+        irq2_advance(src);
+    }
+}
+
+/************************* Data Cache Model *************************/
+// Timing-only model in front of dmem: it keeps tags, not data, so it can
+// never change results. Misses stall the core for miss_penalty cycles per
+// line fill and per dirty writeback; write-through stores go to a write
+// buffer and never stall. DMA from the disk and monitor bypasses it.
+int is_power_of_two(uint32_t x) {
+    return x && !(x & (x - 1));
+}
+
+Cache* create_cache(uint32_t words, uint32_t ways, uint32_t line_words, int write_back, uint32_t penalty) {
+    if (!is_power_of_two(line_words) || ways == 0 || words % (line_words * ways) != 0 ||
+        !is_power_of_two(words / (line_words * ways))) {
+        fprintf(stderr, "Error: Cache size must be ways x line x a power-of-two number of sets\n");
+        exit(1);
+    }
+
+    Cache* cache = (Cache*)calloc(1, sizeof(Cache));
+    if (!cache) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    cache->ways = ways;
+    cache->line_words = line_words;
+    cache->sets = words / (line_words * ways);
+    while ((1u << cache->line_shift) < line_words) cache->line_shift++;
+    cache->write_back = write_back;
+    cache->miss_penalty = penalty;
+    cache->tags = (uint32_t*)calloc((size_t)cache->sets * ways, sizeof(uint32_t));
+    cache->last_use = (uint64_t*)calloc((size_t)cache->sets * ways, sizeof(uint64_t));
+    cache->dirty = (uint8_t*)calloc((size_t)cache->sets * ways, 1);
+    if (!cache->tags || !cache->last_use || !cache->dirty) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    return cache;
+}
+
+void free_cache(Cache* cache) {
+    if (!cache) return;
+    free(cache->tags);
+    free(cache->last_use);
+    free(cache->dirty);
+    free(cache);
+}
+
+// Tag store copies for snapshots
+Cache* clone_cache(const Cache* src) {
+    size_t entries = (size_t)src->sets * src->ways;
+    Cache* cache = (Cache*)malloc(sizeof(Cache));
+    if (!cache) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(cache, src, sizeof(Cache));
+    cache->tags = (uint32_t*)malloc(sizeof(uint32_t) * entries);
+    cache->last_use = (uint64_t*)malloc(sizeof(uint64_t) * entries);
+    cache->dirty = (uint8_t*)malloc(entries);
+    if (!cache->tags || !cache->last_use || !cache->dirty) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(cache->tags, src->tags, sizeof(uint32_t) * entries);
+    memcpy(cache->last_use, src->last_use, sizeof(uint64_t) * entries);
+    memcpy(cache->dirty, src->dirty, entries);
+    return cache;
+}
+
+void restore_cache(Cache* dst, const Cache* src) {
+    size_t entries = (size_t)src->sets * src->ways;
+    uint32_t* tags = dst->tags;
+    uint64_t* last_use = dst->last_use;
+    uint8_t* dirty = dst->dirty;
+    memcpy(dst, src, sizeof(Cache));
+    dst->tags = tags;
+    dst->last_use = last_use;
+    dst->dirty = dirty;
+    memcpy(dst->tags, src->tags, sizeof(uint32_t) * entries);
+    memcpy(dst->last_use, src->last_use, sizeof(uint64_t) * entries);
+    memcpy(dst->dirty, src->dirty, entries);
+}
+
+// Returns the stall cycles caused by one access
+uint32_t cache_access(Cache* cache, uint32_t addr, int is_write, uint32_t pc) {
+    uint32_t line = addr >> cache->line_shift;
+    uint32_t set = line & (cache->sets - 1);
+    uint32_t* tags = &cache->tags[set * cache->ways];
+    uint64_t* last_use = &cache->last_use[set * cache->ways];
+    uint8_t* dirty = &cache->dirty[set * cache->ways];
+    uint32_t victim = 0;
+
+    pc %= MEMORY_SIZE;
+    cache->pc_accesses[pc]++;
+    cache->clock++;
+    if (is_write) cache->writes++;
+    else cache->reads++;
+
+    for (uint32_t w = 0; w < cache->ways; w++) {
+        if (last_use[w] && tags[w] == line) {
+            last_use[w] = cache->clock;
+            if (is_write && cache->write_back) dirty[w] = 1;
+            return 0;
+        }
+        if (last_use[w] < last_use[victim]) victim = w;
+    }
+
+    // Miss
+    cache->pc_misses[pc]++;
+    if (is_write) cache->write_misses++;
+    else cache->read_misses++;
+    if (is_write && !cache->write_back) return 0;  // No allocate, write buffer absorbs it
+
+    uint32_t stall = cache->miss_penalty;
+    if (last_use[victim] && dirty[victim]) {
+        cache->writebacks++;
+        stall += cache->miss_penalty;
+    }
+    tags[victim] = line;
+    last_use[victim] = cache->clock;
+    dirty[victim] = (uint8_t)(is_write && cache->write_back);
+    cache->stall_cycles += stall;
+    return stall;
+}
+
+void write_cache_report(FILE* f, Cache* cache) {
+    uint64_t accesses = cache->reads + cache->writes;
+    uint64_t misses = cache->read_misses + cache->write_misses;
+
+    fprintf(f, "Data cache: %u words, %u-way, %u-word lines, %s, miss penalty %u\n",
+        cache->sets * cache->ways * cache->line_words, cache->ways, cache->line_words,
+        cache->write_back ? "write-back" : "write-through", cache->miss_penalty);
+    fprintf(f, "  reads %llu (misses %llu), writes %llu (misses %llu), writebacks %llu\n",
+        (unsigned long long)cache->reads, (unsigned long long)cache->read_misses,
+        (unsigned long long)cache->writes, (unsigned long long)cache->write_misses,
+        (unsigned long long)cache->writebacks);
+    fprintf(f, "  hit rate %.2f%%, stall cycles %llu\n",
+        accesses ? 100.0 * (accesses - misses) / accesses : 100.0,
+        (unsigned long long)cache->stall_cycles);
+
+    // Misses per PC, worst first
+    fprintf(f, "  misses by PC:\n");
+    for (;;) {
+        uint32_t worst = 0, worst_pc = 0;
+        for (uint32_t pc = 0; pc < MEMORY_SIZE; pc++) {
+            if (cache->pc_misses[pc] > worst) {
+                worst = cache->pc_misses[pc];
+                worst_pc = pc;
+            }
+        }
+        if (worst == 0) break;
+        fprintf(f, "    %03X: %u misses / %u accesses\n", worst_pc, worst, cache->pc_accesses[worst_pc]);
+        cache->pc_misses[worst_pc] = 0;
+    }
+}
+
+/************************* Pipeline Timing Model *************************/
+// Classic IF/ID/EX/MEM/WB timing over the retired instruction stream. The
+// interpreter stays the functional model and keeps its own cycle count;
+// this only reports what a pipelined SIMP would take. With full
+// forwarding the only data hazard is a load (lw, in, vector loads)
+// followed by a user of its result. $imm1/$imm2 are written in ID from the
+// instruction's own fields, so they never cause a hazard. Conditional
+// branches predict not-taken and resolve in EX; jal and reti redirect in ID.
+// A hardware loop's back edge is known at fetch and costs nothing; a loop
+// instruction that skips its body redirects in ID like a jump.
+Pipeline* create_pipeline(uint32_t branch_penalty) {
+    Pipeline* p = (Pipeline*)calloc(1, sizeof(Pipeline));
+    if (!p) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    p->branch_penalty = branch_penalty;
+    p->jump_penalty = 1;
+    p->interrupt_penalty = 3;  // Instructions in IF, ID and EX are squashed
+    return p;
+}
+
+// Registers read by an instruction; vector registers are numbered 16-31
+int pipeline_sources(Instruction inst, uint32_t* src) {
+    int n = 0;
+    switch (inst.opcode) {
+    case 6: case 7: case 8:                       // Shifts
+    case 19:                                      // in
+    case 22: case 24: case 29:                    // vlw, vlws, vsetvl
+        src[n++] = inst.rs;
+        src[n++] = inst.rt;
+        break;
+    case 15:                                      // jal
+        src[n++] = inst.rm;
+        break;
+    case 17:                                      // sw
+        src[n++] = inst.rs;
+        src[n++] = inst.rt;
+        src[n++] = inst.rd;
+        src[n++] = inst.rm;
+        break;
+    case 18: case 21: case 30:                    // reti, halt, wfi
+        break;
+    case 23:                                      // vsw
+        src[n++] = inst.rs;
+        src[n++] = inst.rt;
+        src[n++] = 16 + inst.rd;
+        break;
+    case 25: case 27:                             // vadd, vmac
+        src[n++] = 16 + inst.rs;
+        src[n++] = 16 + inst.rt;
+        src[n++] = 16 + inst.rm;
+        break;
+    case 26:                                      // vmul
+        src[n++] = 16 + inst.rs;
+        src[n++] = 16 + inst.rt;
+        break;
+    case 28:                                      // vred
+        src[n++] = 16 + inst.rs;
+        src[n++] = inst.rm;
+        break;
+    default:                                      // ALU, branches, lw, out
+        src[n++] = inst.rs;
+        src[n++] = inst.rt;
+        src[n++] = inst.rm;
+        break;
+    }
+    return n;
+}
+
+// Register loaded from memory or I/O in MEM, 0 if the instruction is not a load
+uint32_t pipeline_load_dest(Instruction inst) {
+    switch (inst.opcode) {
+    case 16: case 19:                                        // lw, in
+    case 31: case 32: return inst.rd > 2 ? inst.rd : 0;      // amoswap, amoadd
+    case 22: case 24: return inst.rd ? 16 + inst.rd : 0;     // vlw, vlws
+    default: return 0;
+    }
+}
+
+// mispredict is -1 without a branch predictor: branches are then predicted
+// not taken and jumps always pay the ID redirect. With one, a conditional
+// branch that missed costs the branch penalty and a jal or reti that
+// missed its BTB target the ID redirect. A hit taken to a direct target
+// still pays the ID redirect, since the BTB only holds register targets
+void pipeline_retire(Pipeline* p, uint32_t pc, Instruction inst, uint32_t next_pc, uint32_t mem_stall,
+    int mispredict) {
+    uint32_t src[4];
+    uint32_t stall = 0;
+    int n = pipeline_sources(inst, src);
+
+    // Fetched from somewhere the previous instruction did not go: interrupt entry
+    if (p->instructions && pc != p->expected_pc) {
+        p->interrupt_stalls += p->interrupt_penalty;
+        stall += p->interrupt_penalty;
+    }
+
+    // Load-use: one bubble even with forwarding
+    if (p->prev_dest) {
+        for (int i = 0; i < n; i++) {
+            if (src[i] == p->prev_dest && src[i] > 2 && src[i] != 16) {
+                p->load_use_stalls++;
+                stall++;
+                break;
+            }
+        }
+    }
+
+    // Control flow penalties
+    if (mispredict >= 0 && ((inst.opcode >= 9 && inst.opcode <= 15) || inst.opcode == 18)) {
+        if (mispredict && inst.opcode <= 14) {
+            p->branch_stalls += p->branch_penalty;
+            stall += p->branch_penalty;
+        }
+        else if (mispredict || (next_pc != pc + 1 && inst.opcode != 18 && inst.rm <= 2)) {
+            p->jump_stalls += p->jump_penalty;
+            stall += p->jump_penalty;
+        }
+    }
+    else if (inst.opcode >= 9 && inst.opcode <= 14) {
+        if (next_pc != pc + 1) {
+            p->branch_stalls += p->branch_penalty;
+            stall += p->branch_penalty;
+        }
+    }
+    else if (inst.opcode == 15 || inst.opcode == 18 || (inst.opcode == 33 && next_pc != pc + 1)) {
+        p->jump_stalls += p->jump_penalty;
+        stall += p->jump_penalty;
+    }
+
+    p->memory_stalls += mem_stall;
+    stall += mem_stall;
+
+    p->pc_stalls[pc % MEMORY_SIZE] += stall;
+    p->prev_dest = pipeline_load_dest(inst);
+    p->expected_pc = next_pc;
+    p->instructions++;
+}
+
+void write_pipeline_report(FILE* f, Pipeline* p) {
+    uint64_t stalls = p->load_use_stalls + p->branch_stalls + p->jump_stalls +
+        p->interrupt_stalls + p->memory_stalls;
+    uint64_t cycles = p->instructions ? p->instructions + 4 + stalls : 0;  // + fill
+
+    fprintf(f, "Pipeline: 5-stage, forwarding, branch penalty %u, jump penalty %u\n",
+        p->branch_penalty, p->jump_penalty);
+    fprintf(f, "  instructions %llu, cycles %llu, CPI %.3f\n",
+        (unsigned long long)p->instructions, (unsigned long long)cycles,
+        p->instructions ? (double)cycles / p->instructions : 0.0);
+    fprintf(f, "  stalls: load-use %llu, branch %llu, jump %llu, interrupt %llu, memory %llu, fill 4\n",
+        (unsigned long long)p->load_use_stalls, (unsigned long long)p->branch_stalls,
+        (unsigned long long)p->jump_stalls, (unsigned long long)p->interrupt_stalls,
+        (unsigned long long)p->memory_stalls);
+
+    // Stall cycles per PC, worst first
+    fprintf(f, "  stalls by PC:\n");
+    for (;;) {
+        uint32_t worst = 0, worst_pc = 0;
+        for (uint32_t pc = 0; pc < MEMORY_SIZE; pc++) {
+            if (p->pc_stalls[pc] > worst) {
+                worst = p->pc_stalls[pc];
+                worst_pc = pc;
+            }
+        }
+        if (worst == 0) break;
+        fprintf(f, "    %03X: %u\n", worst_pc, worst);
+        p->pc_stalls[worst_pc] = 0;
+    }
+}
+
+/************************* Branch Prediction *************************/
+// Predictors are given as "static" (not taken), "btfn" (backward taken,
+// forward not taken), "bimodal:N" (N 2-bit counters) or "gshare:H" (H
+// history bits). All of them share one BTB size for register targets
+// (returns via $ra, reti, jal through a register). Several predictors can
+// run in one pass over the same branch stream. The first one steers the
+// pipeline model; the reports cost each misprediction at the pipeline's
+// branch penalty, whether or not --pipeline is on.
+int predict_not_taken(Predictor* p, uint32_t pc, uint32_t target) {
+    return 0;
+}
+
+int predict_btfn(Predictor* p, uint32_t pc, uint32_t target) {
+    return target != 0xFFFFFFFF && target <= pc;
+}
+
+int predict_bimodal(Predictor* p, uint32_t pc, uint32_t target) {
+    return p->counters[pc & p->mask] >= 2;
+}
+
+int predict_gshare(Predictor* p, uint32_t pc, uint32_t target) {
+    return p->counters[(pc ^ p->history) & p->mask] >= 2;
+}
+
+void update_none(Predictor* p, uint32_t pc, int taken) {
+}
+
+void update_counter(uint8_t* counter, int taken) {
+    if (taken && *counter < 3) (*counter)++;
+    else if (!taken && *counter > 0) (*counter)--;
+}
+
+void update_bimodal(Predictor* p, uint32_t pc, int taken) {
+    update_counter(&p->counters[pc & p->mask], taken);
+}
+
+void update_gshare(Predictor* p, uint32_t pc, int taken) {
+    update_counter(&p->counters[(pc ^ p->history) & p->mask], taken);
+    p->history = ((p->history << 1) | (taken ? 1 : 0)) & p->mask;
+}
+
+Predictor* create_predictor(const char* spec, uint32_t btb_entries) {
+    const char* colon = strchr(spec, ':');
+    size_t kind = colon ? (size_t)(colon - spec) : strlen(spec);
+    uint32_t param = colon ? (uint32_t)strtoul(colon + 1, NULL, 0) : 0;
+    uint32_t entries = 0;
+
+    Predictor* p = (Predictor*)calloc(1, sizeof(Predictor));
+    if (!p) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    strncpy(p->name, spec, sizeof(p->name) - 1);
+
+    if (kind == 6 && strncmp(spec, "static", kind) == 0) {
+        p->predict = predict_not_taken;
+        p->update = update_none;
+    }
+    else if (kind == 4 && strncmp(spec, "btfn", kind) == 0) {
+        p->predict = predict_btfn;
+        p->update = update_none;
+    }
+    else if (kind == 7 && strncmp(spec, "bimodal", kind) == 0) {
+        entries = param ? param : 1024;
+        p->predict = predict_bimodal;
+        p->update = update_bimodal;
+    }
+    else if (kind == 6 && strncmp(spec, "gshare", kind) == 0) {
+        entries = 1u << (param ? (param > 20 ? 20 : param) : 10);
+        p->predict = predict_gshare;
+        p->update = update_gshare;
+    }
+    else {
+        fprintf(stderr, "Error: Unknown branch predictor %s\n", spec);
+        exit(1);
+    }
+
+    if (entries) {
+        if (!is_power_of_two(entries)) {
+            fprintf(stderr, "Error: Predictor table size must be a power of two: %s\n", spec);
+            exit(1);
+        }
+        p->counters = (uint8_t*)malloc(entries);
+        if (!p->counters) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+        memset(p->counters, 1, entries);  // Weakly not taken
+        p->mask = entries - 1;
+    }
+
+    if (!is_power_of_two(btb_entries)) {
+        fprintf(stderr, "Error: BTB size must be a power of two\n");
+        exit(1);
+    }
+    p->btb_tags = (uint32_t*)malloc(sizeof(uint32_t) * btb_entries);
+    p->btb_targets = (uint32_t*)calloc(btb_entries, sizeof(uint32_t));
+    if (!p->btb_tags || !p->btb_targets) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memset(p->btb_tags, 0xFF, sizeof(uint32_t) * btb_entries);
+    p->btb_mask = btb_entries - 1;
+    return p;
+}
+
+void free_predictor(Predictor* p) {
+    free(p->counters);
+    free(p->btb_tags);
+    free(p->btb_targets);
+    free(p);
+}
+
+void predict_branch(Processor* proc, uint32_t pc, Instruction inst, int taken, uint32_t next_pc) {
+    int conditional = inst.opcode != 15 && inst.opcode != 18;
+    int direct = inst.opcode != 18 && inst.rm <= 2;  // Target from $zero or an immediate
+    uint32_t target = direct ? proc->registers[inst.rm] : 0xFFFFFFFF;
+
+    for (int i = 0; i < proc->num_predictors; i++) {
+        Predictor* p = proc->predictors[i];
+        int predicted = conditional ? p->predict(p, pc, target) : 1;
+        int miss = predicted != taken;
+
+        // A taken register-target branch also needs the right BTB target
+        if (!miss && taken && !direct) {
+            uint32_t slot = pc & p->btb_mask;
+            if (p->btb_tags[slot] != pc || p->btb_targets[slot] != next_pc) {
+                miss = 1;
+                p->target_mispredicts++;
+            }
+        }
+        if (taken && !direct) {
+            uint32_t slot = pc & p->btb_mask;
+            p->btb_tags[slot] = pc;
+            p->btb_targets[slot] = next_pc;
+        }
+        if (conditional) p->update(p, pc, taken);
+
+        p->branches++;
+        p->pc_branches[pc % MEMORY_SIZE]++;
+        if (miss) {
+            p->mispredicts++;
+            p->pc_mispredicts[pc % MEMORY_SIZE]++;
+        }
+        if (i == 0) proc->last_mispredict = miss;
+    }
+}
+
+void write_predictor_report(FILE* f, Predictor* p, uint32_t penalty) {
+    fprintf(f, "Branch predictor %s (BTB %u): %llu branches, %llu mispredicts (%llu target), "
+        "accuracy %.2f%%, penalty %llu cycles\n",
+        p->name, p->btb_mask + 1, (unsigned long long)p->branches,
+        (unsigned long long)p->mispredicts, (unsigned long long)p->target_mispredicts,
+        p->branches ? 100.0 * (p->branches - p->mispredicts) / p->branches : 100.0,
+        (unsigned long long)(p->mispredicts * penalty));
+
+    // Mispredicts per PC, worst first
+    fprintf(f, "  mispredicts by PC:\n");
+    for (;;) {
+        uint32_t worst = 0, worst_pc = 0;
+        for (uint32_t pc = 0; pc < MEMORY_SIZE; pc++) {
+            if (p->pc_mispredicts[pc] > worst) {
+                worst = p->pc_mispredicts[pc];
+                worst_pc = pc;
+            }
+        }
+        if (worst == 0) break;
+        fprintf(f, "    %03X: %u / %u\n", worst_pc, worst, p->pc_branches[worst_pc]);
+        p->pc_mispredicts[worst_pc] = 0;
+    }
+}
+
+/************************* Idle Skipping *************************/
+// A core sleeping in wfi does nothing until an enabled IRQ status bit is
+// set, so instead of stepping cycle by cycle the main loop jumps to the
+// next cycle on which a device can change state and advances the device
+// counters by the skipped amount.
+int irq_pending(Processor* proc) {
+    return (proc->irq0enable & proc->irq0status) |
+        (proc->irq1enable & proc->irq1status) |
+        (proc->irq2enable & proc->irq2status);
+}
+
+// Cycles until the next device update that can set a status bit, 0 if none.
+// While core 0 runs it can start a device on any cycle, so other cores
+// wait one cycle at a time; once it halts they follow its bus schedule
+uint32_t next_device_event(Processor* proc, Irq2Source* irq2) {
+    Processor* io = proc->io;
+    uint32_t next = 0;
+
+    if (io != proc && !io->halt) return 1;
+    if (io->bus_next != BUS_IDLE && io->bus_next > proc->cycle_counter) {
+        next = io->bus_next - proc->cycle_counter;
+    }
+    if (irq2 && !irq2->pos.done && irq2->pos.next > proc->cycle_counter) {
+        uint32_t e = irq2->pos.next - proc->cycle_counter;
+        if (!next || e < next) next = e;
+    }
+    return next;
+}
+
+// Idle cycles in which no event fires; the bus applies their device ticks lazily
+void advance_idle_cycles(Processor* proc, uint32_t cycles) {
+    proc->cycle_counter += cycles;
+}
+
+/************************* Device Updates *************************/
+void update_devices(Processor* proc) {
+    if (proc->cycle_counter >= proc->bus_next) bus_sync(proc, proc->cycle_counter + 1);
+    check_interrupts(proc);
+}
+
+// Every device ticks every cycle: the reference interpreter's check on
+// the bus's event scheduling
+void tick_devices(Processor* proc) {
+    for (int i = 0; i < io_bus.num_timed; i++) io_bus.timed[i]->on_event(proc);
+    proc->bus_synced = proc->cycle_counter + 1;
+    bus_schedule(proc);
+    check_interrupts(proc);
+}
+/************************* Output Files *************************/
+// Every output goes through an OutputFile. Normally it is a plain file.
+// With --verify DIR each output is compared as it is produced with the
+// file of the same name in DIR and nothing is written. At the first
+// difference the file is created from the matching prefix of the expected
+// file and written normally from then on; if any output differs, the
+// matching ones are written too, so a failed run leaves the same files as
+// an ordinary one. Outputs DIR has no file for, such as most traces, are
+// spooled to PATH.verify and renamed to PATH only if verification fails.
+void open_output(OutputFile* o, const char* path, const char* name, int binary) {
+    memset(o, 0, sizeof(*o));
+    snprintf(o->path, sizeof(o->path), "%s", path);
+    o->binary = binary;
+    if (!options.verify) {
+        o->f = fopen(path, binary ? "wb" : "w");
+        if (!o->f) {
+            fprintf(stderr, "Error: Cannot open output file %s\n", path);
+            exit(1);
+        }
+        return;
+    }
+    snprintf(o->expected_path, sizeof(o->expected_path), "%s/%s", options.verify, name);
+    o->expected = fopen(o->expected_path, binary ? "rb" : "r");  // Text mode matches CRLF files on Windows
+    if (!o->expected) {
+        snprintf(o->spool_path, sizeof(o->spool_path), "%s.verify", path);
+        o->f = fopen(o->spool_path, binary ? "wb" : "w");
+        if (!o->f) {
+            fprintf(stderr, "Error: Cannot open output file %s\n", o->spool_path);
+            exit(1);
+        }
+        return;
+    }
+    o->buffer = (char*)malloc(VERIFY_CHUNK);
+    if (!o->buffer) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+}
+
+void output_write(OutputFile* o, const void* data, size_t n) {
+    const char* text = (const char*)data;
+    if (o->f) {
+        fwrite(text, 1, n, o->f);
+        if (o->failed && !o->actual_done) output_mismatch(o, text, n);  // Rest of the differing line
+        return;
+    }
+    if (!o->expected) return;
+
+    size_t done = 0;
+    while (done < n) {
+        if (o->used == o->buffered) {
+            o->buffered = fread(o->buffer, 1, VERIFY_CHUNK, o->expected);
+            o->used = 0;
+            if (o->buffered == 0) break;  // Output is longer than expected
+        }
+        size_t k = o->buffered - o->used;
+        if (k > n - done) k = n - done;
+        size_t same = 0;
+        if (memcmp(text + done, o->buffer + o->used, k) == 0) same = k;
+        else while (text[done + same] == o->buffer[o->used + same]) same++;
+        o->used += same;
+        o->matched += same;
+        done += same;
+        if (same < k) break;
+    }
+    if (done < n) output_mismatch(o, text + done, n - done);
+}
+
+void output_printf(OutputFile* o, const char* format, ...) {
+    char line[MAX_LINE_LENGTH];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n > 0) output_write(o, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+}
+
+// At the first difference create the file and keep the differing line for
+// the report; afterwards only collect the rest of that line
+void output_mismatch(OutputFile* o, const char* rest, size_t n) {
+    if (!o->failed) {
+        o->failed = 1;
+        copy_matched(o);
+        fwrite(rest, 1, n, o->f);
+    }
+    for (size_t i = 0; i < n && !o->actual_done; i++) {
+        if (rest[i] == '\n' && !o->binary) o->actual_done = 1;
+        else if (o->actual_length < sizeof(o->actual) - 1) o->actual[o->actual_length++] = rest[i];
+    }
+}
+
+// Create the output file holding the matched prefix of the expected file
+void copy_matched(OutputFile* o) {
+    o->f = fopen(o->path, o->binary ? "wb" : "w");
+    if (!o->f) {
+        fprintf(stderr, "Error: Cannot open output file %s\n", o->path);
+        exit(1);
+    }
+    rewind(o->expected);
+    for (uint64_t left = o->matched; left;) {
+        size_t k = left < VERIFY_CHUNK ? (size_t)left : VERIFY_CHUNK;
+        k = fread(o->buffer, 1, k, o->expected);
+        if (k == 0) break;
+        fwrite(o->buffer, 1, k, o->f);
+        left -= k;
+    }
+}
+
+// First difference as a line number with the lines before it, or a byte
+// offset for binary files
+void report_mismatch(FILE* f, OutputFile* o) {
+    if (o->binary) {
+        rewind(o->expected);
+        fseek(o->expected, (long)o->matched, SEEK_SET);
+        int expected = fgetc(o->expected);
+        fprintf(f, "  %s differs at byte %llu: expected ", o->path, (unsigned long long)o->matched);
+        if (expected == EOF) fprintf(f, "end of file");
+        else fprintf(f, "%02X", expected);
+        if (o->actual_length) fprintf(f, ", got %02X\n", (uint8_t)o->actual[0]);
+        else fprintf(f, ", got end of file\n");
+        return;
+    }
+
+    // The last few lines up to the difference, the current one partial
+    char lines[VERIFY_CONTEXT + 1][MAX_LINE_LENGTH];
+    size_t lengths[VERIFY_CONTEXT + 1] = { 0 };
+    uint64_t line = 1;
+    rewind(o->expected);
+    for (uint64_t i = 0; i < o->matched; i++) {
+        int c = fgetc(o->expected);
+        if (c == EOF) break;
+        char* cur = lines[line % (VERIFY_CONTEXT + 1)];
+        size_t* len = &lengths[line % (VERIFY_CONTEXT + 1)];
+        if (c == '\n') {
+            line++;
+            lengths[line % (VERIFY_CONTEXT + 1)] = 0;
+        }
+        else if (*len < MAX_LINE_LENGTH - 1) cur[(*len)++] = (char)c;
+    }
+    size_t slot = line % (VERIFY_CONTEXT + 1);
+    size_t prefix = lengths[slot];
+    char expected[MAX_LINE_LENGTH];
+    memcpy(expected, lines[slot], prefix);
+    size_t n = prefix;
+    int c = fgetc(o->expected);
+    int expected_eof = c == EOF;
+    while (c != EOF && c != '\n') {
+        if (n < sizeof(expected) - 1) expected[n++] = (char)c;
+        c = fgetc(o->expected);
+    }
+    expected[n] = '\0';
+    int actual_eof = o->actual_length == 0 && !o->actual_done;
+    size_t m = prefix + o->actual_length < MAX_LINE_LENGTH - 1 ? o->actual_length : MAX_LINE_LENGTH - 1 - prefix;
+
+    fprintf(f, "  %s differs at line %llu:\n", o->path, (unsigned long long)line);
+    for (uint64_t l = line > VERIFY_CONTEXT ? line - VERIFY_CONTEXT : 1; l < line; l++) {
+        size_t s = l % (VERIFY_CONTEXT + 1);
+        fprintf(f, "    %8llu  %.*s\n", (unsigned long long)l, (int)lengths[s], lines[s]);
+    }
+    if (expected_eof && prefix == 0) fprintf(f, "  - %8llu  (end of file)\n", (unsigned long long)line);
+    else fprintf(f, "  - %8llu  %s\n", (unsigned long long)line, expected);
+    if (actual_eof && prefix == 0) fprintf(f, "  + %8llu  (end of output)\n", (unsigned long long)line);
+    else fprintf(f, "  + %8llu  %.*s%.*s\n", (unsigned long long)line, (int)prefix, lines[slot], (int)m, o->actual);
+}
+
+// Check that no expected bytes are left, report, and write every output
+// if anything differs. Returns the number of differing outputs.
+int finish_outputs(OutputFile** outputs, int count) {
+    int failures = 0;
+    int checked = 0;
+    for (int i = 0; i < count; i++) {
+        OutputFile* o = outputs[i];
+        if (!o->expected) continue;
+        checked++;
+        if (!o->failed) {
+            if (o->used == o->buffered) {
+                o->buffered = fread(o->buffer, 1, VERIFY_CHUNK, o->expected);
+                o->used = 0;
+            }
+            if (o->used < o->buffered) output_mismatch(o, "", 0);  // Output is shorter
+        }
+        failures += o->failed;
+    }
+
+    if (options.verify) {
+        printf("Verify: %d of %d outputs match %s\n", checked - failures, checked, options.verify);
+        for (int i = 0; i < count; i++) {
+            OutputFile* o = outputs[i];
+            if (!o->expected) {
+                printf("  %s not checked, no %s%s\n", o->path, o->expected_path, failures ? " (written)" : "");
+            }
+            else if (o->failed) report_mismatch(stdout, o);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        OutputFile* o = outputs[i];
+        if (failures && o->expected && !o->f) {
+            o->matched = UINT64_MAX;  // Whole expected file
+            copy_matched(o);
+        }
+        if (o->f) fclose(o->f);
+        if (o->expected) fclose(o->expected);
+        free(o->buffer);
+        if (o->spool_path[0] && failures) {
+            remove(o->path);  // rename does not replace on Windows
+            if (rename(o->spool_path, o->path) != 0) {
+                fprintf(stderr, "Warning: Cannot rename %s to %s\n", o->spool_path, o->path);
+            }
+        }
+        else if (o->spool_path[0]) {
+            remove(o->spool_path);
+        }
+    }
+    return failures;
+}
+
+/************************* File Output Functions *************************/
+// Uppercase hex, zero-padded to digits; the trace formats a line per
+// instruction, too many for sprintf
+char* put_hex(char* out, uint64_t value, int digits) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (int i = digits - 1; i >= 0; i--) {
+        out[i] = hex[value & 0xF];
+        value >>= 4;
+    }
+    return out + digits;
+}
+
+// Both return the bytes written
+int write_trace(OutputFile* f, Processor* proc, uint64_t inst) {
+    // Format: PC INST R0-R15
+    char line[MAX_LINE_LENGTH];
+    char* p = line;
+    if (proc->pc > 0xFFF) p += sprintf(p, "%X", proc->pc);  // Wider than %03X pads
+    else p = put_hex(p, proc->pc, 3);
+    *p++ = ' ';
+    p = put_hex(p, inst & 0xFFFFFFFFFFFF, 12);  // Ensure 12 hex digits
+    for (int i = 0; i < 16; i++) {
+        *p++ = ' ';
+        p = put_hex(p, proc->registers[i], 8);
+    }
+    *p++ = '\n';
+    output_write(f, line, p - line);
+    return (int)(p - line);
+}
+
+int write_hwregtrace(OutputFile* f, uint32_t cycle, const char* name,
+    const char* action, uint32_t value) {
+    char line[MAX_LINE_LENGTH];
+    int n = snprintf(line, sizeof(line), "%d %s %s %08X\n", cycle, action, name, value);
+    output_write(f, line, n);
+    return n;
+}
+
+void write_regout(OutputFile* f, Processor* proc) {
     // Write registers R3-R15 (skip R0-R2)
     for (int i = 3; i < 16; i++) {
-        fprintf(f, "%08X\n", proc->registers[i]);
+        output_printf(f, "%08X\n", proc->registers[i]);
+    }
+}
+
+void write_dmemout(OutputFile* f, Processor* proc) {
+    uint32_t n = output_words(proc->dmem, options.dmem_size, MEMORY_SIZE);
+    for (uint32_t i = 0; i < n; i++) {
+        output_printf(f, "%08X\n", proc->dmem[i]);
+    }
+}
+
+void write_diskout(OutputFile* f, Processor* proc) {
+    uint32_t n = output_words(proc->disk, options.disk_size, DISK_SIZE);
+    for (uint32_t i = 0; i < n; i++) {
+        output_printf(f, "%08X\n", proc->disk[i]);
+    }
+}
+
+void write_monitor(OutputFile* f_txt, OutputFile* f_yuv, Processor* proc) {
+    // Write text format (monitor.txt)
+    size_t pixels = (size_t)options.monitor_size * options.monitor_size;
+    for (size_t i = 0; i < pixels; i++) {
+        output_printf(f_txt, "%02X\n", proc->monitor_buffer[i]);
+    }
+
+    // Write binary YUV format (monitor.yuv)
+    write_monitor_yuv(f_yuv, proc);
+}
+
+// One frame: the luma plane, then gray chroma planes
+void write_monitor_yuv(OutputFile* f_yuv, Processor* proc) {
+    size_t pixels = (size_t)options.monitor_size * options.monitor_size;
+    uint8_t gray[4096];
+    memset(gray, 128, sizeof(gray));
+    output_write(f_yuv, proc->monitor_buffer, pixels);
+    for (size_t left = pixels * 2; left;) {
+        size_t k = left < sizeof(gray) ? left : sizeof(gray);
+        output_write(f_yuv, gray, k);
+        left -= k;
+    }
+}
+
+/************************* Disk Controller *************************/
+// Commands are latched into a queue with the current disksector,
+// diskbuffer, diskcount and diskdesc and run in order. Each command costs
+// a seek plus a per-sector transfer time; the transfer itself happens when
+// the command completes. A single-sector read or write behaves exactly
+// like the original one-command controller.
+void enqueue_disk_command(Processor* proc, uint32_t cmd) {
+    if (proc->disk_queue_count == DISK_QUEUE_SIZE) return;  // Queue full, command dropped
+
+    uint32_t slot = (proc->disk_queue_head + proc->disk_queue_count) % DISK_QUEUE_SIZE;
+    DiskCommand* c = &proc->disk_queue[slot];
+    c->cmd = cmd;
+    c->sector = proc->disksector;
+    c->buffer = proc->diskbuffer;
+    c->count = proc->diskcount ? proc->diskcount : 1;
+    if (c->count > options.disk_size / DISK_SECTOR_WORDS) c->count = options.disk_size / DISK_SECTOR_WORDS;
+    c->desc = proc->diskdesc;
+
+    if (proc->disk_queue_count++ == 0) {
+        start_disk_command(proc);
+    }
+}
+
+void start_disk_command(Processor* proc) {
+    DiskCommand* c = &proc->disk_queue[proc->disk_queue_head];
+
+    proc->diskcmd = c->cmd;
+    proc->diskstatus = 1;  // Set busy
+    proc->disk_busy_cycles = 0;
+
+    if (c->cmd == DISK_CMD_READ || c->cmd == DISK_CMD_WRITE) {
+        proc->disk_latency = DISK_SEEK_CYCLES + c->count * DISK_SECTOR_CYCLES;
+    }
+    else {
+        proc->disk_latency = 0;
+        for (uint32_t d = c->desc; d < options.dmem_size - 2 && proc->dmem[d + 2]; d += 3) {
+            uint32_t count = proc->dmem[d + 2];
+            if (count > options.disk_size / DISK_SECTOR_WORDS) count = options.disk_size / DISK_SECTOR_WORDS;
+            proc->disk_latency += DISK_SEEK_CYCLES + count * DISK_SECTOR_CYCLES;
+        }
+        if (proc->disk_latency == 0) proc->disk_latency = 1;  // Empty list
+    }
+}
+
+// Copy whole sectors; words outside dmem or the disk are skipped
+void disk_transfer(Processor* proc, uint32_t cmd, uint32_t sector, uint32_t buffer, uint32_t count) {
+    if (fuzz.active) {
+        if (cmd == DISK_CMD_READ) fuzz_mark_dmem(buffer, count * DISK_SECTOR_WORDS);
+        else fuzz_mark_disk(sector, count);
+    }
+    for (uint32_t s = 0; s < count && (uint64_t)sector + s < options.disk_size / DISK_SECTOR_WORDS; s++) {
+        for (uint32_t i = 0; i < DISK_SECTOR_WORDS; i++) {
+            uint32_t disk_addr = (sector + s) * DISK_SECTOR_WORDS + i;
+            uint64_t mem_addr = (uint64_t)buffer + s * DISK_SECTOR_WORDS + i;
+            if (mem_addr >= options.dmem_size) continue;
+            if (cmd == DISK_CMD_READ) {
+                proc->dmem[mem_addr] = proc->disk[disk_addr];
+            }
+            else {
+                proc->disk[disk_addr] = proc->dmem[mem_addr];
+            }
+        }
+    }
+}
+
+/************************* Monitor Commands *************************/
+// Fill and copy commands latch their operands when accepted, keep the
+// monitor busy (monitorcmd reads non-zero) for the modeled bus time and
+// update the frame buffer on completion. Commands issued while busy are
+// ignored.
+void start_monitor_command(Processor* proc, uint32_t value) {
+    uint32_t cmd = value & 0xFF;
+    uint32_t pixels;
+
+    if (proc->monitorcmd) return;
+
+    switch (cmd) {
+    case MONITOR_CMD_FILL_RECT:
+    case MONITOR_CMD_COPY_RECT:
+        pixels = (proc->monitorsize & 0xFFFF) * (proc->monitorsize >> 16);
+        break;
+    case MONITOR_CMD_FILL_SPAN:
+        pixels = proc->monitorsize;
+        break;
+    default:
+        return;
+    }
+    if (pixels > options.monitor_size * options.monitor_size) {
+        pixels = options.monitor_size * options.monitor_size;
+    }
+
+    proc->monitorcmd = value;
+    proc->monitor_op_addr = proc->monitoraddr;
+    proc->monitor_op_size = proc->monitorsize;
+    proc->monitor_op_src = proc->monitorsrc;
+    proc->monitor_op_data = proc->monitordata;
+    proc->monitor_busy_cycles = MONITOR_SETUP_CYCLES +
+        (pixels + MONITOR_PIXELS_PER_CYCLE - 1) / MONITOR_PIXELS_PER_CYCLE;
+}
+
+void execute_monitor_command(Processor* proc) {
+    uint32_t size = options.monitor_size;
+    uint32_t x0 = proc->monitor_op_addr % size;
+    uint32_t y0 = proc->monitor_op_addr / size;
+    uint32_t width = proc->monitor_op_size & 0xFFFF;
+    uint32_t height = proc->monitor_op_size >> 16;
+    uint8_t color = (uint8_t)proc->monitor_op_data;
+
+    if (y0 >= size) return;
+
+    switch (proc->monitorcmd & 0xFF) {
+    case MONITOR_CMD_FILL_SPAN: {
+        // Linear run through the frame buffer, wrapping to the next rows
+        uint32_t start = proc->monitor_op_addr;
+        uint32_t end = start + proc->monitor_op_size;
+        if (end > size * size || end < start) end = size * size;
+        for (uint32_t addr = start; addr < end; ) {
+            uint32_t y = addr / size;
+            uint32_t x = addr % size;
+            uint32_t run = size - x;
+            if (run > end - addr) run = end - addr;
+            memset(monitor_pixel(proc, x, y), color, run);
+            mark_monitor_dirty(proc, x, y);
+            mark_monitor_dirty(proc, x + run - 1, y);
+            addr += run;
+        }
+        break;
+    }
+    case MONITOR_CMD_FILL_RECT:
+        if (width > size - x0) width = size - x0;
+        if (height > size - y0) height = size - y0;
+        if (width == 0) break;
+        for (uint32_t y = y0; y < y0 + height; y++) {
+            memset(monitor_pixel(proc, x0, y), color, width);
+            mark_monitor_dirty(proc, x0, y);
+            mark_monitor_dirty(proc, x0 + width - 1, y);
+        }
+        break;
+    case MONITOR_CMD_COPY_RECT: {
+        // Rows start on a word boundary, pixel 0 in bits 7:0
+        uint32_t pitch = (width + 3) / 4;
+        uint32_t visible = width > size - x0 ? size - x0 : width;
+        if (height > size - y0) height = size - y0;
+        if (visible == 0) break;
+        for (uint32_t row = 0; row < height; row++) {
+            uint32_t y = y0 + row;
+            for (uint32_t col = 0; col < visible; col++) {
+                uint32_t addr = proc->monitor_op_src + row * pitch + col / 4;
+                uint32_t word = addr < options.dmem_size ? proc->dmem[addr] : 0;
+                *monitor_pixel(proc, x0 + col, y) = (uint8_t)(word >> (8 * (col % 4)));
+            }
+            mark_monitor_dirty(proc, x0, y);
+            mark_monitor_dirty(proc, x0 + visible - 1, y);
+        }
+        break;
+    }
+    }
+}
+
+/************************* Monitor Streaming *************************/
+void mark_monitor_dirty(Processor* proc, uint32_t x, uint32_t y) {
+    if (!proc->monitor_dirty) {
+        proc->monitor_dirty = 1;
+        if (proc->monitor_frame_cycles) {
+            proc->monitor_next_frame =
+                (proc->cycle_counter / proc->monitor_frame_cycles + 1) * proc->monitor_frame_cycles;
+        }
+    }
+    if (y < proc->monitor_dirty_top) proc->monitor_dirty_top = y;
+    if (y > proc->monitor_dirty_bottom) proc->monitor_dirty_bottom = y;
+    if (x < proc->monitor_dirty_min_x[y]) proc->monitor_dirty_min_x[y] = (uint16_t)x;
+    if (x > proc->monitor_dirty_max_x[y]) proc->monitor_dirty_max_x[y] = (uint16_t)x;
+}
+
+void clear_monitor_dirty(Processor* proc) {
+    for (uint32_t y = 0; y < options.monitor_size; y++) {
+        proc->monitor_dirty_min_x[y] = (uint16_t)options.monitor_size;
+        proc->monitor_dirty_max_x[y] = 0;
+    }
+    proc->monitor_dirty_top = options.monitor_size;
+    proc->monitor_dirty_bottom = 0;
+    proc->monitor_dirty = 0;
+    proc->monitor_vsync = 0;
+}
+
+void write_u16(OutputFile* f, uint32_t value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    output_write(f, bytes, 2);
+}
+
+void write_u32(OutputFile* f, uint32_t value) {
+    write_u16(f, value & 0xFFFF);
+    write_u16(f, value >> 16);
+}
+
+// Delta format: "SIMPMON1", u16 width, u16 height, then per frame
+// u32 cycle, u32 span count and spans of (u16 y, u16 x, u16 length, pixels).
+// All integers are little endian.
+void write_monitor_delta_header(OutputFile* f) {
+    output_write(f, MONITOR_DELTA_MAGIC, 8);
+    write_u16(f, options.monitor_size);
+    write_u16(f, options.monitor_size);
+}
+
+void write_monitor_delta(OutputFile* f, Processor* proc) {
+    uint32_t spans = 0;
+    for (uint32_t y = proc->monitor_dirty_top; y <= proc->monitor_dirty_bottom; y++) {
+        if (proc->monitor_dirty_min_x[y] <= proc->monitor_dirty_max_x[y]) spans++;
+    }
+
+    write_u32(f, proc->cycle_counter);
+    write_u32(f, spans);
+    for (uint32_t y = proc->monitor_dirty_top; y <= proc->monitor_dirty_bottom; y++) {
+        uint32_t x0 = proc->monitor_dirty_min_x[y];
+        uint32_t x1 = proc->monitor_dirty_max_x[y];
+        if (x0 > x1) continue;
+        write_u16(f, y);
+        write_u16(f, x0);
+        write_u16(f, x1 - x0 + 1);
+        output_write(f, monitor_pixel(proc, x0, y), x1 - x0 + 1);
+    }
+}
+
+// Write one frame if anything was drawn since the previous one
+void emit_monitor_frame(OutputFile* f, Processor* proc) {
+    if (!proc->monitor_dirty) return;
+
+    if (options.monitor_delta) {
+        write_monitor_delta(f, proc);
+    }
+    else {
+        write_monitor_yuv(f, proc);
+    }
+    clear_monitor_dirty(proc);
+}
+
+/************************* Memory Access Trace *************************/
+// --memtrace FILE records every dmem access by lw, sw, the vector loads and
+// stores and the atomics (a read and a write each). Format: "SIMPMEM2",
+// u32 dmem size in words, then 16-byte little-endian records of u32 cycle,
+// u16 pc (bit 15 set for a write), u16 core, u32 address and u32 value.
+// With several threaded cores the records of different cores interleave
+// in host order. memtrace/memtrace.c analyzes the file.
+void put_u32(uint8_t* out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out[i] = (uint8_t)(v >> (8 * i));
+}
+
+void trace_memory(Processor* proc, uint32_t addr, int is_write, uint32_t value) {
+    uint8_t rec[16];
+    uint32_t pc = (proc->pc & 0xFFF) | (is_write ? MEMTRACE_WRITE : 0);
+
+    if (proc->cycle_counter < debugger.high_water) return;  // Replayed by the debugger
+    put_u32(rec, proc->cycle_counter);
+    put_u32(rec + 4, pc | (proc->core_id << 16));
+    put_u32(rec + 8, addr);
+    put_u32(rec + 12, value);
+    fwrite(rec, 1, sizeof(rec), memtrace);
+}
+
+/************************* Debugger *************************/
+// --debug stops at cycle 0 and reads commands from stdin. Breakpoints swap
+// the decoded entry at a PC for a TRAP_OPCODE entry, so the run loop only
+// looks at the opcode it already fetched. Data watchpoints mark 128-word
+// pages; lw, sw and the vector and atomic accesses test the page byte and
+// only search the watchpoint list on marked pages. I/O watchpoints are a
+// bit mask tested in handle_io_write. Watch hits stop after the
+// instruction completes.
+void debug_help(void) {
+    printf("Commands (addresses in hex):\n"
+        "  c                continue\n"
+        "  s [N]            step N instructions (default 1)\n"
+        "  b PC / d PC      set / delete a breakpoint\n"
+        "  w ADDR [LEN]     stop on writes to dmem[ADDR..ADDR+LEN-1]\n"
+        "  r ADDR [LEN]     stop on reads\n"
+        "  a ADDR [LEN]     stop on reads or writes\n"
+        "  u ADDR           remove the watchpoints starting at ADDR\n"
+        "  io REG / unio REG  stop on / stop watching writes to an I/O register (name or number)\n"
+        "  i                list breakpoints and watchpoints\n"
+        "  regs [CORE]      show registers\n"
+        "  x ADDR [N]       show N dmem words (default 8)\n"
+        "  goto-cycle N     restore the nearest snapshot and replay to cycle N\n"
+        "  step-back        go back one instruction\n"
+        "  snapshots        list the time-travel snapshots\n"
+        "  q                stop the simulation and write the output files\n");
+}
+
+void debug_update_pages(void) {
+    memset(debugger.pages, 0, options.dmem_size / DEBUG_PAGE_WORDS);
+    for (int i = 0; i < debugger.num_watchpoints; i++) {
+        Watchpoint* w = &debugger.watchpoints[i];
+        for (uint32_t p = w->start / DEBUG_PAGE_WORDS; p <= w->end / DEBUG_PAGE_WORDS; p++) {
+            debugger.pages[p] |= (uint8_t)w->flags;
+        }
+    }
+}
+
+void debug_set_breakpoint(uint32_t pc) {
+    if (pc >= MEMORY_SIZE) {
+        printf("PC out of range\n");
+        return;
+    }
+    for (int i = 0; i < debugger.num_breakpoints; i++) {
+        if (debugger.breakpoints[i].pc == pc) return;
+    }
+    if (debugger.num_breakpoints == MAX_BREAKPOINTS) {
+        printf("Too many breakpoints\n");
+        return;
+    }
+    Breakpoint* b = &debugger.breakpoints[debugger.num_breakpoints++];
+    b->pc = pc;
+    b->original = debugger.cores[0]->decoded[pc];
+    for (int c = 0; c < debugger.num_cores; c++) {
+        debugger.cores[c]->decoded[pc].opcode = TRAP_OPCODE;
+    }
+}
+
+void debug_delete_breakpoint(uint32_t pc) {
+    for (int i = 0; i < debugger.num_breakpoints; i++) {
+        if (debugger.breakpoints[i].pc == pc) {
+            for (int c = 0; c < debugger.num_cores; c++) {
+                debugger.cores[c]->decoded[pc] = debugger.breakpoints[i].original;
+            }
+            debugger.breakpoints[i] = debugger.breakpoints[--debugger.num_breakpoints];
+            return;
+        }
+    }
+    printf("No breakpoint at %03X\n", pc);
+}
+
+void debug_add_watchpoint(uint32_t start, uint32_t len, int flags) {
+    if (start >= options.dmem_size || len == 0) {
+        printf("Address out of range\n");
+        return;
+    }
+    if (debugger.num_watchpoints == MAX_WATCHPOINTS) {
+        printf("Too many watchpoints\n");
+        return;
+    }
+    Watchpoint* w = &debugger.watchpoints[debugger.num_watchpoints++];
+    w->start = start;
+    w->end = start + len - 1 < options.dmem_size ? start + len - 1 : options.dmem_size - 1;
+    w->flags = flags;
+    debug_update_pages();
+}
+
+void debug_remove_watchpoints(uint32_t start) {
+    int i = 0;
+    while (i < debugger.num_watchpoints) {
+        if (debugger.watchpoints[i].start == start) {
+            debugger.watchpoints[i] = debugger.watchpoints[--debugger.num_watchpoints];
+        }
+        else {
+            i++;
+        }
+    }
+    debug_update_pages();
+}
+
+int debug_io_register(const char* s) {
+    if (!s) return -1;
+    for (int i = 0; i < IO_REGISTERS; i++) {
+        if (strcmp(s, io_register_name(i)) == 0) return i;
+    }
+    char* end;
+    unsigned long n = strtoul(s, &end, 0);
+    return *end == '\0' && n < IO_REGISTERS ? (int)n : -1;
+}
+
+void debug_list(void) {
+    for (int i = 0; i < debugger.num_breakpoints; i++) {
+        printf("breakpoint %03X\n", debugger.breakpoints[i].pc);
+    }
+    for (int i = 0; i < debugger.num_watchpoints; i++) {
+        Watchpoint* w = &debugger.watchpoints[i];
+        printf("watch %s %03X-%03X\n", w->flags == WATCH_READ ? "read" :
+            w->flags == WATCH_WRITE ? "write" : "access", w->start, w->end);
+    }
+    for (int i = 0; i < IO_REGISTERS; i++) {
+        if (debugger.io_watch >> i & 1) printf("watch I/O %s\n", io_register_name(i));
+    }
+}
+
+void debug_show_registers(Processor* proc) {
+    printf("core %u pc %03X cycle %u%s\n", proc->core_id, proc->pc, proc->cycle_counter,
+        proc->in_interrupt ? " (in interrupt)" : "");
+    for (int i = 0; i < 16; i++) {
+        printf("R%-2d %08X%s", i, proc->registers[i], i % 4 == 3 ? "\n" : "  ");
+    }
+    for (uint32_t i = proc->loop_depth; i-- > 0; ) {
+        HardwareLoop* loop = &proc->loops[i];
+        printf("loop %03X-%03X, %u iterations left%s\n", loop->start, loop->end - 1, loop->count,
+            loop->in_interrupt ? " (in interrupt)" : "");
+    }
+}
+
+void debug_prompt(Processor* proc) {
+    char line[MAX_LINE_LENGTH];
+
+    printf("[core %u cycle %u pc %03X] %s\n", proc->core_id, proc->cycle_counter, proc->pc,
+        debugger.reason);
+    debugger.steps = 0;
+    for (;;) {
+        printf("(simp) ");
+        fflush(stdout);
+        if (!fgets(line, sizeof(line), stdin)) break;  // End of input: run to the end
+
+        char* cmd = strtok(line, " \t\r\n");
+        char* arg1 = strtok(NULL, " \t\r\n");
+        char* arg2 = strtok(NULL, " \t\r\n");
+        uint32_t n1 = arg1 ? (uint32_t)strtoul(arg1, NULL, 16) : 0;
+        uint32_t n2 = arg2 ? (uint32_t)strtoul(arg2, NULL, 16) : 1;
+
+        if (!cmd) continue;
+        if (strcmp(cmd, "c") == 0) break;
+        if (strcmp(cmd, "s") == 0) {
+            debugger.steps = arg1 ? (uint32_t)strtoul(arg1, NULL, 0) : 1;
+            break;
+        }
+        if (strcmp(cmd, "q") == 0) {
+            for (int c = 0; c < debugger.num_cores; c++) debugger.cores[c]->halt = 1;
+            debugger.seeking = 0;
+            break;
+        }
+        if (strcmp(cmd, "goto-cycle") == 0 || strcmp(cmd, "step-back") == 0) {
+            if (!snapshots.every) {
+                printf("Time travel needs --snapshot-every\n");
+                continue;
+            }
+            int stop = cmd[0] == 'g' ? arg1 && debug_goto(proc, (uint32_t)strtoul(arg1, NULL, 0)) :
+                debug_step_back(proc);
+            if (!stop) break;
+            if (debugger.restored) {
+                printf("[core %u cycle %u pc %03X]\n", proc->core_id, proc->cycle_counter, proc->pc);
+            }
+            continue;
+        }
+        if (strcmp(cmd, "b") == 0 && arg1) debug_set_breakpoint(n1);
+        else if (strcmp(cmd, "d") == 0 && arg1) debug_delete_breakpoint(n1);
+        else if (strcmp(cmd, "w") == 0 && arg1) debug_add_watchpoint(n1, n2, WATCH_WRITE);
+        else if (strcmp(cmd, "r") == 0 && arg1) debug_add_watchpoint(n1, n2, WATCH_READ);
+        else if (strcmp(cmd, "a") == 0 && arg1) debug_add_watchpoint(n1, n2, WATCH_READ | WATCH_WRITE);
+        else if (strcmp(cmd, "u") == 0 && arg1) debug_remove_watchpoints(n1);
+        else if (strcmp(cmd, "io") == 0 || strcmp(cmd, "unio") == 0) {
+            int reg = debug_io_register(arg1);
+            if (reg < 0) printf("Unknown I/O register\n");
+            else if (cmd[0] == 'i') debugger.io_watch |= 1u << reg;
+            else debugger.io_watch &= ~(1u << reg);
+        }
+        else if (strcmp(cmd, "i") == 0) debug_list();
+        else if (strcmp(cmd, "snapshots") == 0) {
+            printf("%d snapshots every %u cycles, %zu bytes of pages\n", snapshots.count,
+                snapshots.interval, snapshots.bytes);
+            for (int i = 0; i < snapshots.count; i++) {
+                printf("  cycle %u: %d pages\n", snapshots.list[i].cycle, snapshots.list[i].num_pages);
+            }
+        }
+        else if (strcmp(cmd, "regs") == 0) {
+            uint32_t core = arg1 ? (uint32_t)strtoul(arg1, NULL, 0) : proc->core_id;
+            if (core < (uint32_t)debugger.num_cores) debug_show_registers(debugger.cores[core]);
+            else printf("No core %u\n", core);
+        }
+        else if (strcmp(cmd, "x") == 0 && arg1) {
+            uint32_t count = arg2 ? (uint32_t)strtoul(arg2, NULL, 0) : 8;
+            for (uint32_t i = 0; i < count && n1 + i < options.dmem_size; i++) {
+                printf("%s%03X: %08X", i % 4 ? "  " : "", n1 + i, proc->dmem[n1 + i]);
+                if (i % 4 == 3 || i + 1 == count || n1 + i + 1 == options.dmem_size) printf("\n");
+            }
+        }
+        else debug_help();
+    }
+
+    debugger.reason[0] = '\0';
+    debugger.pending = debugger.steps > 0 || debugger.seeking;
+    debugger.last_stop_core = proc->core_id;
+    debugger.last_stop_cycle = proc->cycle_counter;
+    debugger.last_stop_pc = proc->pc;
+}
+
+// A fetched trap entry: stop, then run the instruction it replaced
+Instruction debug_breakpoint(Processor* proc, Instruction trap) {
+    for (int i = 0; i < debugger.num_breakpoints; i++) {
+        Breakpoint* b = &debugger.breakpoints[i];
+        if (b->pc != proc->pc) continue;
+        Instruction original = b->original;  // The prompt may delete or move b
+        if (!debugger.seeking && !(debugger.last_stop_core == proc->core_id &&
+            debugger.last_stop_cycle == proc->cycle_counter && debugger.last_stop_pc == proc->pc)) {
+            snprintf(debugger.reason, sizeof(debugger.reason), "breakpoint");
+            debug_prompt(proc);
+        }
+        return original;
+    }
+    return trap;  // A real opcode 63 in the program
+}
+
+void debug_watch(Processor* proc, uint32_t addr, int flag) {
+    if (fuzz.active) {  // First write to a page since the last reset
+        fuzz_mark_dmem(addr, 1);
+        return;
+    }
+    for (int i = 0; i < debugger.num_watchpoints; i++) {
+        Watchpoint* w = &debugger.watchpoints[i];
+        if (addr >= w->start && addr <= w->end && (w->flags & flag)) {
+            snprintf(debugger.reason, sizeof(debugger.reason), "%s dmem[%03X] by pc %03X",
+                flag == WATCH_READ ? "read" : "write", addr, proc->pc);
+            debugger.pending = 1;
+            return;
+        }
+    }
+}
+
+void debug_io_write(Processor* proc, uint32_t address, uint32_t value) {
+    snprintf(debugger.reason, sizeof(debugger.reason), "I/O write %s = %08X by pc %03X",
+        io_register_name(address), value, proc->pc);
+    debugger.pending = 1;
+}
+
+// After an instruction with a watch hit, while stepping or seeking, or at halt
+void debug_check(Processor* proc) {
+    debugger.restored = 0;
+    if (debugger.seeking) {
+        if (!debug_seek(proc)) return;
+    }
+    else if (proc->halt) {
+        snprintf(debugger.reason, sizeof(debugger.reason), "halted");
+    }
+    else if (!debugger.reason[0]) {
+        if (debugger.steps && --debugger.steps) return;
+        snprintf(debugger.reason, sizeof(debugger.reason), "step");
+    }
+    debug_prompt(proc);
+}
+
+/************************* Time Travel *************************/
+// With --snapshot-every K the run loop saves the core every K cycles: the
+// Processor fields above imem, the cache model, and the 512-byte pages of
+// dmem, disk and the monitor that differ from the previous snapshot (found
+// by comparing against a shadow copy, so sw and DMA stay untouched). The
+// shadow starts zeroed, so the first snapshot holds every non-zero page.
+// Restoring snapshot i takes each page from the newest snapshot at or
+// before i and zeroes the pages none of them hold. When the list is full every
+// other snapshot is merged into its successor and the spacing doubles, so
+// memory stays bounded and a seek replays at most the current spacing.
+// Each snapshot records the irq2 source position, so replay rereads or
+// regenerates the same events.
+uint8_t* snapshot_page(Processor* proc, int page) {
+    if (page < snapshots.dmem_pages) {
+        return (uint8_t*)proc->dmem + (size_t)page * SNAPSHOT_PAGE_BYTES;
+    }
+    page -= snapshots.dmem_pages;
+    if (page < snapshots.disk_pages) {
+        return (uint8_t*)proc->disk + (size_t)page * SNAPSHOT_PAGE_BYTES;
+    }
+    page -= snapshots.disk_pages;
+    return proc->monitor_buffer + (size_t)page * SNAPSHOT_PAGE_BYTES;
+}
+
+void init_snapshots(CoreContext* c) {
+    snapshots.every = options.snapshot_every;
+    snapshots.limit = options.snapshot_limit;
+    snapshots.interval = options.snapshot_every;
+    snapshots.ctx = c;
+    snapshots.dmem_pages = (int)(options.dmem_size * sizeof(uint32_t) / SNAPSHOT_PAGE_BYTES);
+    snapshots.disk_pages = (int)(options.disk_size * sizeof(uint32_t) / SNAPSHOT_PAGE_BYTES);
+    snapshots.num_pages = snapshots.dmem_pages + snapshots.disk_pages +
+        (int)(options.monitor_size * options.monitor_size / SNAPSHOT_PAGE_BYTES);
+    snapshots.list = (Snapshot*)calloc(snapshots.limit, sizeof(Snapshot));
+    snapshots.shadow = (uint8_t*)alloc_memory((size_t)snapshots.num_pages * SNAPSHOT_PAGE_BYTES);
+    if (!snapshots.list) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+}
+
+void free_snapshot(Snapshot* s) {
+    free(s->state);
+    free_cache(s->dcache);
+    free(s->page_ids);
+    free(s->pages);
+    memset(s, 0, sizeof(Snapshot));
+}
+
+// Move the pages of s that next lacks into next, then drop s
+void merge_snapshot(Snapshot* s, Snapshot* next) {
+    uint8_t* has = (uint8_t*)calloc(snapshots.num_pages, 1);
+    int extra = 0;
+    if (!has) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < next->num_pages; i++) has[next->page_ids[i]] = 1;
+    for (int i = 0; i < s->num_pages; i++) extra += !has[s->page_ids[i]];
+
+    if (extra) {
+        int total = next->num_pages + extra;
+        uint32_t* ids = (uint32_t*)realloc(next->page_ids, sizeof(uint32_t) * total);
+        uint8_t* pages = (uint8_t*)realloc(next->pages, (size_t)total * SNAPSHOT_PAGE_BYTES);
+        if (!ids || !pages) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+        next->page_ids = ids;
+        next->pages = pages;
+        for (int i = 0; i < s->num_pages; i++) {
+            if (has[s->page_ids[i]]) continue;
+            ids[next->num_pages] = s->page_ids[i];
+            memcpy(pages + (size_t)next->num_pages * SNAPSHOT_PAGE_BYTES,
+                s->pages + (size_t)i * SNAPSHOT_PAGE_BYTES, SNAPSHOT_PAGE_BYTES);
+            next->num_pages++;
+        }
+    }
+    snapshots.bytes -= (size_t)(s->num_pages - extra) * SNAPSHOT_PAGE_BYTES;
+    free(has);
+    free_snapshot(s);
+}
+
+// Keep the first, the last and every second snapshot in between
+void thin_snapshots(void) {
+    int kept = 1;
+    for (int i = 1; i < snapshots.count; i++) {
+        if (i % 2 == 1 && i < snapshots.count - 1) {
+            merge_snapshot(&snapshots.list[i], &snapshots.list[i + 1]);
+        }
+        else {
+            snapshots.list[kept++] = snapshots.list[i];
+        }
+    }
+    for (int i = kept; i < snapshots.count; i++) memset(&snapshots.list[i], 0, sizeof(Snapshot));
+    snapshots.count = kept;
+    snapshots.interval *= 2;
+}
+
+void take_snapshot(CoreContext* c) {
+    Processor* proc = c->proc;
+    uint32_t* ids = (uint32_t*)malloc(sizeof(uint32_t) * snapshots.num_pages);
+    int num_pages = 0;
+
+    if (!ids) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    if (snapshots.count == (int)snapshots.limit) thin_snapshots();
+    Snapshot* s = &snapshots.list[snapshots.count++];
+    s->cycle = proc->cycle_counter;
+    s->state = (uint8_t*)malloc(offsetof(Processor, imem));
+    if (!s->state) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(s->state, proc, offsetof(Processor, imem));
+    s->dcache = proc->dcache ? clone_cache(proc->dcache) : NULL;
+    s->prev_leds = c->prev_leds;
+    s->prev_display = c->prev_display;
+    if (c->irq2) s->irq2 = irq2_tell(c->irq2);
+
+    // Pages that changed since the last snapshot
+    for (int p = 0; p < snapshots.num_pages; p++) {
+        uint8_t* shadow = snapshots.shadow + (size_t)p * SNAPSHOT_PAGE_BYTES;
+        uint8_t* page = snapshot_page(proc, p);
+        if (memcmp(shadow, page, SNAPSHOT_PAGE_BYTES) != 0) {
+            memcpy(shadow, page, SNAPSHOT_PAGE_BYTES);
+            ids[num_pages++] = (uint32_t)p;
+        }
+    }
+    s->num_pages = num_pages;
+    s->page_ids = (uint32_t*)malloc(sizeof(uint32_t) * (num_pages ? num_pages : 1));
+    s->pages = (uint8_t*)malloc((size_t)(num_pages ? num_pages : 1) * SNAPSHOT_PAGE_BYTES);
+    if (!s->page_ids || !s->pages) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < num_pages; i++) {
+        s->page_ids[i] = ids[i];
+        memcpy(s->pages + (size_t)i * SNAPSHOT_PAGE_BYTES,
+            snapshots.shadow + (size_t)ids[i] * SNAPSHOT_PAGE_BYTES, SNAPSHOT_PAGE_BYTES);
+    }
+    snapshots.bytes += (size_t)num_pages * SNAPSHOT_PAGE_BYTES;
+    snapshots.next = proc->cycle_counter + snapshots.interval;
+    free(ids);
+}
+
+void restore_snapshot(int index) {
+    CoreContext* c = snapshots.ctx;
+    Processor* proc = c->proc;
+    Snapshot* s = &snapshots.list[index];
+    uint8_t* done = (uint8_t*)calloc(snapshots.num_pages, 1);
+    int left = snapshots.num_pages;
+
+    if (!done) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+
+    // Output files already hold everything up to here
+    if (proc->cycle_counter > debugger.high_water) debugger.high_water = proc->cycle_counter;
+
+    memcpy(proc, s->state, offsetof(Processor, imem));
+    if (s->dcache) restore_cache(proc->dcache, s->dcache);
+    c->prev_leds = s->prev_leds;
+    c->prev_display = s->prev_display;
+    if (c->irq2) irq2_seek(c->irq2, &s->irq2);
+
+    for (int k = index; k >= 0 && left; k--) {
+        Snapshot* from = &snapshots.list[k];
+        for (int i = 0; i < from->num_pages; i++) {
+            uint32_t p = from->page_ids[i];
+            if (done[p]) continue;
+            memcpy(snapshot_page(proc, p), from->pages + (size_t)i * SNAPSHOT_PAGE_BYTES, SNAPSHOT_PAGE_BYTES);
+            done[p] = 1;
+            left--;
+        }
+    }
+    // Pages no snapshot holds were zero when the first one was taken
+    for (int p = 0; p < snapshots.num_pages && left; p++) {
+        if (done[p]) continue;
+        uint8_t* page = snapshot_page(proc, p);
+        if (!page_is_zero(page, SNAPSHOT_PAGE_BYTES)) memset(page, 0, SNAPSHOT_PAGE_BYTES);
+        left--;
+    }
+    free(done);
+    debugger.restored = 1;
+}
+
+// Newest snapshot at or before cycle, -1 if none
+int find_snapshot(uint32_t cycle) {
+    int found = -1;
+    for (int i = 0; i < snapshots.count && snapshots.list[i].cycle <= cycle; i++) found = i;
+    return found;
+}
+
+void free_snapshots(void) {
+    for (int i = 0; i < snapshots.count; i++) free_snapshot(&snapshots.list[i]);
+    free(snapshots.list);
+    free_memory(snapshots.shadow, (size_t)snapshots.num_pages * SNAPSHOT_PAGE_BYTES);
+    memset(&snapshots, 0, sizeof(snapshots));
+}
+
+// goto-cycle: returns 1 if the debugger can stop right away
+int debug_goto(Processor* proc, uint32_t cycle) {
+    if (cycle < proc->cycle_counter) {
+        int i = find_snapshot(cycle);
+        if (i < 0) {
+            printf("No snapshot at or before cycle %u\n", cycle);
+            return 1;
+        }
+        restore_snapshot(i);
+    }
+    if (proc->cycle_counter == cycle) return 1;
+    debugger.seeking = SEEK_GOTO;
+    debugger.goto_cycle = cycle;
+    return 0;
+}
+
+// step-back: replay from the snapshot before the current instruction
+// boundary to learn the previous boundary, then goto it
+int debug_step_back(Processor* proc) {
+    int i = proc->cycle_counter ? find_snapshot(proc->cycle_counter - 1) : -1;
+    if (i < 0) {
+        printf("No snapshot before cycle %u\n", proc->cycle_counter);
+        return 1;
+    }
+    debugger.back_cycle = proc->cycle_counter;
+    debugger.back_have = 0;
+    debugger.back_snapshot = i;
+    debugger.seeking = SEEK_BACK;
+    restore_snapshot(i);
+    return 0;
+}
+
+// Called after each replayed instruction; returns 1 when the seek is over
+int debug_seek(Processor* proc) {
+    uint32_t cycle = proc->cycle_counter;
+
+    debugger.reason[0] = '\0';  // Watch hits while replaying do not stop
+    if (debugger.seeking == SEEK_GOTO) {
+        if (cycle < debugger.goto_cycle && !proc->halt) return 0;
+        debugger.seeking = 0;
+        snprintf(debugger.reason, sizeof(debugger.reason), proc->halt ? "halted" : "goto-cycle %u",
+            debugger.goto_cycle);
+        return 1;
+    }
+
+    if (cycle < debugger.back_cycle) {
+        debugger.back_found = cycle;
+        debugger.back_have = 1;
+        return 0;
+    }
+    if (debugger.back_have) {
+        restore_snapshot(debugger.back_snapshot);
+        debugger.seeking = 0;
+        return debug_goto(proc, debugger.back_found);
+    }
+    if (debugger.back_snapshot == 0) {  // No instruction since the first snapshot
+        restore_snapshot(0);
+        debugger.seeking = 0;
+        snprintf(debugger.reason, sizeof(debugger.reason), "step-back: first snapshot");
+        return 1;
+    }
+    restore_snapshot(--debugger.back_snapshot);
+    return 0;
+}
+
+/************************* Co-simulation *************************/
+// --cosim runs a second Processor through the reference interpreter: it
+// decodes imem on every fetch, steps wfi one cycle at a time, ticks every
+// device every cycle and uses the plain vector loops. The fast run loop
+// (pre-decoded fetch, idle skipping, event-driven devices, SIMD vectors)
+// is compared against it at the chosen granularity; the first mismatch
+// stops the run with a report of the fields that differ and the
+// instructions since the last agreement.
+
+void init_cosim(Processor* proc, const char* irq2_path) {
+    Processor* ref = (Processor*)malloc(sizeof(Processor));
+    if (!ref) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(ref, proc, sizeof(Processor));
+    alloc_memories(ref);
+    copy_sparse(ref->dmem, proc->dmem, (size_t)options.dmem_size * sizeof(uint32_t));
+    copy_sparse(ref->disk, proc->disk, (size_t)options.disk_size * sizeof(uint32_t));
+    copy_sparse(ref->monitor_buffer, proc->monitor_buffer, (size_t)options.monitor_size * options.monitor_size);
+    ref->io = ref;
+    ref->dcache = proc->dcache ? clone_cache(proc->dcache) : NULL;  // Same stalls
+    ref->pipeline = NULL;
+    ref->num_predictors = 0;
+
+    memset(&cosim, 0, sizeof(cosim));
+    cosim.ref = ref;
+    open_irq2_source(&cosim.irq2, irq2_path);
+    if (strcmp(options.cosim, "insn") == 0) {
+        cosim.granularity = COSIM_INSTRUCTION;
+    }
+    else if (strcmp(options.cosim, "block") == 0) {
+        cosim.granularity = COSIM_BLOCK;
+    }
+    else {
+        cosim.granularity = COSIM_CYCLES;
+        cosim.every = (uint32_t)strtoul(options.cosim, NULL, 0);
+        cosim.next_check = cosim.every;
+    }
+    cosim.next_full = COSIM_FULL_CYCLES;
+}
+
+void free_cosim(void) {
+    if (cosim.ref->dcache) free_cache(cosim.ref->dcache);
+    free_memories(cosim.ref);
+    free(cosim.ref);
+    close_irq2_source(&cosim.irq2);
+    cosim.ref = NULL;
+    cosim.granularity = 0;
+}
+
+// One cycle of the textbook loop: devices, stall, wfi, fetch-decode-execute
+void reference_step(Processor* ref) {
+    tick_devices(ref);
+    check_irq2(ref, &cosim.irq2);
+
+    if (ref->stall_cycles) {
+        ref->stall_cycles--;
+        ref->cycle_counter++;
+        return;
+    }
+    if (ref->waiting) {
+        if (!irq_pending(ref)) {
+            if (next_device_event(ref, &cosim.irq2)) ref->cycle_counter++;
+            else ref->halt = 1;  // Nothing can wake it
+            return;
+        }
+        ref->waiting = 0;
+    }
+
+    execute_instruction(ref, decode_instruction(ref->imem[ref->pc]));
+    ref->instructions++;
+    ref->cycle_counter++;
+}
+
+// Called after each fast-engine instruction
+void cosim_retired(Processor* proc, uint32_t pc, Instruction inst) {
+    uint32_t slot = cosim.window_count++ % COSIM_WINDOW;
+    cosim.window_pc[slot] = pc;
+    cosim.window_cycle[slot] = proc->cycle_counter - 1;
+    cosim.window_inst[slot] = inst;
+
+    int check;
+    switch (cosim.granularity) {
+    case COSIM_INSTRUCTION:
+        check = 1;
+        break;
+    case COSIM_BLOCK:  // Taken branch, jump, reti, halt or wfi
+        check = proc->pc != pc + 1 || proc->halt || proc->waiting;
+        break;
+    default:
+        check = proc->cycle_counter >= cosim.next_check;
+        if (check) cosim.next_check = proc->cycle_counter + cosim.every;
+        break;
+    }
+    if (check) {
+        cosim_check(proc, proc->halt || proc->cycle_counter >= cosim.next_full);
+    }
+}
+
+// Architectural state outside the register files and memories
+static const struct {
+    const char* name;
+    size_t offset;
+} cosim_fields[] = {
+    { "pc", offsetof(Processor, pc) },
+    { "vl", offsetof(Processor, vl) },
+    { "loop_depth", offsetof(Processor, loop_depth) },
+    { "cycle", offsetof(Processor, cycle_counter) },
+    { "stall_cycles", offsetof(Processor, stall_cycles) },
+    { "irq0enable", offsetof(Processor, irq0enable) },
+    { "irq1enable", offsetof(Processor, irq1enable) },
+    { "irq2enable", offsetof(Processor, irq2enable) },
+    { "irq0status", offsetof(Processor, irq0status) },
+    { "irq1status", offsetof(Processor, irq1status) },
+    { "irq2status", offsetof(Processor, irq2status) },
+    { "irqhandler", offsetof(Processor, irqhandler) },
+    { "irqreturn", offsetof(Processor, irqreturn) },
+    { "timerenable", offsetof(Processor, timerenable) },
+    { "timercurrent", offsetof(Processor, timercurrent) },
+    { "timermax", offsetof(Processor, timermax) },
+    { "diskcmd", offsetof(Processor, diskcmd) },
+    { "disksector", offsetof(Processor, disksector) },
+    { "diskbuffer", offsetof(Processor, diskbuffer) },
+    { "diskstatus", offsetof(Processor, diskstatus) },
+    { "diskcount", offsetof(Processor, diskcount) },
+    { "diskdesc", offsetof(Processor, diskdesc) },
+    { "diskirqmode", offsetof(Processor, diskirqmode) },
+    { "disk_busy_cycles", offsetof(Processor, disk_busy_cycles) },
+    { "disk_queue_count", offsetof(Processor, disk_queue_count) },
+    { "monitoraddr", offsetof(Processor, monitoraddr) },
+    { "monitordata", offsetof(Processor, monitordata) },
+    { "monitorcmd", offsetof(Processor, monitorcmd) },
+    { "monitor_busy_cycles", offsetof(Processor, monitor_busy_cycles) },
+    { "leds", offsetof(Processor, leds) },
+    { "display7seg", offsetof(Processor, display7seg) },
+};
+
+static int cosim_diffs;
+
+static void cosim_diff(const char* name, uint32_t fast, uint32_t ref) {
+    if (cosim_diffs++ == 0) {
+        fprintf(stderr, "Error: Co-simulation mismatch at cycle %u (last agreement at cycle %u)\n",
+            cosim.ref->cycle_counter, cosim.good_cycle);
+    }
+    if (cosim_diffs <= COSIM_MAX_DIFFS) {
+        fprintf(stderr, "  %-20s fast %08X  reference %08X\n", name, fast, ref);
+    }
+}
+
+static void cosim_diff_words(const char* memory, const uint32_t* fast, const uint32_t* ref, uint32_t words) {
+    char name[48];
+    for (uint32_t i = 0; i < words; i++) {
+        if (fast[i] == ref[i]) continue;
+        snprintf(name, sizeof(name), "%s[0x%X]", memory, i);
+        cosim_diff(name, fast[i], ref[i]);
+    }
+}
+
+// Bring the reference up to the fast engine's cycle and compare. Full
+// checks include the disk and the monitor.
+void cosim_check(Processor* proc, int full) {
+    Processor* ref = cosim.ref;
+    FILE* saved_memtrace = memtrace;
+    memtrace = NULL;
+    cosim.reference_active = 1;
+    while (!ref->halt && ref->cycle_counter < proc->cycle_counter) {
+        reference_step(ref);
+    }
+    cosim.reference_active = 0;
+    memtrace = saved_memtrace;
+    cosim.checks++;
+    bus_sync(proc, proc->cycle_counter);  // Lagging device counters, as the reference ticks them
+
+    char name[32];
+    cosim_diffs = 0;
+    for (size_t i = 0; i < sizeof(cosim_fields) / sizeof(cosim_fields[0]); i++) {
+        uint32_t a = *(const uint32_t*)((const char*)proc + cosim_fields[i].offset);
+        uint32_t b = *(const uint32_t*)((const char*)ref + cosim_fields[i].offset);
+        if (a != b) cosim_diff(cosim_fields[i].name, a, b);
+    }
+    if (proc->halt != ref->halt) cosim_diff("halt", proc->halt, ref->halt);
+    if (proc->waiting != ref->waiting) cosim_diff("waiting", proc->waiting, ref->waiting);
+    if (proc->in_interrupt != ref->in_interrupt) cosim_diff("in_interrupt", proc->in_interrupt, ref->in_interrupt);
+    if (proc->instructions != ref->instructions) {
+        cosim_diff("instructions", (uint32_t)proc->instructions, (uint32_t)ref->instructions);
+    }
+    for (uint32_t i = 0; i < proc->loop_depth && i < ref->loop_depth; i++) {
+        if (proc->loops[i].count == ref->loops[i].count) continue;
+        snprintf(name, sizeof(name), "loop%u count", i);
+        cosim_diff(name, proc->loops[i].count, ref->loops[i].count);
+    }
+    for (int r = 0; r < 16; r++) {
+        if (proc->registers[r] == ref->registers[r]) continue;
+        snprintf(name, sizeof(name), "R%d", r);
+        cosim_diff(name, proc->registers[r], ref->registers[r]);
+    }
+    if (memcmp(proc->vregs, ref->vregs, sizeof(proc->vregs)) != 0) {
+        for (int r = 0; r < VECTOR_REGS; r++) {
+            snprintf(name, sizeof(name), "vr%d", r);
+            cosim_diff_words(name, proc->vregs[r], ref->vregs[r], VECTOR_LANES);
+        }
+    }
+    if (memcmp(proc->dmem, ref->dmem, options.dmem_size * sizeof(uint32_t)) != 0) {
+        cosim_diff_words("dmem", proc->dmem, ref->dmem, options.dmem_size);
+    }
+    if (full) {
+        uint32_t size = options.monitor_size;
+        cosim.next_full = proc->cycle_counter + COSIM_FULL_CYCLES;
+        if (memcmp(proc->disk, ref->disk, options.disk_size * sizeof(uint32_t)) != 0) {
+            cosim_diff_words("disk", proc->disk, ref->disk, options.disk_size);
+        }
+        if (memcmp(proc->monitor_buffer, ref->monitor_buffer, size * size) != 0) {
+            for (uint32_t i = 0; i < size * size; i++) {
+                uint8_t a = proc->monitor_buffer[i];
+                uint8_t b = ref->monitor_buffer[i];
+                if (a == b) continue;
+                snprintf(name, sizeof(name), "monitor[%u,%u]", i % size, i / size);
+                cosim_diff(name, a, b);
+            }
+        }
+    }
+
+    if (!cosim_diffs) {
+        cosim.good_cycle = proc->cycle_counter;
+        cosim.window_count = 0;
+        return;
+    }
+
+    if (cosim_diffs > COSIM_MAX_DIFFS) {
+        fprintf(stderr, "  ... %d more differences\n", cosim_diffs - COSIM_MAX_DIFFS);
+    }
+    uint32_t count = cosim.window_count < COSIM_WINDOW ? cosim.window_count : COSIM_WINDOW;
+    fprintf(stderr, "Instructions since the last agreement%s:\n",
+        cosim.window_count > COSIM_WINDOW ? " (most recent only)" : "");
+    for (uint32_t n = cosim.window_count - count; n < cosim.window_count; n++) {
+        uint32_t slot = n % COSIM_WINDOW;
+        Instruction inst = cosim.window_inst[slot];
+        fprintf(stderr, "  cycle %u pc %03X %012llX  op %u rd %u rs %u rt %u rm %u imm1 %d imm2 %d\n",
+            cosim.window_cycle[slot], cosim.window_pc[slot],
+            (unsigned long long)(proc->imem[cosim.window_pc[slot]] & 0xFFFFFFFFFFFFull),
+            inst.opcode, inst.rd, inst.rs, inst.rt, inst.rm,
+            (int32_t)inst.immediate1, (int32_t)inst.immediate2);
+    }
+    exit(1);
+}
+
+/************************* Fuzzing *************************/
+// --fuzz runs many inputs against the loaded program in-process. An input
+// is a set of irq2 event cycles plus dmem words that override dmemin.
+// Before each exec only what the previous one dirtied is restored: the
+// register state, the dmem pages it wrote (tracked by arming every
+// debugger watch page for writes and disarming a page on its first
+// write), the disk sectors it wrote and the monitor rows it drew.
+// Inputs that reach new (previous pc, pc) edges join the corpus; hangs
+// over the cycle budget, wfi deadlocks, jumps outside imem, undefined
+// opcodes and out-of-range loads, stores and I/O registers are crashes.
+
+static const char* fuzz_kind_names[] = {
+    "ok", "hang", "deadlock", "bad-pc", "illegal-opcode", "bad-load", "bad-store", "bad-io"
+};
+
+uint32_t fuzz_random(void) {
+    uint64_t x = fuzz.rng;  // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    fuzz.rng = x;
+    return (uint32_t)(x >> 32);
+}
+
+void fuzz_mark_dmem(uint32_t addr, uint32_t words) {
+    if (addr >= options.dmem_size || words == 0) return;
+    uint64_t last = (uint64_t)addr + words - 1;
+    if (last >= options.dmem_size) last = options.dmem_size - 1;
+    for (uint32_t p = addr / DEBUG_PAGE_WORDS; p <= last / DEBUG_PAGE_WORDS; p++) {
+        if (!debugger.pages[p]) continue;
+        debugger.pages[p] = 0;
+        fuzz.dirty_dmem[fuzz.num_dirty_dmem++] = p;
+    }
+}
+
+void fuzz_mark_disk(uint32_t sector, uint32_t count) {
+    for (uint32_t s = 0; s < count && (uint64_t)sector + s < options.disk_size / DISK_SECTOR_WORDS; s++) {
+        if (fuzz.disk_dirty[sector + s]) continue;
+        fuzz.disk_dirty[sector + s] = 1;
+        fuzz.dirty_disk[fuzz.num_dirty_disk++] = sector + s;
+    }
+}
+
+// Put back what the last exec changed; cost follows the pages it touched
+void fuzz_reset(Processor* proc) {
+    Processor* base = fuzz.base;
+    for (int i = 0; i < fuzz.num_dirty_dmem; i++) {
+        uint32_t p = fuzz.dirty_dmem[i];
+        memcpy(&proc->dmem[p * DEBUG_PAGE_WORDS], &fuzz.base_dmem[p * DEBUG_PAGE_WORDS],
+            DEBUG_PAGE_WORDS * sizeof(uint32_t));
+        debugger.pages[p] = WATCH_WRITE;
+    }
+    for (int i = 0; i < fuzz.num_dirty_disk; i++) {
+        uint32_t s = fuzz.dirty_disk[i];
+        memcpy(&proc->disk[s * DISK_SECTOR_WORDS], &fuzz.base_disk[s * DISK_SECTOR_WORDS],
+            DISK_SECTOR_WORDS * sizeof(uint32_t));
+        fuzz.disk_dirty[s] = 0;
+    }
+    if (proc->monitor_dirty_top <= proc->monitor_dirty_bottom) {
+        uint32_t rows = proc->monitor_dirty_bottom - proc->monitor_dirty_top + 1;
+        size_t offset = (size_t)proc->monitor_dirty_top * options.monitor_size;
+        memcpy(proc->monitor_buffer + offset, fuzz.base_monitor + offset, (size_t)rows * options.monitor_size);
+        fuzz.pages_reset += rows * options.monitor_size / (DEBUG_PAGE_WORDS * 4) + 1;
+    }
+    fuzz.pages_reset += fuzz.num_dirty_dmem + fuzz.num_dirty_disk;
+    fuzz.num_dirty_dmem = 0;
+    fuzz.num_dirty_disk = 0;
+
+    memcpy(proc, base, offsetof(Processor, imem));  // Registers and devices
+}
+
+// Run one input from the post-load state; returns FUZZ_OK or a crash kind
+int fuzz_exec(Processor* proc, const FuzzInput* in) {
+    uint32_t* regs = proc->registers;
+    uint32_t events[FUZZ_MAX_IRQ2];
+    Irq2Source irq2;
+
+    memcpy(events, in->irq2, sizeof(uint32_t) * in->irq2_count);
+    qsort(events, in->irq2_count, sizeof(uint32_t), compare_u32);
+    list_irq2_source(&irq2, events, in->irq2_count);
+
+    fuzz_reset(proc);
+    for (int i = 0; i < in->num_patches; i++) {
+        fuzz_mark_dmem(in->patch_addr[i], 1);
+        proc->dmem[in->patch_addr[i]] = in->patch_value[i];
+    }
+    fuzz.prev_loc = 0;
+    fuzz.execs++;
+
+    while (!proc->halt) {
+        if (proc->cycle_counter >= fuzz.budget) return FUZZ_HANG;
+
+        update_devices(proc);
+        check_irq2(proc, &irq2);
+
+        if (proc->stall_cycles) {
+            proc->stall_cycles--;
+            proc->cycle_counter++;
+            continue;
+        }
+        if (proc->waiting) {
+            if (!irq_pending(proc)) {
+                uint32_t idle = next_device_event(proc, &irq2);
+                if (!idle) return FUZZ_DEADLOCK;
+                proc->cycle_counter++;
+                advance_idle_cycles(proc, idle - 1);
+                continue;
+            }
+            proc->waiting = 0;
+        }
+
+        fuzz.fault_pc = proc->pc;
+        if (proc->pc >= MEMORY_SIZE) return FUZZ_BAD_PC;
+        Instruction inst = proc->decoded[proc->pc];
+
+        uint32_t loc = (proc->pc * 0x9E3779B1u) >> 16;
+        uint32_t edge = (loc ^ fuzz.prev_loc) & (FUZZ_MAP_SIZE - 1);
+        if (!fuzz.coverage[edge]) {
+            fuzz.coverage[edge] = 1;
+            fuzz.edges++;
+        }
+        fuzz.prev_loc = loc >> 1;
+
+        regs[1] = inst.immediate1;
+        regs[2] = inst.immediate2;
+        uint32_t addr = regs[inst.rs] + regs[inst.rt];
+        switch (inst.opcode) {
+        case 16:
+            if (addr >= options.dmem_size) return FUZZ_BAD_LOAD;
+            break;
+        case 17: case 31: case 32:
+            if (addr >= options.dmem_size) return FUZZ_BAD_STORE;
+            break;
+        case 19: case 20:
+            if (addr >= IO_REGISTERS) return FUZZ_BAD_IO;
+            break;
+        default:
+            if (inst.opcode > 33) return FUZZ_ILLEGAL_OPCODE;
+            break;
+        }
+
+        execute_instruction(proc, inst);
+        proc->instructions++;
+        proc->cycle_counter++;
+    }
+    return FUZZ_OK;
+}
+
+void fuzz_mutate(FuzzInput* in) {
+    static const uint32_t interesting[] = { 0, 1, 0xFFFFFFFF, 0x7FFFFFFF, 0x80000000, 0xFF, 0x800, 0xFFF, 0x1000 };
+    uint32_t r = fuzz_random();
+    int n;
+
+    switch (r % 8) {
+    case 0:  // New irq2 event
+        if (in->irq2_count < FUZZ_MAX_IRQ2) in->irq2[in->irq2_count++] = fuzz_random() % fuzz.budget;
+        break;
+    case 1:  // Drop an irq2 event
+        if (in->irq2_count) {
+            n = fuzz_random() % in->irq2_count;
+            in->irq2[n] = in->irq2[--in->irq2_count];
+        }
+        break;
+    case 2:  // Nudge an irq2 event by up to +-64 cycles
+        if (in->irq2_count) {
+            n = fuzz_random() % in->irq2_count;
+            in->irq2[n] += (fuzz_random() % 129) - 64;
+        }
+        break;
+    case 3:  // New dmem patch with a random or boundary value
+    case 4:
+        if (in->num_patches < FUZZ_MAX_PATCHES) {
+            n = in->num_patches++;
+            in->patch_addr[n] = fuzz_random() % fuzz.patch_range;
+            in->patch_value[n] = r % 8 == 3 ? fuzz_random() :
+                interesting[fuzz_random() % (sizeof(interesting) / sizeof(interesting[0]))];
+        }
+        break;
+    case 5:  // Flip a bit of a patch
+        if (in->num_patches) {
+            n = fuzz_random() % in->num_patches;
+            in->patch_value[n] ^= 1u << (fuzz_random() % 32);
+        }
+        break;
+    case 6:  // Small arithmetic on a patch
+        if (in->num_patches) {
+            n = fuzz_random() % in->num_patches;
+            in->patch_value[n] += (fuzz_random() % 33) - 16;
+        }
+        break;
+    default:  // Drop a patch
+        if (in->num_patches) {
+            n = fuzz_random() % in->num_patches;
+            in->num_patches--;
+            in->patch_addr[n] = in->patch_addr[in->num_patches];
+            in->patch_value[n] = in->patch_value[in->num_patches];
+        }
+        break;
+    }
+}
+
+int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Write dmemin and irq2in files that reproduce a crash in a normal run
+void fuzz_save_crash(const FuzzInput* in, int index) {
+    char name[MAX_LINE_LENGTH];
+    snprintf(name, sizeof(name), "%s%d_dmemin.txt", options.fuzz_crashes, index);
+    FILE* dmem = fopen(name, "w");
+    snprintf(name, sizeof(name), "%s%d_irq2in.txt", options.fuzz_crashes, index);
+    FILE* irq2 = fopen(name, "w");
+    if (!dmem || !irq2) {
+        fprintf(stderr, "Error: Cannot write crash files %s%d_*\n", options.fuzz_crashes, index);
+        exit(1);
+    }
+
+    // Patches stay below patch_range, so the rest comes straight from the base
+    uint32_t* words = (uint32_t*)malloc(sizeof(uint32_t) * fuzz.patch_range);
+    if (!words) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(words, fuzz.base_dmem, sizeof(uint32_t) * fuzz.patch_range);
+    for (int i = 0; i < in->num_patches; i++) words[in->patch_addr[i]] = in->patch_value[i];
+    uint32_t n = output_words(fuzz.base_dmem, options.dmem_size, MEMORY_SIZE);
+    if (n < fuzz.patch_range) n = fuzz.patch_range;
+    for (uint32_t i = 0; i < n; i++) fprintf(dmem, "%08X\n", i < fuzz.patch_range ? words[i] : fuzz.base_dmem[i]);
+    free(words);
+
+    uint32_t events[FUZZ_MAX_IRQ2];
+    memcpy(events, in->irq2, sizeof(uint32_t) * in->irq2_count);
+    qsort(events, in->irq2_count, sizeof(uint32_t), compare_u32);
+    for (int i = 0; i < in->irq2_count; i++) fprintf(irq2, "%u\n", events[i]);
+
+    fclose(dmem);
+    fclose(irq2);
+}
+
+void fuzz_record_crash(Processor* proc, const FuzzInput* in, int kind) {
+    fuzz.total_crashes++;
+    for (int i = 0; i < fuzz.num_crashes; i++) {  // Hangs are one crash wherever the budget ran out
+        if (fuzz.crashes[i].kind == kind && (kind == FUZZ_HANG || fuzz.crashes[i].pc == fuzz.fault_pc)) {
+            fuzz.crashes[i].count++;
+            return;
+        }
+    }
+    if (fuzz.num_crashes == FUZZ_MAX_CRASHES) return;
+
+    FuzzCrash* c = &fuzz.crashes[fuzz.num_crashes];
+    c->kind = kind;
+    c->pc = fuzz.fault_pc;
+    c->cycle = proc->cycle_counter;
+    c->count = 1;
+    if (options.fuzz_crashes) fuzz_save_crash(in, fuzz.num_crashes);
+    fuzz.num_crashes++;
+}
+
+// Replaces the normal run. The seed input (irq2in, dmemin unchanged) runs
+// last, so the final-state output files describe it.
+void fuzz_campaign(Processor* proc, Irq2Source* irq2) {
+    fuzz.rng = seed_random(options.fuzz_seed);
+    fuzz.budget = options.fuzz_budget;
+    fuzz.base = (Processor*)malloc(sizeof(Processor));
+    fuzz.corpus = (FuzzInput*)malloc(sizeof(FuzzInput) * FUZZ_CORPUS_MAX);
+    fuzz.dirty_dmem = (uint32_t*)malloc(sizeof(uint32_t) * (options.dmem_size / DEBUG_PAGE_WORDS));
+    fuzz.disk_dirty = (uint8_t*)calloc(options.disk_size / DISK_SECTOR_WORDS, 1);
+    fuzz.dirty_disk = (uint32_t*)malloc(sizeof(uint32_t) * (options.disk_size / DISK_SECTOR_WORDS));
+    if (!fuzz.base || !fuzz.corpus || !fuzz.dirty_dmem || !fuzz.disk_dirty || !fuzz.dirty_disk) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(fuzz.base, proc, sizeof(Processor));
+    fuzz.base_dmem = (uint32_t*)alloc_memory((size_t)options.dmem_size * sizeof(uint32_t));
+    fuzz.base_disk = (uint32_t*)alloc_memory((size_t)options.disk_size * sizeof(uint32_t));
+    fuzz.base_monitor = (uint8_t*)alloc_memory((size_t)options.monitor_size * options.monitor_size);
+    copy_sparse(fuzz.base_dmem, proc->dmem, (size_t)options.dmem_size * sizeof(uint32_t));
+    copy_sparse(fuzz.base_disk, proc->disk, (size_t)options.disk_size * sizeof(uint32_t));
+    copy_sparse(fuzz.base_monitor, proc->monitor_buffer, (size_t)options.monitor_size * options.monitor_size);
+
+    // Patch where dmemin has data, and a little past it
+    fuzz.patch_range = output_words(proc->dmem, options.dmem_size, 0);
+    fuzz.patch_range = fuzz.patch_range + 64 < options.dmem_size ? fuzz.patch_range + 64 : options.dmem_size;
+
+    memset(debugger.pages, WATCH_WRITE, options.dmem_size / DEBUG_PAGE_WORDS);
+    fuzz.active = 1;
+
+    FuzzInput seed;
+    memset(&seed, 0, sizeof(seed));
+    for (; !irq2->pos.done && seed.irq2_count < FUZZ_MAX_IRQ2; irq2_advance(irq2)) {
+        seed.irq2[seed.irq2_count++] = irq2->pos.next;
+    }
+
+    uint64_t start = host_time_ns();
+    int kind = fuzz_exec(proc, &seed);
+    if (kind != FUZZ_OK) fuzz_record_crash(proc, &seed, kind);
+    fuzz.corpus[fuzz.corpus_count++] = seed;
+
+    FuzzInput child;
+    for (uint64_t n = 0; n < options.fuzz_execs; n++) {
+        child = fuzz.corpus[fuzz_random() % fuzz.corpus_count];
+        int mutations = 1 + fuzz_random() % 4;
+        for (int m = 0; m < mutations; m++) fuzz_mutate(&child);
+
+        uint32_t edges = fuzz.edges;
+        kind = fuzz_exec(proc, &child);
+        if (kind != FUZZ_OK) fuzz_record_crash(proc, &child, kind);
+        else if (fuzz.edges > edges && fuzz.corpus_count < FUZZ_CORPUS_MAX) {
+            fuzz.corpus[fuzz.corpus_count++] = child;
+        }
+    }
+    double seconds = (host_time_ns() - start) / 1e9;
+
+    printf("Fuzzing: %llu execs in %.2f s (%.0f execs/s), %.1f pages reset per exec\n",
+        (unsigned long long)fuzz.execs, seconds, seconds > 0 ? fuzz.execs / seconds : 0.0,
+        (double)fuzz.pages_reset / (double)fuzz.execs);
+    printf("  corpus %d inputs, %u edges, %llu crashes (%d distinct)\n", fuzz.corpus_count, fuzz.edges,
+        (unsigned long long)fuzz.total_crashes, fuzz.num_crashes);
+    for (int i = 0; i < fuzz.num_crashes; i++) {
+        FuzzCrash* c = &fuzz.crashes[i];
+        printf("  #%d %-15s pc %03X first at cycle %u, %llu hits\n", i, fuzz_kind_names[c->kind], c->pc,
+            c->cycle, (unsigned long long)c->count);
+    }
+
+    fuzz_exec(proc, &seed);  // Leave the seed's final state for the output files
+    fuzz.active = 0;
+    memset(debugger.pages, 0, options.dmem_size / DEBUG_PAGE_WORDS);
+    free(fuzz.corpus);
+    free(fuzz.base);
+    free_memory(fuzz.base_dmem, (size_t)options.dmem_size * sizeof(uint32_t));
+    free_memory(fuzz.base_disk, (size_t)options.disk_size * sizeof(uint32_t));
+    free_memory(fuzz.base_monitor, (size_t)options.monitor_size * options.monitor_size);
+    free(fuzz.dirty_dmem);
+    free(fuzz.disk_dirty);
+    free(fuzz.dirty_disk);
+}
+
+/************************* Live Metrics *************************/
+// --metrics NAME publishes a SimMetrics struct in a shared-memory segment
+// (POSIX shm_open, a named file mapping on Windows) every --metrics-every
+// cycles for simp-top to read. Updates use a seqlock: seq turns odd, the
+// fields are stored, seq turns even again, and a reader retries if seq
+// was odd or changed while it copied. Core 0 publishes its own counters;
+// between updates the run loop pays one compare per cycle.
+
+// POSIX wants "/name"; Windows mapping names have no slash
+void metrics_segment_name(char* out, size_t size, const char* name) {
+#if defined(SIMP_HAVE_SHM)
+    snprintf(out, size, "%s%s", name[0] == '/' ? "" : "/", name);
+#else
+    snprintf(out, size, "%s", name[0] == '/' ? name + 1 : name);
+#endif
+}
+
+void init_metrics(void) {
+    SimMetrics* m = NULL;
+    metrics_segment_name(metrics.name, sizeof(metrics.name), options.metrics);
+#if defined(SIMP_HAVE_SHM)
+    int fd = shm_open(metrics.name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd >= 0 && ftruncate(fd, sizeof(SimMetrics)) == 0) {
+        void* p = mmap(NULL, sizeof(SimMetrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) m = (SimMetrics*)p;
+    }
+    if (fd >= 0) close(fd);
+#elif defined(SIMP_HAVE_VIRTUALALLOC)
+    metrics.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(SimMetrics),
+        metrics.name);
+    if (metrics.mapping) m = (SimMetrics*)MapViewOfFile(metrics.mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SimMetrics));
+#endif
+    if (!m) {
+        fprintf(stderr, "Error: Cannot create metrics segment %s\n", metrics.name);
+        exit(1);
     }
+
+    memset(m, 0, sizeof(SimMetrics));
+    memcpy(m->magic, METRICS_MAGIC, sizeof(m->magic));
+    m->version = METRICS_VERSION;
+    m->size = sizeof(SimMetrics);
+#if defined(SIMP_HAVE_SHM)
+    m->pid = (uint32_t)getpid();
+#elif defined(SIMP_HAVE_VIRTUALALLOC)
+    m->pid = (uint32_t)GetCurrentProcessId();
+#endif
+    m->every = options.metrics_every;
+    metrics.shared = m;
+    metrics.every = options.metrics_every;
+    metrics.next = 0;
+    metrics.last_ns = host_time_ns();
 }
 
-void write_dmemout(FILE* f, Processor* proc) {
-    for (int i = 0; i < MEMORY_SIZE; i++) {
-        fprintf(f, "%08X\n", proc->dmem[i]);
+void publish_metrics(CoreContext* c, int halted) {
+    Processor* proc = c->proc;
+    SimMetrics* m = metrics.shared;
+    uint64_t now = host_time_ns();
+    bus_sync(proc, proc->cycle_counter);
+    uint64_t cycles = proc->cycle_counter;
+    uint64_t disk_busy = proc->disk_busy_total + (proc->diskstatus ? proc->disk_busy_cycles : 0);
+    uint32_t permille = 0;
+    double mips = 0;
+
+    // The debugger can move time backwards; rates then restart
+    if (cycles > metrics.last_cycles && disk_busy >= metrics.last_disk_busy) {
+        uint64_t busy = (disk_busy - metrics.last_disk_busy) * 1000 / (cycles - metrics.last_cycles);
+        permille = busy > 1000 ? 1000 : (uint32_t)busy;
+    }
+    if (now > metrics.last_ns && proc->instructions >= metrics.last_instructions) {
+        mips = (double)(proc->instructions - metrics.last_instructions) * 1e3 / (double)(now - metrics.last_ns);
     }
+
+    uint32_t seq = m->seq;
+    STORE_RELEASE(&m->seq, seq + 1);
+    FENCE_RELEASE();
+    m->halted = (uint32_t)halted;
+    m->pc = proc->pc;
+    m->cycles = cycles;
+    m->instructions = proc->instructions;
+    m->host_ns = now - host_start_ns;
+    memcpy(m->irq_entries, proc->irq_entries, sizeof(m->irq_entries));
+    m->trace_bytes = c->trace_bytes;
+    m->updates++;
+    m->leds = proc->leds;
+    m->display7seg = proc->display7seg;
+    m->disk_busy_permille = permille;
+    m->mips = mips;
+    STORE_RELEASE(&m->seq, seq + 2);
+
+    metrics.last_ns = now;
+    metrics.last_instructions = proc->instructions;
+    metrics.last_cycles = cycles;
+    metrics.last_disk_busy = disk_busy;
+    metrics.next = proc->cycle_counter + metrics.every;
+}
+
+// The segment goes away with the simulator; a mapped reader keeps the last update
+void free_metrics(void) {
+#if defined(SIMP_HAVE_SHM)
+    munmap(metrics.shared, sizeof(SimMetrics));
+    shm_unlink(metrics.name);
+#elif defined(SIMP_HAVE_VIRTUALALLOC)
+    UnmapViewOfFile(metrics.shared);
+    CloseHandle(metrics.mapping);
+#endif
+    metrics.shared = NULL;
+    metrics.every = 0;
 }
 
-void write_diskout(FILE* f, Processor* proc) {
-    for (int i = 0; i < DISK_SIZE; i++) {
-        fprintf(f, "%08X\n", proc->disk[i]);
+/************************* Sampled Simulation *************************/
+// --sample PERIOD runs the timing models (--pipeline, --dcache-size,
+// --bpred) only in short windows. Each interval of PERIOD instructions is
+// fast-forwarded by the plain run loop; then the models are attached for
+// --sample-warmup instructions, which refill the cache and predictor
+// tables, and for --sample-window instructions whose cycles they count.
+// The functional run keeps one cycle per instruction: stalls are
+// measured, not simulated, so the outputs do not depend on the schedule.
+// A fixed schedule puts the window at the end of each interval and a
+// random one at a random offset; a program whose loops repeat every
+// PERIOD instructions aliases with the fixed one. The phase schedule probes the PC every
+// SAMPLE_PROBE_INSTRUCTIONS, groups intervals by the PC histogram and
+// stops measuring a phase once it has SAMPLE_PHASE_WINDOWS windows. The
+// estimate weights each phase's mean CPI by its instructions.
+uint64_t sample_random(void) {
+    uint64_t x = sampling.rng;  // xorshift64
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    sampling.rng = x;
+    return x;
+}
+
+void init_sampling(Processor* proc) {
+    sampling.period = options.sample_period;
+    sampling.rng = seed_random(options.sample_seed);
+    sampling.dcache = proc->dcache;
+    sampling.pipeline = proc->pipeline;
+    sampling.num_predictors = proc->num_predictors;
+    sampling.num_phases = options.sample_schedule == SAMPLE_PHASE ? 0 : 1;
+    detach_models(proc);
+    start_interval(proc);
+}
+
+void attach_models(Processor* proc) {
+    proc->dcache = sampling.dcache;
+    proc->pipeline = sampling.pipeline;
+    proc->num_predictors = sampling.num_predictors;
+    if (proc->pipeline) {  // The stream restarts here; not an interrupt entry
+        proc->pipeline->expected_pc = proc->pc;
+        proc->pipeline->prev_dest = 0;
     }
 }
 
-void write_monitor(FILE* f_txt, FILE* f_yuv, Processor* proc) {
-    // Write text format (monitor.txt)
-    for (int y = 0; y < MONITOR_SIZE; y++) {
-        for (int x = 0; x < MONITOR_SIZE; x++) {
-            fprintf(f_txt, "%02X\n", proc->monitor_buffer[y][x]);
+void detach_models(Processor* proc) {
+    proc->dcache = NULL;
+    proc->pipeline = NULL;
+    proc->num_predictors = 0;
+}
+
+// One cycle per instruction plus the stalls the attached models charged so far
+uint64_t modeled_cycles(Processor* proc) {
+    if (proc->pipeline) {
+        Pipeline* p = proc->pipeline;
+        return p->instructions + p->load_use_stalls + p->branch_stalls + p->jump_stalls +
+            p->interrupt_stalls + p->memory_stalls;
+    }
+    uint64_t cycles = proc->instructions;
+    if (proc->dcache) cycles += proc->dcache->stall_cycles;
+    if (proc->num_predictors) cycles += proc->predictors[0]->mispredicts * options.pipeline_branch_penalty;
+    return cycles;
+}
+
+void start_interval(Processor* proc) {
+    uint64_t slack = options.sample_period - options.sample_warmup - options.sample_window;
+    sampling.interval_start = proc->instructions;
+    sampling.warm_at = proc->instructions +
+        (options.sample_schedule == SAMPLE_RANDOM ? sample_random() % (slack + 1) : slack);
+    sampling.state = SAMPLE_FAST;
+    sampling.phase = options.sample_schedule == SAMPLE_PHASE ? -1 : 0;
+    memset(sampling.probes, 0, sizeof(sampling.probes));
+    sampling.num_probes = 0;
+    sampling.next_probe = proc->instructions;
+}
+
+// Also at halt, for the part of an interval that ran
+void close_interval(Processor* proc) {
+    if (sampling.phase < 0) sampling.phase = classify_interval();
+    SamplePhase* p = &sampling.phases[sampling.phase];
+    p->intervals++;
+    p->instructions += proc->instructions - sampling.interval_start;
+}
+
+// The nearest phase by PC histogram, or a new one
+int classify_interval(void) {
+    double signature[SAMPLE_BUCKETS];
+    int best = -1;
+    double best_distance = 0;
+
+    for (int b = 0; b < SAMPLE_BUCKETS; b++) {
+        signature[b] = sampling.num_probes ? (double)sampling.probes[b] / sampling.num_probes : 0;
+    }
+    for (int i = 0; i < sampling.num_phases; i++) {
+        double distance = 0;
+        for (int b = 0; b < SAMPLE_BUCKETS; b++) distance += fabs(signature[b] - sampling.phases[i].signature[b]);
+        if (best < 0 || distance < best_distance) {
+            best = i;
+            best_distance = distance;
         }
     }
+    if (best >= 0 && (best_distance <= SAMPLE_PHASE_DISTANCE || sampling.num_phases == SAMPLE_MAX_PHASES)) {
+        return best;
+    }
+    memcpy(sampling.phases[sampling.num_phases].signature, signature, sizeof(signature));
+    return sampling.num_phases++;
+}
 
-    // Write binary YUV format (monitor.yuv)
-    for (int y = 0; y < MONITOR_SIZE; y++) {
-        for (int x = 0; x < MONITOR_SIZE; x++) {
-            fputc(proc->monitor_buffer[y][x], f_yuv);
+// Sample variance of a phase's window CPIs, two windows or more. Windows
+// that agree leave only rounding in the sums: that is no spread at all
+double phase_variance(SamplePhase* p) {
+    double mean = p->cpi_sum / p->windows;
+    double s2 = (p->cpi_squares - p->windows * mean * mean) / (p->windows - 1);
+    return s2 > 1e-14 * mean * mean ? s2 : 0;
+}
 
+// Called by the run loop once proc->instructions reaches sampling.next
+void sample_event(Processor* proc) {
+    uint64_t n = proc->instructions;
+
+    if (sampling.state == SAMPLE_FAST && options.sample_schedule == SAMPLE_PHASE && n >= sampling.next_probe) {
+        sampling.probes[(proc->pc * 0x9E3779B1u) >> 27]++;  // Top 5 bits: SAMPLE_BUCKETS
+        sampling.num_probes++;
+        sampling.next_probe = n + SAMPLE_PROBE_INSTRUCTIONS;
+    }
+
+    for (;;) {
+        uint64_t measure_at = sampling.warm_at + options.sample_warmup;
+        if (sampling.state == SAMPLE_FAST && n >= sampling.warm_at) {
+            if (options.sample_schedule == SAMPLE_PHASE) sampling.phase = classify_interval();
+            if (options.sample_schedule != SAMPLE_PHASE ||
+                sampling.phases[sampling.phase].windows < SAMPLE_PHASE_WINDOWS) {
+                attach_models(proc);
+                sampling.state = SAMPLE_WARM;
+            }
+            else sampling.state = SAMPLE_SKIP;
         }
+        else if (sampling.state == SAMPLE_WARM && n >= measure_at) {
+            sampling.window_instructions = n;
+            sampling.window_cycles = modeled_cycles(proc);
+            sampling.state = SAMPLE_MEASURE;
+        }
+        else if (sampling.state == SAMPLE_MEASURE && n >= measure_at + options.sample_window) {
+            SamplePhase* p = &sampling.phases[sampling.phase];
+            double cpi = (double)(modeled_cycles(proc) - sampling.window_cycles) /
+                (double)(n - sampling.window_instructions);
+            p->windows++;
+            p->cpi_sum += cpi;
+            p->cpi_squares += cpi * cpi;
+            sampling.detailed += n - sampling.warm_at;
+            detach_models(proc);
+            sampling.state = SAMPLE_SKIP;
+        }
+        else if (sampling.state == SAMPLE_SKIP && n >= sampling.interval_start + sampling.period) {
+            close_interval(proc);
+            start_interval(proc);
+        }
+        else break;
     }
-    for (int i = 0; i < 256 * 256 * 2; i++) {
-        fputc(128, f_yuv);
+
+    switch (sampling.state) {
+    case SAMPLE_FAST:
+        sampling.next = sampling.warm_at;
+        if (options.sample_schedule == SAMPLE_PHASE && sampling.next_probe < sampling.next) {
+            sampling.next = sampling.next_probe;
+        }
+        break;
+    case SAMPLE_WARM:
+        sampling.next = sampling.warm_at + options.sample_warmup;
+        break;
+    case SAMPLE_MEASURE:
+        sampling.next = sampling.warm_at + options.sample_warmup + options.sample_window;
+        break;
+    default:
+        sampling.next = sampling.interval_start + sampling.period;
+        break;
     }
 }
 
-/************************* Main Simulation Loop *************************/
-void simulate(Processor* proc, char* argv[]) {
-    // Open all input files
-    FILE* imemin = fopen(argv[1], "r");
-    FILE* dmemin = fopen(argv[2], "r");
-    FILE* diskin = fopen(argv[3], "r");
-    FILE* irq2in = fopen(argv[4], "r");
-
-    // Open all output files
-    FILE* dmemout = fopen(argv[5], "w");
-    FILE* regout = fopen(argv[6], "w");
-    FILE* trace = fopen(argv[7], "w");
-    FILE* hwregtrace = fopen(argv[8], "w");
-    FILE* cycles = fopen(argv[9], "w");
-    FILE* leds = fopen(argv[10], "w");
-    FILE* display7seg = fopen(argv[11], "w");
-    FILE* diskout = fopen(argv[12], "w");
-    FILE* monitor_txt = fopen(argv[13], "w");
-    FILE* monitor_yuv = fopen(argv[14], "wb");  // Binary mode
-
-    if (!imemin || !dmemin || !diskin || !irq2in ||
-        !dmemout || !regout || !trace || !hwregtrace ||
-        !cycles || !leds || !display7seg || !diskout ||
-        !monitor_txt || !monitor_yuv) {
-        fprintf(stderr, "Error: Cannot open one or more files\n");
-        exit(1);
+// At halt: the estimate, then the models go back to the core for their own reports
+void finish_sampling(FILE* f, Processor* proc) {
+    static const char* schedules[] = { "fixed", "random", "phase" };
+    uint64_t total = proc->instructions;
+    uint32_t windows = 0, most = 0;
+    double cpi_sum = 0, pooled = 0;
+    uint64_t freedom = 0;
+
+    if (sampling.state == SAMPLE_WARM || sampling.state == SAMPLE_MEASURE) {
+        sampling.detailed += proc->instructions - sampling.warm_at;  // Unfinished window, not counted
     }
+    close_interval(proc);
+    attach_models(proc);
 
-    // Load initial states
-    load_memory64(argv[1], proc->imem, MEMORY_SIZE, 12);  // Instructions
-    load_memory32(argv[2], proc->dmem, MEMORY_SIZE, 8);   // Data
-    load_memory32(argv[3], proc->disk, DISK_SIZE, 8);     // Disk
+    for (int i = 0; i < sampling.num_phases; i++) {
+        SamplePhase* p = &sampling.phases[i];
+        windows += p->windows;
+        cpi_sum += p->cpi_sum;
+        if (p->windows > most) most = p->windows;
+        if (p->windows >= 2 && phase_variance(p) > 0) {
+            pooled += phase_variance(p) * (p->windows - 1);
+            freedom += p->windows - 1;
+        }
+    }
+    fprintf(f, "Sampled simulation: %s schedule, period %llu, warmup %llu, window %llu instructions\n",
+        schedules[options.sample_schedule], (unsigned long long)options.sample_period,
+        (unsigned long long)options.sample_warmup, (unsigned long long)options.sample_window);
+    fprintf(f, "  %u windows, timing models ran %llu of %llu instructions (%.2f%%)\n", windows,
+        (unsigned long long)sampling.detailed, (unsigned long long)total,
+        total ? 100.0 * sampling.detailed / total : 0.0);
+    if (windows == 0) {
+        fprintf(f, "  no window completed: the run is shorter than one period\n");
+        return;
+    }
+
+    // Stratified by phase. A phase with one window, or whose windows agree,
+    // borrows the pooled spread of the phases that vary. When none varies
+    // the windows say nothing about the error: there is no interval
+    double cpi = 0, variance = 0;
+    double spread = freedom ? pooled / freedom : 0;
+    for (int i = 0; i < sampling.num_phases; i++) {
+        SamplePhase* p = &sampling.phases[i];
+        if (p->instructions == 0) continue;
+        double weight = (double)p->instructions / total;
+        double mean = p->windows ? p->cpi_sum / p->windows : cpi_sum / windows;
+        double s2 = p->windows >= 2 && phase_variance(p) > 0 ? phase_variance(p) : spread;
+        cpi += weight * mean;
+        variance += weight * weight * s2 / (p->windows ? p->windows : 1);
+    }
+
+    // wfi sleep is outside the CPI: the functional run counts it as is
+    uint64_t idle = proc->cycle_counter > total ? proc->cycle_counter - total : 0;
+    double half = 1.96 * sqrt(variance);
+    if (freedom) {
+        fprintf(f, "  CPI %.3f +- %.3f (95%% confidence)\n", cpi, half);
+        fprintf(f, "  estimated cycles %.0f +- %.0f (functional run: %u)\n", cpi * total + idle,
+            half * total, proc->cycle_counter);
+    }
+    else {
+        fprintf(f, "  CPI %.3f (%s: no confidence interval)\n", cpi,
+            most >= 2 ? "no spread between windows of a phase" : "one window per phase");
+        fprintf(f, "  estimated cycles %.0f (functional run: %u)\n", cpi * total + idle, proc->cycle_counter);
+    }
+    if (options.sample_schedule == SAMPLE_PHASE) {
+        for (int i = 0; i < sampling.num_phases; i++) {
+            SamplePhase* p = &sampling.phases[i];
+            fprintf(f, "  phase %d: %llu intervals, %.1f%% of instructions, %u windows", i,
+                (unsigned long long)p->intervals, total ? 100.0 * p->instructions / total : 0.0, p->windows);
+            if (p->windows) fprintf(f, ", CPI %.3f", p->cpi_sum / p->windows);
+            fprintf(f, "\n");
+        }
+    }
+    fprintf(f, "  The timing model reports below cover warmup and window instructions only\n");
+}
 
-    // Load IRQ2 timing
-    uint32_t irq2_timing[MEMORY_SIZE];
-    int irq2_count = 0;
-    load_irq2_timing(argv[4], irq2_timing, &irq2_count);
+/************************* Multi-core *************************/
+// With --cores N every core runs the same program on its own host thread.
+// Cores run options.quantum cycles, then meet at a barrier, so their clocks
+// never drift apart by more than one quantum. Within a quantum the
+// interleaving of dmem accesses depends on the host; --lockstep runs all
+// cores on one thread, one cycle each in core order, for repeatable runs.
+#ifdef SIMP_HAVE_THREADS
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int count;
+    int arrived;
+    unsigned generation;
+} Barrier;
 
-    // Previous state for tracking changes
-    uint32_t prev_leds = 0;
-    uint32_t prev_display = 0;
+pthread_mutex_t device_lock = PTHREAD_MUTEX_INITIALIZER;
+int device_locking;              // Set while cores run on several host threads
+Barrier quantum_barrier = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0 };
+Processor* thread_cores[MAX_CORES];
+int all_halted;
+
+// Returns 1 on the last thread to arrive
+int barrier_wait(Barrier* b) {
+    pthread_mutex_lock(&b->lock);
+    unsigned generation = b->generation;
+    int last = ++b->arrived == b->count;
+    if (last) {
+        b->arrived = 0;
+        b->generation++;
+        pthread_cond_broadcast(&b->cond);
+    }
+    else {
+        while (generation == b->generation) {
+            pthread_cond_wait(&b->cond, &b->lock);
+        }
+    }
+    pthread_mutex_unlock(&b->lock);
+    return last;
+}
+
+void* core_thread(void* arg) {
+    CoreContext* c = (CoreContext*)arg;
+    uint32_t until = 0;
+    for (;;) {
+        until += options.quantum;
+        run_core(c, until);
+
+        // The last core in checks for the end, everyone reads it after the second barrier
+        if (barrier_wait(&quantum_barrier)) {
+            all_halted = 1;
+            for (int i = 0; i < quantum_barrier.count; i++) {
+                if (!thread_cores[i]->halt) all_halted = 0;
+            }
+        }
+        barrier_wait(&quantum_barrier);
+        if (all_halted) break;
+    }
+    return NULL;
+}
+#endif
+
+void lock_devices(void) {
+#ifdef SIMP_HAVE_THREADS
+    if (device_locking) pthread_mutex_lock(&device_lock);
+#endif
+}
+
+void unlock_devices(void) {
+#ifdef SIMP_HAVE_THREADS
+    if (device_locking) pthread_mutex_unlock(&device_lock);
+#endif
+}
+
+void run_cores(CoreContext* ctx, int count) {
+    if (count == 1) {
+        run_core(&ctx[0], UINT32_MAX);
+        return;
+    }
+
+#ifdef SIMP_HAVE_THREADS
+    if (!options.lockstep) {
+        pthread_t threads[MAX_CORES];
+        quantum_barrier.count = count;
+        for (int i = 0; i < count; i++) thread_cores[i] = ctx[i].proc;
+        device_locking = 1;
+        for (int i = 1; i < count; i++) {
+            if (pthread_create(&threads[i], NULL, core_thread, &ctx[i]) != 0) {
+                fprintf(stderr, "Error: Cannot start a thread for core %d\n", i);
+                exit(1);
+            }
+        }
+        core_thread(&ctx[0]);
+        for (int i = 1; i < count; i++) pthread_join(threads[i], NULL);
+        device_locking = 0;
+        return;
+    }
+#endif
+
+    // Lockstep, or quanta in turn without host threads
+    uint32_t step = options.lockstep ? 1 : options.quantum;
+    uint32_t until = 0;
+    for (;;) {
+        int running = 0;
+        until += step;
+        for (int i = 0; i < count; i++) {
+            run_core(&ctx[i], until);
+            running |= !ctx[i].proc->halt;
+        }
+        if (!running) break;
+    }
+}
+
+void write_core_report(FILE* f, Processor** cores, const uint32_t* halt_cycles, int count) {
+    uint64_t total = 0;
+    uint32_t cycles = 0;
+    for (int i = 0; i < count; i++) {
+        fprintf(f, "Core %d: %llu instructions, stopped at cycle %u\n", i,
+            (unsigned long long)cores[i]->instructions, halt_cycles[i]);
+        total += cores[i]->instructions;
+        if (halt_cycles[i] > cycles) cycles = halt_cycles[i];
+    }
+
+    // One core retires at most one instruction per cycle, so aggregate IPC is
+    // the speedup over running the same instructions on a single core
+    fprintf(f, "Cores: %d (%s), %llu instructions in %u cycles, aggregate IPC %.2f\n", count,
+        options.lockstep ? "lockstep" : "threaded", (unsigned long long)total, cycles,
+        cycles ? (double)total / cycles : 0.0);
+}
+
+// trace.txt -> trace_core1.txt
+void core_file_name(char* out, size_t size, const char* path, uint32_t core) {
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    if (!dot || (slash && slash > dot)) dot = path + strlen(path);
+    snprintf(out, size, "%.*s_core%u%s", (int)(dot - path), path, core, dot);
+}
+
+/************************* Main Simulation Loop *************************/
+// Run one core until it halts or reaches cycle until. Only core 0 updates
+// the devices and writes leds, display7seg and the monitor stream; once
+// it halts, the cores still running update the devices.
+void run_core(CoreContext* c, uint32_t until) {
+    Processor* proc = c->proc;
+    int owns_devices = proc->io == proc;
+
+    while (!proc->halt && proc->cycle_counter < until) {
+        if (snapshots.every && proc->cycle_counter >= snapshots.next) {
+            take_snapshot(c);
+        }
+        if (metrics.every && owns_devices && proc->cycle_counter >= metrics.next) {
+            publish_metrics(c, 0);
+        }
+        if (sampling.period && proc->instructions >= sampling.next) {
+            sample_event(proc);
+        }
 
-    // Main simulation loop
-    while (!proc->halt) {
         // Update devices
-        update_devices(proc);
-        check_irq2(proc, irq2_timing, irq2_count);
+        if (owns_devices) {
+            lock_devices();
+            update_devices(proc);
+            check_irq2(proc, c->irq2);
+            unlock_devices();
+        }
+        else {
+            lock_devices();
+            if (proc->io->halt) {
+                bus_sync(proc->io, proc->cycle_counter + 1);
+                check_irq2(proc, c->irq2);
+            }
+            latch_device_irqs(proc);
+            unlock_devices();
+            check_interrupts(proc);
+        }
 
-        // Fetch instruction
-        uint64_t inst = proc->imem[proc->pc];
+        // Stalled on a cache miss: devices run, the core does not fetch
+        if (proc->stall_cycles) {
+            proc->stall_cycles--;
+            proc->cycle_counter++;
+            continue;
+        }
 
-        // Decode instruction
-        Instruction decoded_inst = decode_instruction(inst);
+        // Sleeping in wfi: jump to the cycle of the next device event
+        if (proc->waiting) {
+            if (!irq_pending(proc)) {
+                lock_devices();
+                uint32_t idle = next_device_event(proc, c->irq2);
+                if (idle) {
+                    proc->cycle_counter++;
+                    advance_idle_cycles(proc, idle - 1);
+                }
+                unlock_devices();
+                if (idle == 0) {
+                    fprintf(stderr, "Warning: wfi with no device event pending, stopping core %u at cycle %u\n",
+                        proc->core_id, proc->cycle_counter);
+                    proc->halt = 1;
+                }
+                continue;
+            }
+            proc->waiting = 0;
+        }
 
+        // Fetch the pre-decoded instruction; breakpoints are trap entries
+        uint64_t inst = proc->imem[proc->pc];
+        Instruction decoded_inst = proc->decoded[proc->pc];
+        if (decoded_inst.opcode == TRAP_OPCODE) {
+            decoded_inst = debug_breakpoint(proc, decoded_inst);
+            if (proc->halt) break;
+            if (debugger.restored) {  // Time travel from the prompt
+                debugger.restored = 0;
+                continue;
+            }
+        }
+        int quiet = proc->cycle_counter < debugger.high_water;  // Replaying written cycles
 
         // **Update $imm1 and $imm2 before writing trace**
         proc->registers[1] = decoded_inst.immediate1;  // $imm1
         proc->registers[2] = decoded_inst.immediate2;  // $imm2
 
         // Write trace before execution
-        write_trace(trace, proc, inst);
+        if (!quiet) c->trace_bytes += write_trace(c->trace, proc, inst);
 
         // Execute instruction
+        uint32_t pc = proc->pc;
         execute_instruction(proc, decoded_inst);
+        proc->instructions++;
+        if (proc->pipeline) {
+            pipeline_retire(proc->pipeline, pc, decoded_inst, proc->pc, proc->stall_cycles,
+                proc->num_predictors ? proc->last_mispredict : -1);
+        }
+        if (sampling.period) proc->stall_cycles = 0;  // Measured by the models, not simulated
 
         // Handle IO operations tracing
-        if (decoded_inst.opcode == 19) {  // in
+        if (!quiet && decoded_inst.opcode == 19) {  // in
             uint32_t addr = proc->registers[decoded_inst.rs] +
                 proc->registers[decoded_inst.rt];
-            write_hwregtrace(hwregtrace, proc->cycle_counter,
-                io_register_names[addr], "READ",
+            c->trace_bytes += write_hwregtrace(c->hwregtrace, proc->cycle_counter,
+                io_register_name(addr), "READ",
                 proc->registers[decoded_inst.rd]);
         }
-        else if (decoded_inst.opcode == 20) {  // out
+        else if (!quiet && decoded_inst.opcode == 20) {  // out
             uint32_t addr = proc->registers[decoded_inst.rs] +
                 proc->registers[decoded_inst.rt];
             uint32_t value = proc->registers[decoded_inst.rm];
-            write_hwregtrace(hwregtrace, proc->cycle_counter, io_register_names[addr],
+            c->trace_bytes += write_hwregtrace(c->hwregtrace, proc->cycle_counter, io_register_name(addr),
                 "WRITE", value);
         }
 
-        // Update LED and display files if changed
-        if (proc->leds != prev_leds) {
-            fprintf(leds, "%u %08X\n", proc->cycle_counter, proc->leds);
-            prev_leds = proc->leds;
-        }
-        if (proc->display7seg != prev_display) {
-            fprintf(display7seg, "%u %08X\n", proc->cycle_counter,
-                proc->display7seg);
-            prev_display = proc->display7seg;
+        if (owns_devices) {
+            lock_devices();
+
+            // Update LED and display files if changed
+            if (proc->leds != c->prev_leds) {
+                if (!quiet) output_printf(c->leds, "%u %08X\n", proc->cycle_counter, proc->leds);
+                c->prev_leds = proc->leds;
+            }
+            if (proc->display7seg != c->prev_display) {
+                if (!quiet) output_printf(c->display7seg, "%u %08X\n", proc->cycle_counter,
+                    proc->display7seg);
+                c->prev_display = proc->display7seg;
+            }
+
+            // Emit a monitor frame on vsync or at the frame period
+            if (c->monitor_stream && proc->monitor_dirty &&
+                (proc->monitor_vsync ||
+                    (proc->monitor_frame_cycles && proc->cycle_counter >= proc->monitor_next_frame))) {
+                if (quiet) clear_monitor_dirty(proc);
+                else emit_monitor_frame(c->monitor_stream, proc);
+            }
+
+            unlock_devices();
         }
 
         // Increment cycle counter
         proc->cycle_counter++;
+
+        if (cosim.granularity) cosim_retired(proc, pc, decoded_inst);
+
+        // Watchpoint hit, single-stepping, replay, or a halt to stop at
+        if (debugger.pending || (debugger.enabled && proc->halt)) {
+            debug_check(proc);
+        }
+    }
+}
+
+// With an image, argv[1] and argv[2] only name the program
+void simulate(Processor* proc, char* argv[], const ProgramImage* image) {
+    // Open all input files
+    FILE* imemin = image ? NULL : fopen(argv[1], "r");
+    FILE* dmemin = image ? NULL : fopen(argv[2], "r");
+    FILE* diskin = fopen(argv[3], "r");
+    FILE* irq2in = options.irq2_gen ? NULL : fopen(argv[4], "r");  // Not read with a generator
+
+    if ((!image && (!imemin || !dmemin)) || !diskin || (!irq2in && !options.irq2_gen)) {
+        fprintf(stderr, "Error: Cannot open one or more files\n");
+        exit(1);
+    }
+
+    // Open all output files; with --verify, their expected files by the
+    // usual names (tests/*/ holds dmemout.txt, regout.txt and so on)
+    static const char* const output_names[] = { "dmemout.txt", "regout.txt", "trace.txt",
+        "hwregtrace.txt", "cycles.txt", "leds.txt", "display7seg.txt", "diskout.txt",
+        "monitor.txt", "monitor.yuv" };
+    OutputFile outputs[10];
+    OutputFile core_traces[MAX_CORES][2];
+    OutputFile* all_outputs[11 + 2 * MAX_CORES];  // Outputs, the monitor stream and core traces
+    int num_outputs = 0;
+    for (int i = 0; i < 10; i++) {
+        open_output(&outputs[i], argv[5 + i], output_names[i], i == 9);  // monitor.yuv is binary
+        all_outputs[num_outputs++] = &outputs[i];
+    }
+    int expected_files = 0;
+    for (int i = 0; i < 10; i++) expected_files += outputs[i].expected != NULL;
+    if (options.verify && !expected_files) {
+        for (int i = 0; i < 10; i++) {  // Drop the spool files
+            fclose(outputs[i].f);
+            remove(outputs[i].spool_path);
+        }
+        fprintf(stderr, "Error: No expected output files in %s\n", options.verify);
+        exit(1);
+    }
+    OutputFile* dmemout = &outputs[0];
+    OutputFile* regout = &outputs[1];
+    OutputFile* cycles = &outputs[4];
+    OutputFile* diskout = &outputs[7];
+
+    // Optional per-frame monitor stream, verified against its file name in DIR
+    OutputFile stream;
+    OutputFile* monitor_stream = NULL;
+    if (options.monitor_stream) {
+        const char* slash = strrchr(options.monitor_stream, '/');
+        monitor_stream = &stream;
+        open_output(monitor_stream, options.monitor_stream, slash ? slash + 1 : options.monitor_stream, 1);
+        all_outputs[num_outputs++] = monitor_stream;
+        if (options.monitor_delta) {
+            write_monitor_delta_header(monitor_stream);
+        }
+    }
+
+    // Load initial states
+    alloc_memories(proc);
+    debugger.pages = (uint8_t*)calloc(options.dmem_size / DEBUG_PAGE_WORDS, 1);
+    if (!debugger.pages) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    if (image) {
+        int words = image->dmem_words < (int)options.dmem_size ? image->dmem_words : (int)options.dmem_size;
+        memcpy(proc->imem, image->imem, sizeof(uint64_t) * image->imem_words);
+        memcpy(proc->dmem, image->dmem, sizeof(uint32_t) * words);
+    }
+    else {
+        load_memory64(argv[1], proc->imem, MEMORY_SIZE, 12);  // Instructions
+        load_memory32(argv[2], proc->dmem, options.dmem_size, 8);  // Data
+    }
+    predecode_program(proc);
+    load_memory32(argv[3], proc->disk, options.disk_size, 8);  // Disk
+
+    // irq2 events are read or generated as the run reaches them
+    Irq2Source irq2;
+    open_irq2_source(&irq2, argv[4]);
+
+    // Core 0 owns the devices and the main output files
+    CoreContext ctx[MAX_CORES];
+    memset(ctx, 0, sizeof(ctx));
+    ctx[0].proc = proc;
+    ctx[0].trace = &outputs[2];
+    ctx[0].hwregtrace = &outputs[3];
+    ctx[0].leds = &outputs[5];
+    ctx[0].display7seg = &outputs[6];
+    ctx[0].monitor_stream = monitor_stream;
+    ctx[0].irq2 = &irq2;
+
+    // Other cores run the same program with their own trace files
+    Processor* cores[MAX_CORES] = { proc };
+    for (uint32_t i = 1; i < options.cores; i++) {
+        Processor* core = (Processor*)malloc(sizeof(Processor));
+        if (!core) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+        init_processor(core);
+        memcpy(core->imem, proc->imem, sizeof(core->imem));
+        memcpy(core->decoded, proc->decoded, sizeof(core->decoded));
+        core->dmem = proc->dmem;  // Memories are shared, core 0 frees them
+        core->disk = proc->disk;
+        core->monitor_buffer = proc->monitor_buffer;
+        core->io = proc;
+        core->core_id = i;
+        cores[i] = core;
+
+        ctx[i].proc = core;
+        for (int k = 0; k < 2; k++) {
+            char path[MAX_LINE_LENGTH], name[MAX_LINE_LENGTH];
+            core_file_name(path, sizeof(path), argv[7 + k], i);
+            core_file_name(name, sizeof(name), output_names[2 + k], i);
+            open_output(&core_traces[i][k], path, name, 0);
+            all_outputs[num_outputs++] = &core_traces[i][k];
+        }
+        ctx[i].trace = &core_traces[i][0];
+        ctx[i].hwregtrace = &core_traces[i][1];
+        ctx[i].irq2 = &irq2;  // Core 0 reads it; the others once core 0 has halted
+    }
+
+    if (options.snapshot_every) {
+        init_snapshots(&ctx[0]);
+    }
+    if (options.cosim) {
+        init_cosim(proc, argv[4]);
+    }
+    if (options.metrics) {
+        init_metrics();
+    }
+    if (options.sample_period) {
+        init_sampling(proc);
+    }
+    if (options.memtrace) {
+        memtrace = fopen(options.memtrace, "wb");
+        if (!memtrace) {
+            fprintf(stderr, "Error: Cannot open memory trace %s\n", options.memtrace);
+            exit(1);
+        }
+        uint8_t header[4];
+        put_u32(header, options.dmem_size);
+        fwrite(MEMTRACE_MAGIC, 1, 8, memtrace);
+        fwrite(header, 1, sizeof(header), memtrace);
+    }
+    if (options.debug) {
+        debugger.enabled = 1;
+        debugger.cores = cores;
+        debugger.num_cores = (int)options.cores;
+        snprintf(debugger.reason, sizeof(debugger.reason), "start");
+        if (snapshots.every) take_snapshot(&ctx[0]);  // So the start is reachable from the prompt
+        debug_prompt(proc);
+    }
+
+    uint64_t run_start_ns = host_time_ns();
+    if (options.fuzz_execs) fuzz_campaign(proc, &irq2);
+    else run_cores(ctx, (int)options.cores);
+    uint64_t run_end_ns = host_time_ns();
+    if (metrics.shared) publish_metrics(&ctx[0], 1);  // Final state, marked halted
+    uint64_t instructions = 0;
+    for (uint32_t i = 0; i < options.cores; i++) instructions += cores[i]->instructions;
+    if (cosim.granularity) {
+        cosim_check(proc, 1);  // Final state, memories included
+        printf("Co-simulation: %llu checks passed, reference agrees at cycle %u\n",
+            (unsigned long long)cosim.checks, proc->cycle_counter);
+        free_cosim();
+    }
+
+    // The run ends when the last core halts; the core report keeps each core's own cycle
+    uint32_t halt_cycles[MAX_CORES];
+    for (uint32_t i = 0; i < options.cores; i++) halt_cycles[i] = cores[i]->cycle_counter;
+    for (uint32_t i = 1; i < options.cores; i++) {
+        if (cores[i]->cycle_counter > proc->cycle_counter) {
+            proc->cycle_counter = cores[i]->cycle_counter;
+        }
     }
 
     // Write final states
     write_dmemout(dmemout, proc);
     write_regout(regout, proc);
     write_diskout(diskout, proc);
-    write_monitor(monitor_txt, monitor_yuv, proc);
-    fprintf(cycles, "%u", proc->cycle_counter);
+    write_monitor(&outputs[8], &outputs[9], proc);
+    output_printf(cycles, "%u", proc->cycle_counter);
+    if (monitor_stream) {
+        emit_monitor_frame(monitor_stream, proc);  // Whatever was drawn since the last frame
+    }
+    if (sampling.period) {
+        finish_sampling(stdout, proc);  // Reattaches the models for the reports below
+    }
+    for (uint32_t c = 0; c < options.cores; c++) {
+        Processor* core = cores[c];
+        if (options.cores > 1 && (core->num_predictors || core->pipeline || core->dcache)) {
+            printf("Core %u:\n", c);
+        }
+        for (int i = 0; i < core->num_predictors; i++) {
+            write_predictor_report(stdout, core->predictors[i], options.pipeline_branch_penalty);
+            free_predictor(core->predictors[i]);
+        }
+        core->num_predictors = 0;
+        if (core->pipeline) {
+            write_pipeline_report(stdout, core->pipeline);
+            free(core->pipeline);
+            core->pipeline = NULL;
+        }
+        if (core->dcache) {
+            write_cache_report(stdout, core->dcache);
+            free_cache(core->dcache);
+            core->dcache = NULL;
+        }
+    }
+    if (options.cores > 1) {
+        write_core_report(stdout, cores, halt_cycles, (int)options.cores);
+    }
+    if (options.snapshot_every) {
+        free_snapshots();
+    }
+    if (metrics.shared) {
+        free_metrics();
+    }
+    if (memtrace) {
+        fclose(memtrace);
+        memtrace = NULL;
+    }
+    for (uint32_t i = 1; i < options.cores; i++) {
+        free(cores[i]);
+    }
+    free_memories(proc);
+    free(debugger.pages);
+    debugger.pages = NULL;
 
     // Close all files
-    fclose(imemin);
-    fclose(dmemin);
+    if (imemin) fclose(imemin);
+    if (dmemin) fclose(dmemin);
     fclose(diskin);
-    fclose(irq2in);
-    fclose(dmemout);
-    fclose(regout);
-    fclose(trace);
-    fclose(hwregtrace);
-    fclose(cycles);
-    fclose(leds);
-    fclose(display7seg);
-    fclose(diskout);
-    fclose(monitor_txt);
-    fclose(monitor_yuv);
+    if (irq2in) fclose(irq2in);
+    close_irq2_source(&irq2);
+    verify_failures = finish_outputs(all_outputs, num_outputs);
+
+    // startup: option parsing to the first cycle, shutdown: writing the final state
+    if (options.host_stats) {
+        fprintf(stderr, "host-stats startup_ns=%llu run_ns=%llu shutdown_ns=%llu instructions=%llu cycles=%u\n",
+            (unsigned long long)(run_start_ns - host_start_ns), (unsigned long long)(run_end_ns - run_start_ns),
+            (unsigned long long)(host_time_ns() - run_end_ns), (unsigned long long)instructions,
+            proc->cycle_counter);
+    }
+}
+
+// Monotonic: a wall clock step would skew --host-stats and the metrics MIPS
+uint64_t host_time_ns(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(count.QuadPart / frequency.QuadPart) * 1000000000u +
+        (uint64_t)(count.QuadPart % frequency.QuadPart) * 1000000000u / (uint64_t)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+/************************* Option Parsing *************************/
+// Options come before the 14 file arguments. Returns the index of the
+// first file argument, or -1 on an unknown or incomplete option.
+int parse_options(int argc, char* argv[]) {
+    int i = 1;
+    while (i < argc && strncmp(argv[i], "--", 2) == 0) {
+        const char* opt = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(opt, "--monitor-delta") == 0) {
+            options.monitor_delta = 1;
+            i++;
+            continue;
+        }
+        if (strcmp(opt, "--pipeline") == 0) {
+            options.pipeline = 1;
+            i++;
+            continue;
+        }
+        if (strcmp(opt, "--lockstep") == 0) {
+            options.lockstep = 1;
+            i++;
+            continue;
+        }
+        if (strcmp(opt, "--host-stats") == 0) {
+            options.host_stats = 1;
+            i++;
+            continue;
+        }
+        if (strcmp(opt, "--debug") == 0) {
+            options.debug = 1;
+            options.lockstep = 1;  // Stops must see every core paused
+            i++;
+            continue;
+        }
+
+        // The remaining options take a value
+        if (!value) {
+            fprintf(stderr, "Error: Option %s needs a value\n", opt);
+            return -1;
+        }
+        if (strcmp(opt, "--monitor-stream") == 0) {
+            options.monitor_stream = value;
+        }
+        else if (strcmp(opt, "--monitor-frame-cycles") == 0) {
+            options.monitor_frame_cycles = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--dcache-size") == 0) {
+            options.dcache_words = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--dcache-ways") == 0) {
+            options.dcache_ways = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--dcache-line") == 0) {
+            options.dcache_line = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--dcache-write") == 0) {
+            if (strcmp(value, "wb") != 0 && strcmp(value, "wt") != 0) {
+                fprintf(stderr, "Error: --dcache-write takes wb or wt\n");
+                return -1;
+            }
+            options.dcache_write_through = strcmp(value, "wt") == 0;
+        }
+        else if (strcmp(opt, "--dcache-penalty") == 0) {
+            options.dcache_penalty = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--pipeline-branch-penalty") == 0) {
+            options.pipeline_branch_penalty = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--bpred") == 0) {
+            if (options.num_predictors == MAX_PREDICTORS) {
+                fprintf(stderr, "Error: At most %d branch predictors\n", MAX_PREDICTORS);
+                return -1;
+            }
+            options.predictors[options.num_predictors++] = value;
+        }
+        else if (strcmp(opt, "--btb-entries") == 0) {
+            options.btb_entries = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--cores") == 0) {
+            options.cores = (uint32_t)strtoul(value, NULL, 0);
+            if (options.cores < 1 || options.cores > MAX_CORES) {
+                fprintf(stderr, "Error: --cores takes 1 to %d\n", MAX_CORES);
+                return -1;
+            }
+        }
+        else if (strcmp(opt, "--cosim") == 0) {
+            char* end;
+            unsigned long cycles = strtoul(value, &end, 0);
+            if (strcmp(value, "insn") != 0 && strcmp(value, "block") != 0 && (*end || cycles == 0)) {
+                fprintf(stderr, "Error: --cosim takes insn, block or a cycle count\n");
+                return -1;
+            }
+            options.cosim = value;
+        }
+        else if (strcmp(opt, "--fuzz") == 0) {
+            options.fuzz_execs = strtoull(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--fuzz-budget") == 0) {
+            options.fuzz_budget = (uint32_t)strtoul(value, NULL, 0);
+            if (options.fuzz_budget == 0) {
+                fprintf(stderr, "Error: --fuzz-budget must be at least 1\n");
+                return -1;
+            }
+        }
+        else if (strcmp(opt, "--fuzz-seed") == 0) {
+            options.fuzz_seed = strtoull(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--fuzz-crashes") == 0) {
+            options.fuzz_crashes = value;
+        }
+        else if (strcmp(opt, "--memtrace") == 0) {
+            options.memtrace = value;
+        }
+        else if (strcmp(opt, "--verify") == 0) {
+            options.verify = value;
+        }
+        else if (strcmp(opt, "--snapshot-every") == 0) {
+            options.snapshot_every = (uint32_t)strtoul(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--snapshot-limit") == 0) {
+            options.snapshot_limit = (uint32_t)strtoul(value, NULL, 0);
+            if (options.snapshot_limit < 2) {
+                fprintf(stderr, "Error: --snapshot-limit must be at least 2\n");
+                return -1;
+            }
+        }
+        else if (strcmp(opt, "--dmem-size") == 0) {
+            unsigned long words = strtoul(value, NULL, 0);
+            if (words == 0 || words % DEBUG_PAGE_WORDS || words > MAX_MEMORY_WORDS) {
+                fprintf(stderr, "Error: --dmem-size must be a multiple of %d words up to %u\n",
+                    DEBUG_PAGE_WORDS, MAX_MEMORY_WORDS);
+                return -1;
+            }
+            options.dmem_size = (uint32_t)words;
+        }
+        else if (strcmp(opt, "--disk-size") == 0) {
+            unsigned long words = strtoul(value, NULL, 0);
+            if (words == 0 || words % DISK_SECTOR_WORDS || words > MAX_MEMORY_WORDS) {
+                fprintf(stderr, "Error: --disk-size must be a multiple of %d words up to %u\n",
+                    DISK_SECTOR_WORDS, MAX_MEMORY_WORDS);
+                return -1;
+            }
+            options.disk_size = (uint32_t)words;
+        }
+        else if (strcmp(opt, "--monitor-size") == 0) {
+            unsigned long side = strtoul(value, NULL, 0);
+            if (side == 0 || side % 32 || side > MAX_MONITOR_SIZE) {
+                fprintf(stderr, "Error: --monitor-size must be a multiple of 32 up to %d\n", MAX_MONITOR_SIZE);
+                return -1;
+            }
+            options.monitor_size = (uint32_t)side;
+        }
+        else if (strcmp(opt, "--metrics") == 0) {
+            options.metrics = value;
+        }
+        else if (strcmp(opt, "--metrics-every") == 0) {
+            options.metrics_every = (uint32_t)strtoul(value, NULL, 0);
+            if (options.metrics_every == 0) {
+                fprintf(stderr, "Error: --metrics-every must be at least 1\n");
+                return -1;
+            }
+        }
+        else if (strcmp(opt, "--irq2-gen") == 0) {
+            options.irq2_gen = value;
+        }
+        else if (strcmp(opt, "--irq2-seed") == 0) {
+            options.irq2_seed = strtoull(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--irq2-limit") == 0) {
+            options.irq2_limit = strtoull(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--sample") == 0) {
+            options.sample_period = strtoull(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--sample-warmup") == 0) {
+            options.sample_warmup = strtoull(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--sample-window") == 0) {
+            options.sample_window = strtoull(value, NULL, 0);
+            if (options.sample_window == 0) {
+                fprintf(stderr, "Error: --sample-window must be at least 1\n");
+                return -1;
+            }
+        }
+        else if (strcmp(opt, "--sample-schedule") == 0) {
+            if (strcmp(value, "fixed") == 0) options.sample_schedule = SAMPLE_FIXED;
+            else if (strcmp(value, "random") == 0) options.sample_schedule = SAMPLE_RANDOM;
+            else if (strcmp(value, "phase") == 0) options.sample_schedule = SAMPLE_PHASE;
+            else {
+                fprintf(stderr, "Error: --sample-schedule takes fixed, random or phase\n");
+                return -1;
+            }
+        }
+        else if (strcmp(opt, "--sample-seed") == 0) {
+            options.sample_seed = strtoull(value, NULL, 0);
+        }
+        else if (strcmp(opt, "--quantum") == 0) {
+            options.quantum = (uint32_t)strtoul(value, NULL, 0);
+            if (options.quantum == 0) {
+                fprintf(stderr, "Error: --quantum must be at least 1\n");
+                return -1;
+            }
+        }
+        else {
+            fprintf(stderr, "Error: Unknown option %s\n", opt);
+            return -1;
+        }
+        i += 2;
+    }
+
+    // Replay restores core 0 only, and the observers would count replayed instructions twice
+    if (options.snapshot_every && (options.cores > 1 || options.pipeline || options.num_predictors)) {
+        fprintf(stderr, "Error: --snapshot-every works with one core and without --pipeline or --bpred\n");
+        return -1;
+    }
+    // The reference follows one core forward in time
+    if (options.cosim && (options.cores > 1 || options.debug || options.snapshot_every)) {
+        fprintf(stderr, "Error: --cosim works with one core and without --debug or --snapshot-every\n");
+        return -1;
+    }
+    // Fuzz execs restore registers and memories only, and use the watch pages
+    if (options.fuzz_execs && (options.cores > 1 || options.debug || options.snapshot_every || options.cosim ||
+        options.memtrace || options.dcache_words || options.pipeline || options.num_predictors)) {
+        fprintf(stderr, "Error: --fuzz works with one core and without the timing models, --debug, "
+            "--cosim, --snapshot-every or --memtrace\n");
+        return -1;
+    }
+    // Sampling moves core 0's timing models on and off and keeps stalls out of the run
+    if (options.sample_period) {
+        if (!options.pipeline && !options.dcache_words && !options.num_predictors) {
+            fprintf(stderr, "Error: --sample needs --pipeline, --dcache-size or --bpred\n");
+            return -1;
+        }
+        if (options.cores > 1 || options.debug || options.snapshot_every || options.cosim || options.fuzz_execs) {
+            fprintf(stderr, "Error: --sample works with one core and without --debug, --snapshot-every, "
+                "--cosim or --fuzz\n");
+            return -1;
+        }
+        if (options.sample_period < options.sample_warmup + options.sample_window) {
+            fprintf(stderr, "Error: --sample period must cover --sample-warmup plus --sample-window\n");
+            return -1;
+        }
+        if (options.sample_schedule == SAMPLE_PHASE && options.sample_period - options.sample_warmup -
+            options.sample_window < 16 * SAMPLE_PROBE_INSTRUCTIONS) {
+            fprintf(stderr, "Error: --sample-schedule phase needs %d instructions before the warmup\n",
+                16 * SAMPLE_PROBE_INSTRUCTIONS);
+            return -1;
+        }
+    }
+    return i;
 }
+
 /************************* Main Function *************************/
-int main(int argc, char* argv[]) {
-    if (argc != 15) {  // Program name + 14 arguments
-        fprintf(stderr, "Usage: %s imemin.txt dmemin.txt diskin.txt irq2in.txt "
+// Also the entry point for simp run, which passes an assembled image
+int sim_main(int argc, char* argv[], const ProgramImage* image) {
+    host_start_ns = host_time_ns();
+    init_io_bus();
+    int first = parse_options(argc, argv);
+    if (first < 0 || argc - first != 14) {  // Options + 14 file arguments
+        fprintf(stderr, "Usage: %s [options] imemin.txt dmemin.txt diskin.txt irq2in.txt "
             "dmemout.txt regout.txt trace.txt hwregtrace.txt cycles.txt "
             "leds.txt display7seg.txt diskout.txt monitor.txt monitor.yuv\n",
             argv[0]);
+        fprintf(stderr, "Options:\n"
+            "  --monitor-stream FILE       write a monitor frame whenever the screen changed\n"
+            "  --monitor-frame-cycles N    emit frames every N cycles (default: on vsync only)\n"
+            "  --monitor-delta             store changed spans instead of full YUV frames\n"
+            "  --dcache-size WORDS         model a data cache of this size (default: none)\n"
+            "  --dcache-ways N             associativity (default 1)\n"
+            "  --dcache-line WORDS         line size (default 4)\n"
+            "  --dcache-write wb|wt        write-back or write-through (default wb)\n"
+            "  --dcache-penalty CYCLES     stall per line fill or writeback (default 10)\n"
+            "  --pipeline                  report 5-stage pipeline CPI and stalls at halt\n"
+            "  --pipeline-branch-penalty N cycles lost per taken branch, or per\n"
+            "                              misprediction with --bpred (default 2)\n"
+            "  --bpred SPEC                evaluate a branch predictor, repeatable:\n"
+            "                              static, btfn, bimodal:N, gshare:HISTORY_BITS\n"
+            "  --btb-entries N             BTB size for register targets (default 256)\n"
+            "  --dmem-size WORDS           data memory size, a multiple of 128 (default 4096)\n"
+            "  --disk-size WORDS           disk size, a multiple of 128 (default 16384)\n"
+            "  --monitor-size N            monitor side in pixels, a multiple of 32 (default 256)\n"
+            "  --cores N                   run N cores sharing dmem and devices (default 1)\n"
+            "  --quantum CYCLES            cycles between core barriers (default 1000)\n"
+            "  --lockstep                  run cores on one thread, one cycle at a time\n"
+            "  --debug                     interactive debugger on stdin (type h for help)\n"
+            "  --snapshot-every CYCLES     keep snapshots for goto-cycle and step-back\n"
+            "  --snapshot-limit N          snapshots kept before thinning (default 32)\n"
+            "  --memtrace FILE             record dmem accesses in binary for memtrace\n"
+            "  --host-stats                print host startup/run/shutdown times to stderr\n"
+            "  --verify DIR                compare the outputs with DIR's expected files in memory;\n"
+            "                              they are written only if something differs\n"
+            "  --metrics NAME              publish live metrics in shared memory NAME for simp-top\n"
+            "  --metrics-every CYCLES      cycles between metric updates (default 100000)\n"
+            "  --sample PERIOD             run the timing models only in a window every PERIOD\n"
+            "                              instructions and estimate CPI for the whole run\n"
+            "  --sample-warmup N           instructions warming the models before a window (default 2000)\n"
+            "  --sample-window N           instructions measured per window (default 1000)\n"
+            "  --sample-schedule S         fixed, random or phase (default fixed)\n"
+            "  --sample-seed N             random schedule seed (default 1)\n"
+            "  --irq2-gen SPEC             generate irq2 events instead of reading irq2in.txt:\n"
+            "                              periodic:P, jitter:P:J or poisson:MEAN (cycles)\n"
+            "  --irq2-seed N               generator seed (default 1)\n"
+            "  --irq2-limit N              stop after N generated events (default: no limit)\n"
+            "  --cosim insn|block|CYCLES   check against the reference interpreter after every\n"
+            "                              instruction, basic block or CYCLES cycles\n"
+            "  --fuzz EXECS                fuzz irq2 timings and dmem in-process instead of a normal run\n"
+            "  --fuzz-budget CYCLES        cycles before an exec counts as a hang (default 100000)\n"
+            "  --fuzz-seed N               random seed (default 1)\n"
+            "  --fuzz-crashes PREFIX       write PREFIX<n>_dmemin.txt and _irq2in.txt per distinct crash\n");
         return 1;
     }
+    argv += first - 1;  // argv[1..14] are the file arguments
 
     // Initialize processor
     Processor proc;
     init_processor(&proc);
 
     // Run simulation
-    simulate(&proc, argv);
+    simulate(&proc, argv, image);
+    if (verify_failures) {
+        fprintf(stderr, "Error: %d output(s) differ from %s\n", verify_failures, options.verify);
+        return 1;
+    }
     printf("Simulator completed successfully!\n");
 
     return 0;
-}
\ No newline at end of file
+}
+
+#ifndef SIMP_LIBRARY
+int main(int argc, char* argv[]) {
+    return sim_main(argc, argv, NULL);
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,352 @@
+/*****************************************************************
+ * SIMP Driver (simp)
+ *
+ * simp run assembles a program and simulates it in one process:
+ * - The assembled image goes straight to the simulator, with no
+ *   imemin/dmemin files written or parsed
+ * - Images are cached under a hash of the source, the assembler
+ *   version and the dmem size, so unchanged programs skip assembly
+ * - Simulator options pass through; outputs go to one directory
+ *
+ * Built from this file plus asm.c and sim.c compiled with
+ * SIMP_LIBRARY, which drops their main functions.
+ *****************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <process.h>
+#define MKDIR(path) _mkdir(path)
+#define GETPID() _getpid()
+#define NULL_DEVICE "NUL"
+#define PATH_SEPARATOR '\\'
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define MKDIR(path) mkdir(path, 0755)
+#define GETPID() getpid()
+#define NULL_DEVICE "/dev/null"
+#define PATH_SEPARATOR '/'
+#endif
+
+ /************************* Constants *************************/
+#define MAX_PATH_LENGTH 1024
+#define MAX_ARGS 128
+#define MEMORY_SIZE 4096
+#define IMAGE_MAGIC "SIMPIMG1"
+#define FNV_OFFSET 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+/************************* Data Structures *************************/
+// Same layout as ProgramImage in asm.c and sim.c
+typedef struct {
+    uint64_t imem[MEMORY_SIZE];
+    int imem_words;
+    uint32_t* dmem;
+    int dmem_words;
+} ProgramImage;
+
+// Cache file header, followed by imem_words u64 and dmem_words u32
+typedef struct {
+    char magic[8];
+    uint64_t key;
+    uint64_t source_size;        // Guards against key collisions along with the key
+    uint32_t imem_words;
+    uint32_t dmem_words;
+} ImageHeader;
+
+typedef struct {
+    const char* out;             // Directory for the simulator outputs
+    const char* cache;           // Image cache directory, NULL if disabled
+    int verbose;
+} DriverOptions;
+
+/************************* External Functions *************************/
+// asm.c
+extern int dmem_size;
+extern const char* assembler_version;
+void assemble_image(FILE* input, ProgramImage* image);
+
+// sim.c
+int sim_main(int argc, char* argv[], const ProgramImage* image);
+
+/************************* Global Variables *************************/
+DriverOptions driver = { ".", NULL, 0 };
+const char* output_names[] = {
+    "dmemout.txt", "regout.txt", "trace.txt", "hwregtrace.txt", "cycles.txt",
+    "leds.txt", "display7seg.txt", "diskout.txt", "monitor.txt", "monitor.yuv"
+};
+
+/************************* Utility Functions *************************/
+void make_dirs(const char* path) {
+    char buf[MAX_PATH_LENGTH];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char* p = buf + 1; *p; p++) {
+        if (*p != '/' && *p != PATH_SEPARATOR) continue;
+        char c = *p;
+        *p = '\0';
+        MKDIR(buf);
+        *p = c;
+    }
+    if (MKDIR(buf) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Cannot create directory %s\n", buf);
+        exit(1);
+    }
+}
+
+// dst = dir/name, failing on paths that do not fit
+void join_path(char* dst, const char* dir, const char* name) {
+    if (snprintf(dst, MAX_PATH_LENGTH, "%s%c%s", dir, PATH_SEPARATOR, name) >= MAX_PATH_LENGTH) {
+        fprintf(stderr, "Error: Path too long: %s%c%s\n", dir, PATH_SEPARATOR, name);
+        exit(1);
+    }
+}
+
+int ends_with(const char* s, const char* suffix) {
+    size_t n = strlen(s), m = strlen(suffix);
+    return n >= m && strcmp(s + n - m, suffix) == 0;
+}
+
+char* read_file(const char* path, size_t* size) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open input file %s\n", path);
+        exit(1);
+    }
+    size_t capacity = 1 << 16;
+    char* data = (char*)malloc(capacity);
+    *size = 0;
+    size_t n;
+    while (data && (n = fread(data + *size, 1, capacity - *size, f)) > 0) {
+        *size += n;
+        if (*size == capacity) data = (char*)realloc(data, capacity *= 2);
+    }
+    fclose(f);
+    if (!data) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    return data;
+}
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) hash = (hash ^ p[i]) * FNV_PRIME;
+    return hash;
+}
+
+// SIMP_CACHE, else the per-user cache directory; NULL if neither is known
+const char* default_cache_dir(void) {
+    static char dir[MAX_PATH_LENGTH];
+    const char* env = getenv("SIMP_CACHE");
+    if (env && *env) return env;
+#if defined(_WIN32)
+    env = getenv("LOCALAPPDATA");
+    if (env && *env) {
+        join_path(dir, env, "simp");
+        return dir;
+    }
+#else
+    env = getenv("XDG_CACHE_HOME");
+    if (env && *env) {
+        join_path(dir, env, "simp");
+        return dir;
+    }
+    env = getenv("HOME");
+    if (env && *env) {
+        join_path(dir, env, ".cache/simp");
+        return dir;
+    }
+#endif
+    return NULL;
+}
+
+/************************* Image Cache *************************/
+// Images are stored in host byte order; a cache written on a host with
+// the other order fails the key check and is rebuilt.
+
+int load_cached_image(const char* path, uint64_t key, uint64_t source_size, ProgramImage* image) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+
+    ImageHeader h;
+    int ok = fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, IMAGE_MAGIC, 8) == 0 &&
+        h.key == key && h.source_size == source_size &&
+        h.imem_words <= MEMORY_SIZE && h.dmem_words <= (uint32_t)dmem_size;
+    if (ok) {
+        image->imem_words = (int)h.imem_words;
+        image->dmem_words = (int)h.dmem_words;
+        image->dmem = (uint32_t*)malloc(sizeof(uint32_t) * (h.dmem_words ? h.dmem_words : 1));
+        ok = image->dmem &&
+            fread(image->imem, sizeof(uint64_t), h.imem_words, f) == h.imem_words &&
+            fread(image->dmem, sizeof(uint32_t), h.dmem_words, f) == h.dmem_words;
+        if (!ok) free(image->dmem);
+    }
+    fclose(f);
+    return ok;
+}
+
+// Written to a temporary name and renamed, so concurrent runs never read a partial image
+void store_cached_image(const char* path, uint64_t key, uint64_t source_size, const ProgramImage* image) {
+    char temp[MAX_PATH_LENGTH];
+    snprintf(temp, sizeof(temp), "%s.%d.tmp", path, (int)GETPID());
+    FILE* f = fopen(temp, "wb");
+    if (!f) return;  // The cache is an optimization only
+
+    ImageHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IMAGE_MAGIC, 8);
+    h.key = key;
+    h.source_size = source_size;
+    h.imem_words = (uint32_t)image->imem_words;
+    h.dmem_words = (uint32_t)image->dmem_words;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+        fwrite(image->imem, sizeof(uint64_t), image->imem_words, f) == (size_t)image->imem_words &&
+        fwrite(image->dmem, sizeof(uint32_t), image->dmem_words, f) == (size_t)image->dmem_words;
+    ok = fclose(f) == 0 && ok;
+#if defined(_WIN32)
+    if (ok) remove(path);  // rename does not replace on Windows
+#endif
+    if (!ok || rename(temp, path) != 0) remove(temp);
+}
+
+// Fill image from the cache, assembling on a miss
+void get_image(const char* source_path, ProgramImage* image) {
+    size_t size;
+    char* source = read_file(source_path, &size);
+    char dmem_text[16];
+    snprintf(dmem_text, sizeof(dmem_text), "%d", dmem_size);
+    uint64_t key = fnv1a(FNV_OFFSET, assembler_version, strlen(assembler_version) + 1);
+    key = fnv1a(key, dmem_text, strlen(dmem_text) + 1);
+    key = fnv1a(key, source, size);
+    free(source);
+
+    char path[MAX_PATH_LENGTH] = "";
+    if (driver.cache) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.img", (unsigned long long)key);
+        join_path(path, driver.cache, name);
+        if (load_cached_image(path, key, size, image)) {
+            if (driver.verbose) fprintf(stderr, "simp: %s: cached image %s\n", source_path, path);
+            return;
+        }
+    }
+
+    FILE* input = fopen(source_path, "r");
+    if (!input) {
+        fprintf(stderr, "Error: Cannot open input file %s\n", source_path);
+        exit(1);
+    }
+    assemble_image(input, image);
+    fclose(input);
+    if (driver.verbose) fprintf(stderr, "simp: %s: assembled\n", source_path);
+
+    if (driver.cache) {
+        make_dirs(driver.cache);
+        store_cached_image(path, key, size, image);
+    }
+}
+
+/************************* Main Function *************************/
+void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s run [options] [sim options] prog.asm [diskin.txt [irq2in.txt]]\n", prog);
+    fprintf(stderr, "  Assembles prog.asm in memory and simulates it; sim options are passed through\n");
+    fprintf(stderr, "  --out DIR      directory for dmemout.txt ... monitor.yuv (default .)\n");
+    fprintf(stderr, "  --cache DIR    assembled image cache (default $SIMP_CACHE or the user cache dir)\n");
+    fprintf(stderr, "  --no-cache     always assemble\n");
+    fprintf(stderr, "  --verbose      report cache hits and misses on stderr\n");
+    fprintf(stderr, "  Without diskin.txt the disk starts empty; without irq2in.txt there are no\n");
+    fprintf(stderr, "  irq2 events unless --irq2-gen is given\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || strcmp(argv[1], "run") != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // simp options are taken out, the rest goes to the simulator; the
+    // program is the first argument ending in .asm
+    char* sim_args[MAX_ARGS];
+    int num_sim_args = 0;
+    const char* program = NULL;
+    const char* inputs[2] = { NULL_DEVICE, NULL_DEVICE };
+    int num_inputs = 0;
+    int no_cache = 0;
+    sim_args[num_sim_args++] = "simp run";
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (program) {
+            if (num_inputs == 2) {
+                usage(argv[0]);
+                return 1;
+            }
+            inputs[num_inputs++] = arg;
+        }
+        else if (strcmp(arg, "--out") == 0 && value) {
+            driver.out = value;
+            i++;
+        }
+        else if (strcmp(arg, "--cache") == 0 && value) {
+            driver.cache = value;
+            i++;
+        }
+        else if (strcmp(arg, "--no-cache") == 0) {
+            no_cache = 1;
+        }
+        else if (strcmp(arg, "--verbose") == 0) {
+            driver.verbose = 1;
+        }
+        else if (ends_with(arg, ".asm")) {
+            program = arg;
+        }
+        else {
+            if (strcmp(arg, "--dmem-size") == 0 && value) {
+                dmem_size = (int)strtol(value, NULL, 0);  // .word bound, same as the simulator's dmem
+                if (dmem_size <= 0 || dmem_size % 128) {
+                    fprintf(stderr, "Error: --dmem-size must be a positive multiple of 128 words\n");
+                    return 1;
+                }
+            }
+            if (num_sim_args == MAX_ARGS - 16) {
+                fprintf(stderr, "Error: Too many arguments\n");
+                return 1;
+            }
+            sim_args[num_sim_args++] = argv[i];
+        }
+    }
+    if (!program) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (no_cache) driver.cache = NULL;
+    else if (!driver.cache) driver.cache = default_cache_dir();
+
+    static ProgramImage image;
+    get_image(program, &image);
+
+    // The 14 file arguments sim expects; imemin and dmemin only name the program
+    static char outputs[10][MAX_PATH_LENGTH];
+    make_dirs(driver.out);
+    sim_args[num_sim_args++] = (char*)program;
+    sim_args[num_sim_args++] = (char*)program;
+    sim_args[num_sim_args++] = (char*)inputs[0];
+    sim_args[num_sim_args++] = (char*)inputs[1];
+    for (int i = 0; i < 10; i++) {
+        join_path(outputs[i], driver.out, output_names[i]);
+        sim_args[num_sim_args++] = outputs[i];
+    }
+    sim_args[num_sim_args] = NULL;
+
+    int status = sim_main(num_sim_args, sim_args, &image);
+    free(image.dmem);
+    return status;
+}
@@ -0,0 +1,209 @@
+/*****************************************************************
+ * SIMP Live Metrics Viewer (simp-top)
+ *
+ * Attaches to the shared-memory segment a simulator publishes with
+ * sim --metrics NAME and shows, refreshed in place:
+ * - Cycles, instructions and simulated MIPS
+ * - Current PC, leds and display7seg
+ * - Interrupt entries per IRQ
+ * - Disk busy share and trace bytes written
+ *****************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SIMP_HAVE_SHM 1
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define SIMP_HAVE_FILE_MAPPING 1
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define FENCE_ACQUIRE() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define LOAD_ACQUIRE(p) (*(volatile uint32_t*)(p))  // x86 keeps load order
+#define FENCE_ACQUIRE() _ReadWriteBarrier()
+#else
+#define LOAD_ACQUIRE(p) (*(volatile uint32_t*)(p))
+#define FENCE_ACQUIRE() ((void)0)
+#endif
+
+ /************************* Constants *************************/
+#define METRICS_MAGIC "SIMPMETR"
+#define METRICS_VERSION 1
+#define MAX_NAME_LENGTH 256
+#define MAX_READ_TRIES 1000
+
+/************************* Data Structures *************************/
+// Same layout as SimMetrics in sim.c
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+    uint32_t seq;                // Odd while an update is being written
+    uint32_t pid;
+    uint32_t halted;
+    uint32_t pc;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t host_ns;
+    uint64_t irq_entries[3];
+    uint64_t trace_bytes;
+    uint64_t updates;
+    uint32_t leds;
+    uint32_t display7seg;
+    uint32_t disk_busy_permille;
+    uint32_t every;
+    double mips;
+} SimMetrics;
+
+typedef struct {
+    uint32_t interval_ms;        // Between refreshes
+    int once;                    // Print one update and exit
+} Options;
+
+/************************* Global Variables *************************/
+Options options = { 500, 0 };
+
+/************************* Segment Access *************************/
+// POSIX wants "/name"; Windows mapping names have no slash
+void segment_name(char* out, size_t size, const char* name) {
+#if defined(SIMP_HAVE_SHM)
+    snprintf(out, size, "%s%s", name[0] == '/' ? "" : "/", name);
+#else
+    snprintf(out, size, "%s", name[0] == '/' ? name + 1 : name);
+#endif
+}
+
+const SimMetrics* attach(const char* name) {
+    void* p = NULL;
+#if defined(SIMP_HAVE_SHM)
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+    p = mmap(NULL, sizeof(SimMetrics), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+#elif defined(SIMP_HAVE_FILE_MAPPING)
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    if (!mapping) return NULL;
+    p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(SimMetrics));
+#endif
+    return (const SimMetrics*)p;
+}
+
+// Seqlock read: retry while the simulator is mid-update
+int read_metrics(const SimMetrics* shared, SimMetrics* out) {
+    for (int i = 0; i < MAX_READ_TRIES; i++) {
+        uint32_t before = LOAD_ACQUIRE(&shared->seq);
+        if (before & 1) continue;
+        memcpy(out, (const void*)shared, sizeof(SimMetrics));
+        FENCE_ACQUIRE();
+        if (LOAD_ACQUIRE(&shared->seq) == before) return 1;
+    }
+    return 0;
+}
+
+int simulator_alive(uint32_t pid) {
+#if defined(SIMP_HAVE_SHM)
+    return kill((pid_t)pid, 0) == 0 || errno != ESRCH;
+#else
+    (void)pid;
+    return 1;
+#endif
+}
+
+void sleep_ms(uint32_t ms) {
+#if defined(SIMP_HAVE_SHM)
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+#elif defined(SIMP_HAVE_FILE_MAPPING)
+    Sleep(ms);
+#endif
+}
+
+/************************* Display *************************/
+void show(const SimMetrics* m, const char* name) {
+    double seconds = m->host_ns / 1e9;
+    printf("simp-top  %s  pid %u  %s\n", name, m->pid, m->halted ? "halted" : "running");
+    printf("  host time     %10.1f s   updates %llu (every %u cycles)\n", seconds,
+        (unsigned long long)m->updates, m->every);
+    printf("  cycles        %14llu   instructions %llu\n", (unsigned long long)m->cycles,
+        (unsigned long long)m->instructions);
+    printf("  speed         %14.2f MIPS (average %.2f)\n", m->mips,
+        seconds > 0 ? m->instructions / seconds / 1e6 : 0.0);
+    printf("  pc            %14.3X\n", m->pc);
+    printf("  leds          %14.8X   display7seg %08X\n", m->leds, m->display7seg);
+    printf("  interrupts    irq0 %llu  irq1 %llu  irq2 %llu\n", (unsigned long long)m->irq_entries[0],
+        (unsigned long long)m->irq_entries[1], (unsigned long long)m->irq_entries[2]);
+    printf("  disk busy     %13.1f%%\n", m->disk_busy_permille / 10.0);
+    printf("  trace bytes   %14llu\n", (unsigned long long)m->trace_bytes);
+}
+
+/************************* Main Function *************************/
+int main(int argc, char* argv[]) {
+    int i = 1;
+    while (i < argc && strncmp(argv[i], "--", 2) == 0) {
+        if (strcmp(argv[i], "--once") == 0) {
+            options.once = 1;
+            i++;
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            options.interval_ms = (uint32_t)atoi(argv[i + 1]);
+            i += 2;
+        }
+        else {
+            fprintf(stderr, "Error: Unknown or invalid option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (argc - i != 1) {
+        fprintf(stderr, "Usage: %s [--interval MS] [--once] NAME\n", argv[0]);
+        fprintf(stderr, "  NAME is the segment given to sim --metrics\n");
+        return 1;
+    }
+
+    char name[MAX_NAME_LENGTH];
+    segment_name(name, sizeof(name), argv[i]);
+    const SimMetrics* shared = attach(name);
+    if (!shared) {
+        fprintf(stderr, "Error: Cannot open metrics segment %s (is sim --metrics running?)\n", name);
+        return 1;
+    }
+    if (memcmp(shared->magic, METRICS_MAGIC, 8) != 0 || shared->version != METRICS_VERSION ||
+        shared->size != sizeof(SimMetrics)) {
+        fprintf(stderr, "Error: %s holds metrics version %u, simp-top reads version %d\n", name,
+            shared->version, METRICS_VERSION);
+        return 1;
+    }
+
+    SimMetrics m;
+    for (;;) {
+        if (!read_metrics(shared, &m)) {
+            fprintf(stderr, "Error: Metrics kept changing while being read\n");
+            return 1;
+        }
+        if (!options.once) printf("\033[H\033[2J");  // Home and clear
+        show(&m, name);
+        fflush(stdout);
+        if (options.once || m.halted) break;
+        if (!simulator_alive(m.pid)) {
+            printf("Simulator exited without a final update\n");
+            break;
+        }
+        sleep_ms(options.interval_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,576 @@
+/*****************************************************************
+ * SIMP Trace Query Tool (simp-traceq)
+ *
+ * Answers questions like "every record where pc == 0x01A and
+ * $s1 == 3" over trace.txt files of many gigabytes:
+ * - The trace is mapped, not read, and every record is 161 bytes,
+ *   so record N is found in O(1)
+ * - Predicates on pc, instruction fields and registers compare the
+ *   fixed-width hex text directly, 8 digits per 64-bit word
+ * - Scans are split across threads
+ * - An optional sidecar index lists the records of every PC
+ *****************************************************************/
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SIMP_HAVE_MMAP 1
+#define SIMP_HAVE_THREADS 1
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define SIMP_HAVE_FILE_MAPPING 1
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BSWAP64(x) __builtin_bswap64(x)
+#elif defined(_MSC_VER)
+#define BSWAP64(x) _byteswap_uint64(x)
+#endif
+
+ /************************* Constants *************************/
+#define RECORD_SIZE 161           // "PPP IIIIIIIIIIII" + 16 x " RRRRRRRR" + "\n"
+#define REG_OFFSET 17             // First register digit; register r starts at 17 + 9r
+#define MEMORY_SIZE 4096
+#define INDEX_MAGIC "SIMPTQX2"
+#define INDEX_SAMPLES 64          // Records hashed to tell traces of one size apart
+#define MAX_PREDICATES 16
+#define MAX_THREADS 64
+#define MAX_LINE_LENGTH 500
+
+enum { OP_EQ, OP_NE, OP_LT, OP_LE, OP_GT, OP_GE };
+
+/************************* Data Structures *************************/
+// Fixed-width uppercase hex sorts like the number it spells, so fields
+// compare as text: up to 8 digits as one big-endian word, else memcmp
+typedef struct {
+    uint32_t offset;             // In the record
+    uint32_t width;              // Hex digits
+    int op;
+    uint64_t key;                // The value's digits as a word, width <= 8
+    char text[16];               // The value as width hex digits
+} Predicate;
+
+typedef struct {
+    const char* name;
+    uint32_t offset;
+    uint32_t width;
+} Field;
+
+// One thread's share of a scan or index build
+typedef struct {
+    uint64_t first;              // Records, or positions in candidates
+    uint64_t last;
+    uint64_t count;
+    uint64_t* matches;           // In record order, at most options.limit
+    uint64_t num_matches;
+    uint64_t capacity;
+    uint64_t* pc_counts;         // Index build: records per PC in this share
+    uint32_t* cursor;            // Index build: next slot per PC
+} Job;
+
+typedef struct {
+    uint64_t from;               // First record to look at
+    uint64_t to;                 // One past the last, 0 = end of trace
+    uint64_t limit;              // Records printed, 0 = all
+    int threads;
+    int count_only;
+    int build_index;
+    int use_index;
+} Options;
+
+/************************* Global Variables *************************/
+Options options = { 0, 0, 50, 0, 0, 0, 1 };
+
+const Field fields[] = {
+    { "pc", 0, 3 },   { "inst", 4, 12 }, { "op", 4, 2 },    { "rd", 6, 1 },
+    { "rs", 7, 1 },   { "rt", 8, 1 },    { "rm", 9, 1 },    { "imm1", 10, 3 },
+    { "imm2", 13, 3 },
+};
+
+const char* register_names[] = {
+    "$zero", "$imm1", "$imm2", "$v0",
+    "$a0", "$a1", "$a2", "$t0",
+    "$t1", "$t2", "$s0", "$s1",
+    "$s2", "$gp", "$sp", "$ra"
+};
+
+Predicate predicates[MAX_PREDICATES];
+int num_predicates;
+int pc_predicate = -1;           // A pc == predicate the index can answer
+
+const char* trace;               // The mapped trace
+uint64_t trace_bytes;
+uint64_t trace_mtime;
+uint64_t num_records;
+
+const uint32_t* candidates;      // Index records of one PC, NULL = scan all
+uint64_t num_candidates;
+
+/************************* Field Access *************************/
+// The first width bytes at p as a big-endian number
+static inline uint64_t load_digits(const char* p, uint32_t width) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+#if defined(BSWAP64)
+    word = BSWAP64(word);
+#else
+    uint64_t be = 0;
+    for (int i = 0; i < 8; i++) be = be << 8 | (uint8_t)p[i];
+    word = be;
+#endif
+    return word >> (8 * (8 - width));
+}
+
+uint32_t hex_value(const char* p, uint32_t width) {
+    uint32_t v = 0;
+    for (uint32_t i = 0; i < width; i++) {
+        char c = p[i];
+        v = v << 4 | (uint32_t)(c <= '9' ? c - '0' : c - 'A' + 10);
+    }
+    return v;
+}
+
+static inline int test_predicate(const Predicate* p, const char* record) {
+    int cmp;
+    if (p->width <= 8) {
+        uint64_t v = load_digits(record + p->offset, p->width);
+        cmp = (v > p->key) - (v < p->key);
+    }
+    else {
+        cmp = memcmp(record + p->offset, p->text, p->width);
+    }
+    switch (p->op) {
+    case OP_EQ: return cmp == 0;
+    case OP_NE: return cmp != 0;
+    case OP_LT: return cmp < 0;
+    case OP_LE: return cmp <= 0;
+    case OP_GT: return cmp > 0;
+    default: return cmp >= 0;
+    }
+}
+
+static inline int test_record(uint64_t record) {
+    const char* r = trace + record * RECORD_SIZE;
+    for (int i = 0; i < num_predicates; i++) {
+        if (!test_predicate(&predicates[i], r)) return 0;
+    }
+    return 1;
+}
+
+/************************* Predicate Parsing *************************/
+int find_field(const char* name, uint32_t* offset, uint32_t* width) {
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (strcmp(name, fields[i].name) == 0) {
+            *offset = fields[i].offset;
+            *width = fields[i].width;
+            return 1;
+        }
+    }
+    for (int r = 0; r < 16; r++) {
+        char plain[8];
+        snprintf(plain, sizeof(plain), "r%d", r);
+        if (strcmp(name, register_names[r]) == 0 || strcmp(name, register_names[r] + 1) == 0 ||
+            strcmp(name, plain) == 0) {
+            *offset = REG_OFFSET + 9 * r;
+            *width = 8;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// FIELD OP VALUE, e.g. pc==0x01A, $s1==3, op!=0x14, imm1<-1
+void parse_predicate(const char* spec) {
+    static const char* ops[] = { "==", "!=", "<=", ">=", "<", ">" };
+    static const int op_codes[] = { OP_EQ, OP_NE, OP_LE, OP_GE, OP_LT, OP_GT };
+    char name[MAX_LINE_LENGTH];
+    const char* at = NULL;
+    int op = -1;
+
+    for (int i = 0; i < 6 && !at; i++) {
+        at = strstr(spec, ops[i]);
+        if (at) op = i;
+    }
+    if (!at || at == spec || (size_t)(at - spec) >= sizeof(name) || num_predicates == MAX_PREDICATES) {
+        fprintf(stderr, "Error: Bad predicate %s (want FIELD==VALUE, != < <= > >= also work)\n", spec);
+        exit(1);
+    }
+    memcpy(name, spec, at - spec);
+    name[at - spec] = '\0';
+
+    Predicate* p = &predicates[num_predicates];
+    if (!find_field(name, &p->offset, &p->width)) {
+        fprintf(stderr, "Error: Unknown field %s (pc, inst, op, rd, rs, rt, rm, imm1, imm2 or a register)\n", name);
+        exit(1);
+    }
+    const char* value = at + strlen(ops[op]);
+    char* end;
+    long long v = strtoll(value, &end, 0);
+    uint64_t mask = p->width >= 16 ? ~0ull : (1ull << (4 * p->width)) - 1;
+    if (end == value || *end != '\0' || (v >= 0 && (uint64_t)v > mask) || (v < 0 && -(uint64_t)v > (mask >> 1) + 1)) {
+        fprintf(stderr, "Error: Bad value %s for %s (%u hex digits)\n", value, name, p->width);
+        exit(1);
+    }
+
+    // Negative values mean the two's complement of the field width
+    snprintf(p->text, sizeof(p->text), "%0*llX", (int)p->width, (unsigned long long)((uint64_t)v & mask));
+    p->op = op_codes[op];
+    if (p->width <= 8) {
+        char padded[16] = { 0 };
+        memcpy(padded, p->text, p->width);
+        p->key = load_digits(padded, p->width);
+    }
+    if (p->offset == 0 && p->op == OP_EQ) pc_predicate = num_predicates;
+    num_predicates++;
+}
+
+/************************* Mapping *************************/
+// NULL if the file cannot be mapped; empty files map to ""
+const char* map_file(const char* path, uint64_t* bytes) {
+#if defined(SIMP_HAVE_MMAP)
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    *bytes = (uint64_t)st.st_size;
+    void* p = *bytes ? mmap(NULL, *bytes, PROT_READ, MAP_SHARED, fd, 0) : (void*)"";
+    close(fd);
+    if (p == MAP_FAILED) return NULL;
+    return (const char*)p;
+#elif defined(SIMP_HAVE_FILE_MAPPING)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return NULL;
+    }
+    *bytes = (uint64_t)size.QuadPart;
+    if (*bytes == 0) {
+        CloseHandle(file);
+        return "";
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return NULL;
+    void* p = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    return (const char*)p;
+#else
+    (void)path;
+    (void)bytes;
+    return NULL;
+#endif
+}
+
+// Last write time in the platform's units, 0 if unknown
+uint64_t file_mtime(const char* path) {
+#if defined(SIMP_HAVE_MMAP)
+    struct stat st;
+    return stat(path, &st) == 0 ? (uint64_t)st.st_mtime : 0;
+#elif defined(SIMP_HAVE_FILE_MAPPING)
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return 0;
+    return ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+    (void)path;
+    return 0;
+#endif
+}
+
+/************************* Threads *************************/
+int default_threads(void) {
+#if defined(SIMP_HAVE_THREADS)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : n > MAX_THREADS ? MAX_THREADS : (int)n;
+#else
+    return 1;
+#endif
+}
+
+// Run work on every job, one thread each
+void run_jobs(Job* jobs, int count, void* (*work)(void*)) {
+#if defined(SIMP_HAVE_THREADS)
+    pthread_t threads[MAX_THREADS];
+    for (int i = 1; i < count; i++) {
+        if (pthread_create(&threads[i], NULL, work, &jobs[i]) != 0) {
+            fprintf(stderr, "Error: Cannot start thread %d\n", i);
+            exit(1);
+        }
+    }
+    work(&jobs[0]);
+    for (int i = 1; i < count; i++) pthread_join(threads[i], NULL);
+#else
+    for (int i = 0; i < count; i++) work(&jobs[i]);
+#endif
+}
+
+// Split [first, last) into count contiguous shares
+void split_jobs(Job* jobs, int count, uint64_t first, uint64_t last) {
+    memset(jobs, 0, sizeof(Job) * count);
+    for (int i = 0; i < count; i++) {
+        jobs[i].first = first + (last - first) * i / count;
+        jobs[i].last = first + (last - first) * (i + 1) / count;
+    }
+}
+
+/************************* Scanning *************************/
+void add_match(Job* job, uint64_t record) {
+    job->count++;
+    if (options.count_only || (options.limit && job->num_matches == options.limit)) return;
+    if (job->num_matches == job->capacity) {
+        job->capacity = job->capacity ? job->capacity * 2 : 256;
+        job->matches = (uint64_t*)realloc(job->matches, sizeof(uint64_t) * job->capacity);
+        if (!job->matches) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    job->matches[job->num_matches++] = record;
+}
+
+void* scan_job(void* arg) {
+    Job* job = (Job*)arg;
+    if (candidates) {
+        for (uint64_t i = job->first; i < job->last; i++) {
+            if (test_record(candidates[i])) add_match(job, candidates[i]);
+        }
+    }
+    else {
+        for (uint64_t r = job->first; r < job->last; r++) {
+            if (test_record(r)) add_match(job, r);
+        }
+    }
+    return NULL;
+}
+
+/************************* Index *************************/
+// <trace>.idx: "SIMPTQX2", u64 trace bytes, u64 trace mtime, u64 trace
+// hash, u64 records, u64 start[4097], then u32 record numbers grouped by PC
+// in record order. Records of PC p are entries start[p] to start[p + 1].
+// Reruns of one program often write traces of the same size; the mtime
+// and a hash of records spread over the trace tell them apart.
+#define INDEX_HEADER (8 + 4 * sizeof(uint64_t) + (MEMORY_SIZE + 1) * sizeof(uint64_t))
+
+// FNV-1a over INDEX_SAMPLES records, the last one included
+uint64_t trace_hash(void) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int s = 1; s <= INDEX_SAMPLES && num_records; s++) {
+        const char* record = trace + (num_records * s / INDEX_SAMPLES - (s == INDEX_SAMPLES)) * RECORD_SIZE;
+        for (int b = 0; b < RECORD_SIZE; b++) hash = (hash ^ (uint8_t)record[b]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+void* count_job(void* arg) {
+    Job* job = (Job*)arg;
+    for (uint64_t r = job->first; r < job->last; r++) {
+        job->pc_counts[hex_value(trace + r * RECORD_SIZE, 3)]++;
+    }
+    return NULL;
+}
+
+uint32_t* index_records;
+
+void* fill_job(void* arg) {
+    Job* job = (Job*)arg;
+    for (uint64_t r = job->first; r < job->last; r++) {
+        index_records[job->cursor[hex_value(trace + r * RECORD_SIZE, 3)]++] = (uint32_t)r;
+    }
+    return NULL;
+}
+
+void build_index(const char* path, int threads) {
+    if (num_records > UINT32_MAX) {
+        fprintf(stderr, "Error: Too many records to index (%llu)\n", (unsigned long long)num_records);
+        exit(1);
+    }
+    Job jobs[MAX_THREADS];
+    static uint64_t start[MEMORY_SIZE + 1];
+    split_jobs(jobs, threads, 0, num_records);
+    for (int t = 0; t < threads; t++) {
+        jobs[t].pc_counts = (uint64_t*)calloc(MEMORY_SIZE, sizeof(uint64_t));
+        jobs[t].cursor = (uint32_t*)malloc(MEMORY_SIZE * sizeof(uint32_t));
+        if (!jobs[t].pc_counts || !jobs[t].cursor) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+    }
+    run_jobs(jobs, threads, count_job);
+
+    // Each share fills its own slots, so the lists come out in record order
+    uint64_t pos = 0;
+    for (int pc = 0; pc < MEMORY_SIZE; pc++) {
+        start[pc] = pos;
+        for (int t = 0; t < threads; t++) {
+            jobs[t].cursor[pc] = (uint32_t)pos;
+            pos += jobs[t].pc_counts[pc];
+        }
+    }
+    start[MEMORY_SIZE] = pos;
+    index_records = (uint32_t*)malloc(sizeof(uint32_t) * (num_records ? num_records : 1));
+    if (!index_records) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    run_jobs(jobs, threads, fill_job);
+
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot write index %s\n", path);
+        exit(1);
+    }
+    uint64_t hash = trace_hash();
+    fwrite(INDEX_MAGIC, 1, 8, f);
+    fwrite(&trace_bytes, sizeof(uint64_t), 1, f);
+    fwrite(&trace_mtime, sizeof(uint64_t), 1, f);
+    fwrite(&hash, sizeof(uint64_t), 1, f);
+    fwrite(&num_records, sizeof(uint64_t), 1, f);
+    fwrite(start, sizeof(uint64_t), MEMORY_SIZE + 1, f);
+    if (fwrite(index_records, sizeof(uint32_t), num_records, f) != num_records || fclose(f) != 0) {
+        fprintf(stderr, "Error: Cannot write index %s\n", path);
+        exit(1);
+    }
+    for (int t = 0; t < threads; t++) {
+        free(jobs[t].pc_counts);
+        free(jobs[t].cursor);
+    }
+    free(index_records);
+    index_records = NULL;
+    fprintf(stderr, "Indexed %llu records into %s\n", (unsigned long long)num_records, path);
+}
+
+// Point candidates at the records of pc; 0 if there is no usable index
+int load_index(const char* path, uint32_t pc) {
+    uint64_t bytes;
+    const char* idx = map_file(path, &bytes);
+    if (!idx) return 0;
+
+    uint64_t stamp[4], start[2];  // Trace bytes, mtime, hash; records
+    if (bytes >= INDEX_HEADER) memcpy(stamp, idx + 8, sizeof(stamp));
+    if (bytes < INDEX_HEADER || memcmp(idx, INDEX_MAGIC, 8) != 0 || stamp[0] != trace_bytes ||
+        stamp[1] != trace_mtime || bytes != INDEX_HEADER + stamp[3] * sizeof(uint32_t) ||
+        stamp[2] != trace_hash()) {
+        fprintf(stderr, "Warning: %s does not match the trace, scanning instead (rebuild with --index)\n", path);
+        return 0;
+    }
+    memcpy(start, idx + 40 + pc * sizeof(uint64_t), sizeof(start));
+    candidates = (const uint32_t*)(idx + INDEX_HEADER) + start[0];
+    num_candidates = start[1] - start[0];
+    return 1;
+}
+
+/************************* Main Function *************************/
+int main(int argc, char* argv[]) {
+    int i = 1;
+    while (i < argc && strncmp(argv[i], "--", 2) == 0) {
+        const char* opt = argv[i];
+        if (strcmp(opt, "--count") == 0) options.count_only = 1;
+        else if (strcmp(opt, "--index") == 0) options.build_index = 1;
+        else if (strcmp(opt, "--no-index") == 0) options.use_index = 0;
+        else if (i + 1 < argc && strcmp(opt, "--from") == 0) options.from = strtoull(argv[++i], NULL, 0);
+        else if (i + 1 < argc && strcmp(opt, "--to") == 0) options.to = strtoull(argv[++i], NULL, 0);
+        else if (i + 1 < argc && strcmp(opt, "--limit") == 0) options.limit = strtoull(argv[++i], NULL, 0);
+        else if (i + 1 < argc && strcmp(opt, "--threads") == 0) options.threads = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "Error: Unknown or invalid option %s\n", opt);
+            return 1;
+        }
+        i++;
+    }
+    if (i >= argc) {
+        fprintf(stderr, "Usage: %s [options] trace.txt [PREDICATE...]\n", argv[0]);
+        fprintf(stderr, "Prints the records (instruction numbers, from 0) matching every PREDICATE.\n"
+            "PREDICATE is FIELD OP VALUE with no spaces, e.g. pc==0x01A '$s1==3' op!=0x14 imm1<-1\n"
+            "  FIELD: pc, inst, op, rd, rs, rt, rm, imm1, imm2, $zero..$ra or r0..r15\n"
+            "  OP: == != < <= > >= (unsigned, negative values wrap to the field width)\n"
+            "Options:\n"
+            "  --from N      first record to look at (default 0)\n"
+            "  --to N        stop before record N (default: end of trace)\n"
+            "  --limit N     records printed, 0 = all (default 50)\n"
+            "  --count       print only the number of matches\n"
+            "  --threads N   scanning threads (default: one per CPU)\n"
+            "  --index       build the PC index trace.txt.idx first\n"
+            "  --no-index    scan even when a pc== query could use the index\n");
+        return 1;
+    }
+    const char* path = argv[i++];
+    for (; i < argc; i++) parse_predicate(argv[i]);
+
+    trace = map_file(path, &trace_bytes);
+    if (!trace) {
+        fprintf(stderr, "Error: Cannot map %s\n", path);
+        return 1;
+    }
+    if (trace_bytes % RECORD_SIZE != 0 || (trace_bytes && (trace[3] != ' ' || trace[RECORD_SIZE - 1] != '\n'))) {
+        fprintf(stderr, "Error: %s is not a SIMP trace (records of %d bytes)\n", path, RECORD_SIZE);
+        return 1;
+    }
+    num_records = trace_bytes / RECORD_SIZE;
+    trace_mtime = file_mtime(path);
+    if (options.to == 0 || options.to > num_records) options.to = num_records;
+    if (options.from > options.to) options.from = options.to;
+    int threads = options.threads > 0 ? (options.threads > MAX_THREADS ? MAX_THREADS : options.threads)
+        : default_threads();
+
+    char index_path[MAX_LINE_LENGTH];
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    if (options.build_index) build_index(index_path, threads);
+
+    // A pc== query reads only that PC's records from the index
+    uint64_t first = options.from, last = options.to;
+    if (pc_predicate >= 0 && options.use_index &&
+        load_index(index_path, hex_value(predicates[pc_predicate].text, 3))) {
+        uint64_t lo = 0, hi = num_candidates;
+        while (lo < hi) {  // First candidate at or after from
+            uint64_t mid = (lo + hi) / 2;
+            if (candidates[mid] < options.from) lo = mid + 1;
+            else hi = mid;
+        }
+        first = lo;
+        hi = num_candidates;
+        while (lo < hi) {  // First candidate at or after to
+            uint64_t mid = (lo + hi) / 2;
+            if (candidates[mid] < options.to) lo = mid + 1;
+            else hi = mid;
+        }
+        last = lo;
+    }
+#if defined(SIMP_HAVE_MMAP)
+    else if (last > first) {
+        madvise((void*)trace, trace_bytes, MADV_SEQUENTIAL);
+    }
+#endif
+
+    if (last - first < (uint64_t)threads * 4096) threads = 1;  // Not worth the threads
+    Job jobs[MAX_THREADS];
+    split_jobs(jobs, threads, first, last);
+    run_jobs(jobs, threads, scan_job);
+
+    uint64_t total = 0, shown = 0;
+    for (int t = 0; t < threads; t++) {
+        total += jobs[t].count;
+        for (uint64_t m = 0; m < jobs[t].num_matches && (!options.limit || shown < options.limit); m++) {
+            printf("%llu: %.*s\n", (unsigned long long)jobs[t].matches[m], RECORD_SIZE - 1,
+                trace + jobs[t].matches[m] * RECORD_SIZE);
+            shown++;
+        }
+        free(jobs[t].matches);
+    }
+    if (options.count_only) printf("%llu\n", (unsigned long long)total);
+    else fprintf(stderr, "%llu matching records (%llu shown)%s\n", (unsigned long long)total,
+        (unsigned long long)shown, candidates ? ", from the index" : "");
+    return 0;
+}
@@ -0,0 +1,74 @@
+# Monitor DMA Program (blit.asm)
+# Clears the screen with one span fill, draws a filled rectangle and copies
+# an 8x8 sprite from data memory, using the monitor fill/copy commands
+# instead of three out instructions per pixel.
+# The sprite copy completes with irq2, the two fills are polled.
+
+out $zero, $imm1, $zero, $imm2, irqhandler, done_irq   # Install completion handler
+
+# Clear the screen to dark gray: one span of 65536 pixels
+sll $t0, $imm1, $imm2, $zero, 1, 16          # $t0 = 256 * 256
+out $zero, $imm1, $zero, $t0, monitorsize, 0 # Span length
+out $zero, $imm1, $zero, $zero, monitoraddr, 0
+out $zero, $imm1, $zero, $imm2, monitordata, 0x40
+out $zero, $imm1, $zero, $imm2, monitorcmd, 4 # Fill span
+
+wait_clear:
+in $t0, $imm1, $zero, $zero, monitorcmd, 0   # Busy while monitorcmd != 0
+bne $zero, $t0, $zero, $imm1, wait_clear, 0
+
+# White 192x64 rectangle at (32, 48)
+sll $t0, $imm1, $imm2, $zero, 64, 16         # Height in bits 31:16
+add $t0, $t0, $imm1, $zero, 192, 0           # Width in bits 15:0
+out $zero, $imm1, $zero, $t0, monitorsize, 0
+sll $t1, $imm1, $imm2, $zero, 48, 8          # y * 256
+add $t1, $t1, $imm1, $zero, 32, 0            # + x
+out $zero, $imm1, $zero, $t1, monitoraddr, 0
+out $zero, $imm1, $zero, $imm2, monitordata, 0xFF
+out $zero, $imm1, $zero, $imm2, monitorcmd, 3 # Fill rectangle
+
+wait_rect:
+in $t0, $imm1, $zero, $zero, monitorcmd, 0
+bne $zero, $t0, $zero, $imm1, wait_rect, 0
+
+# 8x8 sprite from dmem 0x100 at (124, 124), interrupt on completion
+add $s0, $zero, $zero, $zero, 0, 0           # Completion flag
+out $zero, $imm1, $zero, $zero, irq2status, 0 # Drop stale external interrupts
+out $zero, $imm1, $zero, $imm2, irq2enable, 1
+sll $t0, $imm1, $imm2, $zero, 8, 16
+add $t0, $t0, $imm1, $zero, 8, 0             # 8x8
+out $zero, $imm1, $zero, $t0, monitorsize, 0
+out $zero, $imm1, $zero, $imm2, monitorsrc, 0x100
+sll $t1, $imm1, $imm2, $zero, 124, 8
+add $t1, $t1, $imm1, $zero, 124, 0
+out $zero, $imm1, $zero, $t1, monitoraddr, 0
+out $zero, $imm1, $zero, $imm2, monitorcmd, 0x105 # Copy with completion irq
+
+wait_sprite:
+beq $zero, $s0, $zero, $imm1, wait_sprite, 0 # Handler sets $s0
+
+out $zero, $imm1, $zero, $zero, irq2enable, 0
+halt $zero, $zero, $zero, $zero, 0, 0
+
+done_irq:
+out $zero, $imm1, $zero, $zero, irq2status, 0 # Acknowledge
+add $s0, $zero, $imm1, $zero, 1, 0
+reti $zero, $zero, $zero, $zero, 0, 0
+
+# Sprite: 8x8 diamond, 2 words per row, pixel 0 in the low byte
+.word 0x100 0x7F000000
+.word 0x101 0x0000007F
+.word 0x102 0x7F7F0000
+.word 0x103 0x00007F7F
+.word 0x104 0x7F7F7F00
+.word 0x105 0x007F7F7F
+.word 0x106 0x7F7F7F7F
+.word 0x107 0x7F7F7F7F
+.word 0x108 0x7F7F7F7F
+.word 0x109 0x7F7F7F7F
+.word 0x10A 0x7F7F7F00
+.word 0x10B 0x007F7F7F
+.word 0x10C 0x7F7F0000
+.word 0x10D 0x00007F7F
+.word 0x10E 0x7F000000
+.word 0x10F 0x0000007F
@@ -0,0 +1,53 @@
+# Disk DMA Program (diskdma.asm)
+# Moves sectors 0-7 forward by one sector like disktest.asm, but with one
+# 8-sector read and one 8-sector write queued back to back. The disk raises
+# a single interrupt for the batch, and the program sums 1..100 while the
+# transfers run. A gather read then collects sectors 1 and 8 into 0x600.
+
+out $zero, $imm1, $zero, $imm2, irqhandler, disk_irq
+out $zero, $imm1, $zero, $imm2, diskirqmode, 1     # One interrupt per batch
+out $zero, $imm1, $zero, $imm2, irq1enable, 1
+add $s0, $zero, $zero, $zero, 0, 0                 # Batch done flag
+
+out $zero, $imm1, $zero, $imm2, diskcount, 8
+out $zero, $imm1, $zero, $zero, disksector, 0
+out $zero, $imm1, $zero, $imm2, diskbuffer, 0x100
+out $zero, $imm1, $zero, $imm2, diskcmd, 1         # Queue read of sectors 0-7
+out $zero, $imm1, $zero, $imm2, disksector, 1
+out $zero, $imm1, $zero, $imm2, diskcmd, 2         # Queue write to sectors 1-8
+
+# Overlap computation with the transfers: sum 1..100
+add $v0, $zero, $zero, $zero, 0, 0
+add $t0, $zero, $imm1, $zero, 100, 0
+sum:
+add $v0, $v0, $t0, $zero, 0, 0
+sub $t0, $t0, $imm1, $zero, 1, 0
+bgt $zero, $t0, $zero, $imm1, sum, 0
+sw $v0, $imm1, $zero, $zero, 0x80, 0               # Store the sum at 0x80
+
+wait_batch:
+beq $zero, $s0, $zero, $imm1, wait_batch, 0        # Handler sets $s0
+
+# Gather sectors 1 and 8 with one command (descriptors at 0x50)
+add $s0, $zero, $zero, $zero, 0, 0
+out $zero, $imm1, $zero, $imm2, diskdesc, 0x50
+out $zero, $imm1, $zero, $imm2, diskcmd, 3
+wait_gather:
+beq $zero, $s0, $zero, $imm1, wait_gather, 0
+
+out $zero, $imm1, $zero, $zero, irq1enable, 0
+halt $zero, $zero, $zero, $zero, 0, 0
+
+disk_irq:
+out $zero, $imm1, $zero, $zero, irq1status, 0      # Acknowledge
+add $s0, $zero, $imm1, $zero, 1, 0
+reti $zero, $zero, $zero, $zero, 0, 0
+
+# Gather descriptors: sector, buffer, count; a zero count ends the list
+.word 0x50 1
+.word 0x51 0x600
+.word 0x52 1
+.word 0x53 8
+.word 0x54 0x680
+.word 0x55 1
+.word 0x58 0
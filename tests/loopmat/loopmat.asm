@@ -0,0 +1,98 @@
+# Hardware Loop Matrix Multiplication (loopmat.asm)
+# The mulmat product C = A x B (4x4 matrices, A at 0x100, B at 0x110,
+# C at 0x120) with all three loops run by loop instructions instead of
+# compare-and-branch. A timer interrupt every 50 cycles lands in the
+# middle of the loops; its handler runs a loop of its own and the LEDs
+# end up at three times the number of ticks. A last loop ends with a call,
+# so the callee's return lands on the loop end; 0x130 and 0x131 count its
+# iterations and calls, both 3.
+
+# Matrix A
+.word 0x100 1
+.word 0x101 2
+.word 0x102 3
+.word 0x103 4
+.word 0x104 1
+.word 0x105 1
+.word 0x106 1
+.word 0x107 1
+.word 0x108 1
+.word 0x109 1
+.word 0x10A 1
+.word 0x10B 1
+.word 0x10C 1
+.word 0x10D 1
+.word 0x10E 1
+.word 0x10F 1
+
+# Matrix B
+.word 0x110 1
+.word 0x111 2
+.word 0x112 3
+.word 0x113 4
+.word 0x114 1
+.word 0x115 1
+.word 0x116 1
+.word 0x117 1
+.word 0x118 1
+.word 0x119 1
+.word 0x11A 1
+.word 0x11B 1
+.word 0x11C 1
+.word 0x11D 1
+.word 0x11E 1
+.word 0x11F 1
+
+out $zero, $imm1, $zero, $imm2, irqhandler, tick
+out $zero, $imm1, $zero, $imm2, timermax, 50
+out $zero, $imm1, $zero, $imm2, irq0enable, 1
+out $zero, $imm1, $zero, $imm2, timerenable, 1
+
+add $s0, $zero, $imm1, $zero, 0x100, 0       # A
+add $s1, $zero, $imm1, $zero, 0x110, 0       # B
+add $s2, $zero, $imm1, $zero, 0x120, 0       # C
+
+add $t0, $zero, $zero, $zero, 0, 0           # i = 0
+loop $zero, $imm1, $zero, $imm2, 4, rows_done
+    add $t1, $zero, $zero, $zero, 0, 0       # j = 0
+    loop $zero, $imm1, $zero, $imm2, 4, cols_done
+        add $v0, $zero, $zero, $zero, 0, 0   # sum = 0
+        mac $a0, $t0, $imm1, $zero, 4, 0     # &A[i][0] - A
+        add $a1, $t1, $zero, $zero, 0, 0     # &B[0][j] - B
+        loop $zero, $imm1, $zero, $imm2, 4, dot_done
+            lw $a2, $s0, $a0, $zero, 0, 0    # A[i][k]
+            lw $ra, $s1, $a1, $zero, 0, 0    # B[k][j]
+            mac $v0, $a2, $ra, $v0, 0, 0
+            add $a0, $a0, $imm1, $zero, 1, 0 # Next column of A
+            add $a1, $a1, $imm1, $zero, 4, 0 # Next row of B
+        dot_done:
+        mac $a0, $t0, $imm1, $t1, 4, 0       # 4*i + j
+        sw $zero, $a0, $s2, $v0, 0, 0        # C[i][j] = sum
+        add $t1, $t1, $imm1, $zero, 1, 0
+    cols_done:
+    add $t0, $t0, $imm1, $zero, 1, 0
+rows_done:
+
+add $t2, $zero, $zero, $zero, 0, 0           # Iterations
+add $s0, $zero, $zero, $zero, 0, 0           # Calls
+loop $zero, $imm1, $zero, $imm2, 3, calls_done
+    add $t2, $t2, $imm1, $zero, 1, 0
+    jal $ra, $zero, $zero, $imm1, bump, 0    # Returns to calls_done
+calls_done:
+sw $zero, $zero, $imm1, $t2, 0x130, 0
+sw $zero, $zero, $imm1, $s0, 0x131, 0
+
+out $zero, $imm1, $zero, $zero, timerenable, 0
+halt $zero, $zero, $zero, $zero, 0, 0
+
+bump:
+add $s0, $s0, $imm1, $zero, 1, 0
+beq $zero, $zero, $zero, $ra, 0, 0           # Return
+
+tick:
+out $zero, $imm1, $zero, $zero, irq0status, 0 # Acknowledge
+loop $zero, $imm1, $zero, $imm2, 3, tick_done
+    add $gp, $gp, $imm1, $zero, 1, 0
+tick_done:
+out $zero, $imm1, $zero, $gp, leds, 0
+reti $zero, $zero, $zero, $zero, 0, 0
@@ -0,0 +1,26 @@
+# Multi-core Disk Wait (mcdisk.asm)
+# The last core reads disk sector 1 into 0x100, polling diskstatus until
+# the read is done, and stores the number of polls at 0x200. Every other
+# core halts at once.
+# The expected files come from sim --cores 2 --lockstep: core 0 halts
+# before core 1 starts the read, so the disk must keep running until
+# the last core halts. On a single core, core 0 does the read.
+
+in $s0, $zero, $imm1, $zero, coreid, 0       # $s0 = this core
+in $t0, $zero, $imm1, $zero, numcores, 0     # $t0 = number of cores
+sub $t0, $t0, $imm1, $zero, 1, 0             # $t0 = last core
+bne $zero, $s0, $t0, $imm1, finish, 0        # Only the last core uses the disk
+
+out $zero, $zero, $imm1, $imm2, disksector, 1   # Sector 1
+out $zero, $zero, $imm1, $imm2, diskbuffer, 0x100
+out $zero, $zero, $imm1, $imm2, diskcmd, 1      # Read
+
+wait:
+    add $s1, $s1, $imm1, $zero, 1, 0             # Count the polls
+    in $t1, $zero, $imm1, $zero, diskstatus, 0
+    bne $zero, $t1, $zero, $imm1, wait, 0        # Until the disk is ready
+
+sw $s1, $zero, $imm1, $zero, 0x200, 0
+
+finish:
+    halt $zero, $zero, $zero, $zero, 0, 0
@@ -0,0 +1,191 @@
+# Parallel Matrix Multiplication Program (8x8 matrices)
+# Input:  Matrix A (0x100-0x13F), Matrix B (0x140-0x17F)
+# Output: Matrix C (0x180-0x1BF) = A × B
+# Core k computes rows k, k + numcores, ... and then counts itself done
+# with an atomic add at 0x1C0. Core 0 waits for every core before it
+# halts. On a single core (the default) it computes all eight rows.
+
+# Initialize Matrix A (8x8): A[i][j] = i + j
+.word 0x100 0
+.word 0x101 1
+.word 0x102 2
+.word 0x103 3
+.word 0x104 4
+.word 0x105 5
+.word 0x106 6
+.word 0x107 7
+.word 0x108 1
+.word 0x109 2
+.word 0x10A 3
+.word 0x10B 4
+.word 0x10C 5
+.word 0x10D 6
+.word 0x10E 7
+.word 0x10F 8
+.word 0x110 2
+.word 0x111 3
+.word 0x112 4
+.word 0x113 5
+.word 0x114 6
+.word 0x115 7
+.word 0x116 8
+.word 0x117 9
+.word 0x118 3
+.word 0x119 4
+.word 0x11A 5
+.word 0x11B 6
+.word 0x11C 7
+.word 0x11D 8
+.word 0x11E 9
+.word 0x11F 10
+.word 0x120 4
+.word 0x121 5
+.word 0x122 6
+.word 0x123 7
+.word 0x124 8
+.word 0x125 9
+.word 0x126 10
+.word 0x127 11
+.word 0x128 5
+.word 0x129 6
+.word 0x12A 7
+.word 0x12B 8
+.word 0x12C 9
+.word 0x12D 10
+.word 0x12E 11
+.word 0x12F 12
+.word 0x130 6
+.word 0x131 7
+.word 0x132 8
+.word 0x133 9
+.word 0x134 10
+.word 0x135 11
+.word 0x136 12
+.word 0x137 13
+.word 0x138 7
+.word 0x139 8
+.word 0x13A 9
+.word 0x13B 10
+.word 0x13C 11
+.word 0x13D 12
+.word 0x13E 13
+.word 0x13F 14
+
+# Initialize Matrix B (8x8): B[i][j] = i * j + 1
+.word 0x140 1
+.word 0x141 1
+.word 0x142 1
+.word 0x143 1
+.word 0x144 1
+.word 0x145 1
+.word 0x146 1
+.word 0x147 1
+.word 0x148 1
+.word 0x149 2
+.word 0x14A 3
+.word 0x14B 4
+.word 0x14C 5
+.word 0x14D 6
+.word 0x14E 7
+.word 0x14F 8
+.word 0x150 1
+.word 0x151 3
+.word 0x152 5
+.word 0x153 7
+.word 0x154 9
+.word 0x155 11
+.word 0x156 13
+.word 0x157 15
+.word 0x158 1
+.word 0x159 4
+.word 0x15A 7
+.word 0x15B 10
+.word 0x15C 13
+.word 0x15D 16
+.word 0x15E 19
+.word 0x15F 22
+.word 0x160 1
+.word 0x161 5
+.word 0x162 9
+.word 0x163 13
+.word 0x164 17
+.word 0x165 21
+.word 0x166 25
+.word 0x167 29
+.word 0x168 1
+.word 0x169 6
+.word 0x16A 11
+.word 0x16B 16
+.word 0x16C 21
+.word 0x16D 26
+.word 0x16E 31
+.word 0x16F 36
+.word 0x170 1
+.word 0x171 7
+.word 0x172 13
+.word 0x173 19
+.word 0x174 25
+.word 0x175 31
+.word 0x176 37
+.word 0x177 43
+.word 0x178 1
+.word 0x179 8
+.word 0x17A 15
+.word 0x17B 22
+.word 0x17C 29
+.word 0x17D 36
+.word 0x17E 43
+.word 0x17F 50
+
+# Main Program
+in $s0, $zero, $imm1, $zero, coreid, 0     # $s0 = this core, also the first row
+in $s1, $zero, $imm1, $zero, numcores, 0   # $s1 = number of cores, the row stride
+
+# Outer loop - Iterate through this core's rows of A
+add $t0, $s0, $zero, $zero, 0, 0           # $t0 = row index i = coreid
+loop_i:
+    bge $zero, $t0, $imm2, $imm1, done, 8  # Exit if i >= 8
+
+    # Middle loop - Iterate through columns of B
+    add $t1, $zero, $zero, $zero, 0, 0     # $t1 = column index j = 0
+    loop_j:
+        beq $zero, $t1, $imm2, $imm1, next_i, 8  # Move to next row if j == 8
+
+        # Initialize dot product accumulator
+        add $v0, $zero, $zero, $zero, 0, 0       # $v0 = sum = 0
+        add $t2, $zero, $zero, $zero, 0, 0       # $t2 = k = 0
+
+        # Inner loop - Calculate dot product
+        loop_k:
+            beq $zero, $t2, $imm2, $imm1, store, 8  # Store result if k == 8
+
+            mac $a0, $t0, $imm1, $t2, 8, 0          # $a0 = 8*i + k
+            lw $a0, $a0, $imm1, $zero, 0x100, 0     # $a0 = A[i][k]
+            mac $a1, $t2, $imm1, $t1, 8, 0          # $a1 = 8*k + j
+            lw $a1, $a1, $imm1, $zero, 0x140, 0     # $a1 = B[k][j]
+            mac $v0, $a0, $a1, $v0, 0, 0            # sum += A[i][k] * B[k][j]
+
+            add $t2, $t2, $imm1, $zero, 1, 0
+            beq $zero, $zero, $zero, $imm1, loop_k, 0
+
+        store:
+            mac $a0, $t0, $imm1, $t1, 8, 0          # $a0 = 8*i + j
+            sw $v0, $a0, $imm1, $zero, 0x180, 0     # C[i][j] = sum
+
+            add $t1, $t1, $imm1, $zero, 1, 0
+            beq $zero, $zero, $zero, $imm1, loop_j, 0
+
+    next_i:
+        add $t0, $t0, $s1, $zero, 0, 0             # i += numcores
+        beq $zero, $zero, $zero, $imm1, loop_i, 0
+
+done:
+    amoadd $zero, $zero, $imm1, $imm2, 0x1C0, 1    # Count this core as done
+    bne $zero, $s0, $zero, $imm1, finish, 0        # Only core 0 waits
+
+wait:
+    lw $a0, $zero, $imm1, $zero, 0x1C0, 0
+    bne $zero, $a0, $s1, $imm1, wait, 0            # Until every core is done
+
+finish:
+    halt $zero, $zero, $zero, $zero, 0, 0
\ No newline at end of file
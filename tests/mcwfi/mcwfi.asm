@@ -0,0 +1,27 @@
+# Multi-core Timer Sleep (mcwfi.asm)
+# Every core sleeps in wfi on the shared timer until it has counted
+# 2 + coreid ticks, then stores its count at 0x100 + coreid and halts.
+# The timer interrupt reaches every core, and each core acknowledges its
+# own irq0status.
+# The expected files come from sim --cores 2 --lockstep: core 1 takes
+# its third tick after core 0 has halted, so the timer must keep
+# running until the last core halts.
+
+in $s0, $zero, $imm1, $zero, coreid, 0       # $s0 = this core
+add $s1, $s0, $imm1, $zero, 2, 0             # $s1 = ticks to wait for
+out $zero, $imm1, $zero, $imm2, irqhandler, tick
+out $zero, $imm1, $zero, $imm2, timermax, 500
+out $zero, $imm1, $zero, $imm2, irq0enable, 1
+out $zero, $imm1, $zero, $imm2, timerenable, 1
+
+sleep:
+    wfi $zero, $zero, $zero, $zero, 0, 0         # Wait for the next tick
+    blt $zero, $s2, $s1, $imm1, sleep, 0         # Until enough ticks were counted
+
+sw $s2, $s0, $imm1, $zero, 0x100, 0
+halt $zero, $zero, $zero, $zero, 0, 0
+
+tick:
+    out $zero, $imm1, $zero, $zero, irq0status, 0 # Acknowledge this core's tick
+    add $s2, $s2, $imm1, $zero, 1, 0
+    reti $zero, $zero, $zero, $zero, 0, 0
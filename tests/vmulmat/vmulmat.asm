@@ -0,0 +1,79 @@
+# Vector Matrix Multiplication Program (4x4 matrices)
+# Input:  Matrix A (0x100-0x10F), Matrix B (0x110-0x11F)
+# Output: Matrix C (0x120-0x12F) = A × B
+# Same product as mulmat.asm using the vector extension: the columns of B
+# are loaded once with strided loads, then each element of C is one vmul
+# and one horizontal reduce.
+
+# Initialize Matrix A (4x4)
+.word 0x100 1    # Row 0: [1 2 3 4]
+.word 0x101 2
+.word 0x102 3
+.word 0x103 4
+.word 0x104 1    # Row 1: [1 1 1 1]
+.word 0x105 1
+.word 0x106 1
+.word 0x107 1
+.word 0x108 1    # Row 2: [1 1 1 1]
+.word 0x109 1
+.word 0x10A 1
+.word 0x10B 1
+.word 0x10C 1    # Row 3: [1 1 1 1]
+.word 0x10D 1
+.word 0x10E 1
+.word 0x10F 1
+
+# Initialize Matrix B (4x4)
+.word 0x110 1    # Row 0: [1 2 3 4]
+.word 0x111 2
+.word 0x112 3
+.word 0x113 4
+.word 0x114 1    # Row 1: [1 1 1 1]
+.word 0x115 1
+.word 0x116 1
+.word 0x117 1
+.word 0x118 1    # Row 2: [1 1 1 1]
+.word 0x119 1
+.word 0x11A 1
+.word 0x11B 1
+.word 0x11C 1    # Row 3: [1 1 1 1]
+.word 0x11D 1
+.word 0x11E 1
+.word 0x11F 1
+
+# Main Program
+vsetvl $zero, $imm1, $zero, $zero, 4, 0   # 4 lanes
+
+# Columns of B into $vr4-$vr7 (stride 4)
+vlws $vr4, $imm1, $imm2, $zero, 0x110, 4
+vlws $vr5, $imm1, $imm2, $zero, 0x111, 4
+vlws $vr6, $imm1, $imm2, $zero, 0x112, 4
+vlws $vr7, $imm1, $imm2, $zero, 0x113, 4
+
+add $t0, $zero, $imm1, $zero, 0x100, 0    # $t0 = address of row i of A
+add $t1, $zero, $imm1, $zero, 0x120, 0    # $t1 = address of row i of C
+
+loop_i:
+    vlw $vr1, $t0, $zero, $zero, 0, 0      # $vr1 = A[i][0..3]
+
+    vmul $vr2, $vr1, $vr4, $zero, 0, 0     # C[i][0] = sum(A[i][k] * B[k][0])
+    vred $v0, $vr2, $zero, $zero, 0, 0
+    sw $v0, $t1, $zero, $zero, 0, 0
+
+    vmul $vr2, $vr1, $vr5, $zero, 0, 0     # C[i][1]
+    vred $v0, $vr2, $zero, $zero, 0, 0
+    sw $v0, $t1, $imm1, $zero, 1, 0
+
+    vmul $vr2, $vr1, $vr6, $zero, 0, 0     # C[i][2]
+    vred $v0, $vr2, $zero, $zero, 0, 0
+    sw $v0, $t1, $imm1, $zero, 2, 0
+
+    vmul $vr2, $vr1, $vr7, $zero, 0, 0     # C[i][3]
+    vred $v0, $vr2, $zero, $zero, 0, 0
+    sw $v0, $t1, $imm1, $zero, 3, 0
+
+    add $t0, $t0, $imm1, $zero, 4, 0
+    add $t1, $t1, $imm1, $zero, 4, 0
+    blt $zero, $t1, $imm1, $imm2, 0x130, loop_i  # Next row while $t1 < 0x130
+
+halt $zero, $zero, $zero, $zero, 0, 0
@@ -0,0 +1,24 @@
+# Timer Sleep Program (wfi.asm)
+# Counts eight timer ticks on the LEDs, sleeping in wfi between ticks
+# instead of polling. The simulator skips the idle cycles, so the run
+# costs a handful of instructions per tick instead of 102400.
+
+out $zero, $imm1, $zero, $imm2, irqhandler, tick
+sll $t0, $imm1, $imm2, $zero, 100, 10        # Tick period: 102400 cycles
+out $zero, $imm1, $zero, $t0, timermax, 0
+out $zero, $imm1, $zero, $imm2, irq0enable, 1
+out $zero, $imm1, $zero, $imm2, timerenable, 1
+add $s0, $zero, $zero, $zero, 0, 0           # Tick counter
+
+sleep:
+wfi $zero, $zero, $zero, $zero, 0, 0         # Wait for the next tick
+blt $zero, $s0, $imm1, $imm2, 8, sleep       # Until eight ticks were counted
+
+out $zero, $imm1, $zero, $zero, timerenable, 0
+halt $zero, $zero, $zero, $zero, 0, 0
+
+tick:
+out $zero, $imm1, $zero, $zero, irq0status, 0 # Acknowledge
+add $s0, $s0, $imm1, $zero, 1, 0
+out $zero, $imm1, $zero, $s0, leds, 0
+reti $zero, $zero, $zero, $zero, 0, 0